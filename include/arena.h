@@ -0,0 +1,31 @@
+#ifndef _ARENA_H
+#define _ARENA_H
+
+/*
+* File:     arena.h
+* Purpose:  Header file for arena.c, a region allocator for short-lived objects.
+*
+* An arena hands out memory from large chunks.  Nothing is freed one object
+* at a time: arena_reset() makes all of the arena's memory available again
+* in O(1) and keeps the chunks, so a loop that allocates the same things on
+* every pass stops calling malloc() after the first pass.  arena_free()
+* releases every chunk at once.  arena_heap_allocations() counts the chunks
+* all arenas have taken from the heap, which lets tests check that a loop
+* runs without heap allocations.
+*/
+
+#include <inttypes.h>
+#include <stddef.h>
+
+// the default size of one chunk
+#define ARENA_CHUNK_SIZE (64 * 1024)
+
+typedef struct Arena Arena;
+
+Arena *arena_create(size_t chunk_size);
+void arena_free(Arena **arena);
+void *arena_alloc(Arena *arena, size_t size);
+void arena_reset(Arena *arena);
+uint64_t arena_heap_allocations(void);
+
+#endif
@@ -0,0 +1,35 @@
+#ifndef _BITIO_EXT_H
+#define _BITIO_EXT_H
+
+/*
+* File:     bitio_ext.h
+* Purpose:  Header file for the in-memory and byte-level BitReader and
+*           BitWriter helpers in bitreader.c and bitwriter.c, kept apart
+*           from the bitreader.h and bitwriter.h interfaces.
+*
+* A memory reader or writer works on the caller's buffer and is closed with
+* bit_read_close() or bit_write_close() like a file one; closing an arena
+* one leaves its memory to the arena.  A memory writer drops the bytes that
+* do not fit in its buffer.
+*/
+
+#include "arena.h"
+#include "bitreader.h"
+#include "bitwriter.h"
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+BitReader *bit_read_open_memory(const uint8_t *src, size_t n);
+BitReader *bit_read_open_arena(Arena *arena, const uint8_t *src, size_t n);
+uint64_t bit_read_bits(BitReader *buf, uint8_t n);
+void bit_read_align(BitReader *buf);
+bool bit_read_bytes(BitReader *buf, uint8_t *dst, size_t n);
+
+BitWriter *bit_write_open_memory(uint8_t *dst, size_t capacity);
+BitWriter *bit_write_open_arena(Arena *arena, uint8_t *dst, size_t capacity);
+void bit_write_align(BitWriter *buf);
+void bit_write_bytes(BitWriter *buf, const uint8_t *data, size_t n);
+
+#endif
@@ -16,11 +16,16 @@
 
 typedef struct BitReader BitReader;
 
+// the most bits bit_peek() can return at once
+#define BR_PEEK_MAX 57
+
 BitReader *bit_read_open(const char *filename);
 void bit_read_close(BitReader **pbuf);
 uint32_t bit_read_uint32(BitReader *buf);
 uint16_t bit_read_uint16(BitReader *buf);
 uint8_t bit_read_uint8(BitReader *buf);
 uint8_t bit_read_bit(BitReader *buf);
+uint64_t bit_peek(BitReader *buf, uint8_t n);
+void bit_consume(BitReader *buf, uint8_t n);
 
 #endif
@@ -0,0 +1,106 @@
+#ifndef _BLOCK_H
+#define _BLOCK_H
+
+/*
+* File:     block.h
+* Purpose:  Header file for block.c, the block-framed container (format v5).
+*
+* Layout (all fields little-endian, every block starts on a byte boundary):
+*
+*   file header   'H' 'F' 5, uint32 block size
+*   block         uint32 uncompressed length (> 0), uint32 compressed length,
+*                 then that many bytes:
+*                   code lengths, zero padding to a byte boundary, or
+*                   0xf0 0xff and a uint8 table ID for a preset table
+*                   uint8 number of sub-streams k (1 to BLOCK_MAX_STREAMS)
+*                   uint32 byte length of each sub-stream but the last
+*                   the k sub-streams, each padded to a byte boundary
+*                 or, for a block that is not coded,
+*                   0xf0 0xfe and the uncompressed bytes as they are, or
+*                   0xf0 0xfd and the uint8 value every byte of the block has
+*   ...
+*   end marker    uint32 0
+*   block index   uint64 offset of each block, uint64 total uncompressed
+*                 size, uint64 number of blocks, 'H' 'F' 'I' 'X'
+*
+* Sub-stream s holds the codes of the s-th of k nearly equal slices of the
+* block (see block_stream_length()), all coded with the block's table.
+* Version 4 files are the same but have no preset, stored or run blocks, so
+* a decoder that only knows version 4 rejects the newer files by their
+* version.  Version 3 files also have none, and a block holds its code
+* lengths followed directly by one stream of codes and zero padding.
+*
+* Every block carries its own code lengths, so it decodes on its own, unless
+* it names a preset table.  The two bytes that do that read as code lengths
+* starting with a run of 271 absent symbols, which no code can have; stored
+* and run blocks start with runs of 270 and 269.
+*/
+
+#include "bitreader.h"
+#include "bitwriter.h"
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+// format version of the block container, the older version without preset,
+// stored or run blocks, and the older single-stream version
+#define BLOCK_VERSION         5
+#define BLOCK_VERSION_STREAMS 4
+#define BLOCK_VERSION_SINGLE  3
+
+// the most sub-streams a block can be split into, and how many huff uses
+#define BLOCK_MAX_STREAMS     4
+#define BLOCK_DEFAULT_STREAMS 4
+
+// default and largest number of input bytes in one block
+#define BLOCK_DEFAULT_SIZE (1024 * 1024)
+#define BLOCK_MAX_SIZE     (1024 * 1024 * 1024)
+
+// the bytes in front of a block's sub-stream table that name a preset table,
+// in front of the bytes of a stored block, and of a whole run block
+#define BLOCK_PRESET_SIZE 3
+#define BLOCK_STORED_SIZE 2
+#define BLOCK_RUN_SIZE    3
+
+// bytes taken by the file header, a block header and the index trailer
+#define BLOCK_FILE_HEADER_SIZE 7
+#define BLOCK_HEADER_SIZE      8
+#define BLOCK_TRAILER_SIZE     20
+
+// what the bytes of a block after its header hold
+typedef enum BlockKind {
+    BLOCK_CODED,  // its own code lengths and sub-streams
+    BLOCK_PRESET, // the ID of a preset table and sub-streams
+    BLOCK_STORED, // the uncompressed bytes
+    BLOCK_RUN,    // one byte value, repeated for the whole block
+} BlockKind;
+
+typedef struct BlockIndex BlockIndex;
+
+BlockIndex *block_index_create(void);
+void block_index_free(BlockIndex **index);
+void block_index_reset(BlockIndex *index);
+bool block_index_append(BlockIndex *index, uint64_t offset, uint32_t length);
+uint64_t block_index_count(BlockIndex *index);
+uint64_t block_index_offset(BlockIndex *index, uint64_t i);
+uint64_t block_index_total(BlockIndex *index);
+void block_index_write(BitWriter *outbuf, BlockIndex *index);
+BlockIndex *block_index_read(FILE *f);
+
+bool block_version_known(uint8_t version);
+void block_write_file_header(BitWriter *outbuf, uint32_t block_size);
+void block_write_header(BitWriter *outbuf, uint32_t length, uint32_t compressed_length);
+void block_write_end(BitWriter *outbuf);
+void block_write_preset(BitWriter *outbuf, uint8_t id);
+int block_read_preset(const uint8_t *in, size_t n);
+void block_write_stored(BitWriter *outbuf, const uint8_t *data, uint32_t length);
+void block_write_run(BitWriter *outbuf, uint8_t value);
+BlockKind block_read_kind(const uint8_t *in, size_t n);
+
+uint32_t block_stream_length(uint32_t length, uint8_t num_streams, uint8_t s);
+size_t block_bound(uint32_t length);
+size_t block_read_bound(uint32_t length);
+
+#endif
@@ -0,0 +1,36 @@
+#ifndef _CANON_H
+#define _CANON_H
+
+/*
+* File:     canon.h
+* Purpose:  Header file for canon.c, canonical Huffman codes.
+*
+* A canonical code is fully determined by the code length of each symbol,
+* so a header only needs to store 256 lengths instead of the whole tree.
+* Codes are returned with their first bit in the least significant bit,
+* the order in which BitWriter and BitReader move bits.
+*
+* canon_limit_lengths() computes the best code lengths that do not exceed
+* a given maximum (package-merge), so decode tables can stay small.  Its
+* scratch lists come from the heap, or from an arena with
+* canon_limit_lengths_arena().
+*/
+
+#include "arena.h"
+#include "bitreader.h"
+#include "bitwriter.h"
+
+#include <inttypes.h>
+#include <stdbool.h>
+
+// the longest code length the header can store in one 4-bit field
+#define CANON_MAX_LENGTH 15
+
+void canon_assign(const uint8_t *code_lengths, uint64_t *codes);
+uint32_t canon_write_lengths(BitWriter *outbuf, const uint8_t *code_lengths);
+bool canon_read_lengths(BitReader *inbuf, uint8_t *code_lengths);
+bool canon_limit_lengths(const uint32_t *histogram, uint8_t max_length, uint8_t *code_lengths);
+bool canon_limit_lengths_arena(
+    Arena *arena, const uint32_t *histogram, uint8_t max_length, uint8_t *code_lengths);
+
+#endif
@@ -0,0 +1,51 @@
+#ifndef _DEC_TABLE_H
+#define _DEC_TABLE_H
+
+/*
+* File:     dectable.h
+* Purpose:  Header file for dectable.c, a table-driven Huffman decoder.
+*
+* A DecodeTable is indexed by the next DT_PRIMARY_BITS bits of the stream.
+* Codes that are longer than that continue in second-level tables (which
+* can nest further), so most symbols are decoded with a single lookup.
+* When codes are short, a second table indexed by DT_MULTI_BITS bits
+* returns up to DT_MULTI_SYMBOLS symbols per lookup.  dt_decode_streams()
+* decodes several sub-streams of one block in the same loop, so their
+* lookups can run in parallel on one core.
+*/
+
+#include "arena.h"
+#include "bitreader.h"
+#include "node.h"
+#include "tree.h"
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// width of the primary table that is indexed by the next bits of the stream
+#define DT_PRIMARY_BITS 11
+
+// width of the multi-symbol table and the most symbols one of its entries holds
+#define DT_MULTI_BITS    12
+#define DT_MULTI_SYMBOLS 4
+
+// the most sub-streams dt_decode_streams() decodes side by side, and how
+// many lookups each of them gets from one refill of its bit buffer
+#define DT_MAX_STREAMS    4
+#define DT_STREAM_LOOKUPS 3
+
+typedef struct DecodeTable DecodeTable;
+
+DecodeTable *dt_create(Node *tree);
+DecodeTable *dt_create_flat(const FlatTree *tree);
+DecodeTable *dt_create_from_codes(const uint64_t *codes, const uint8_t *code_lengths);
+DecodeTable *dt_create_from_codes_arena(
+    Arena *arena, const uint64_t *codes, const uint8_t *code_lengths);
+void dt_free(DecodeTable **dt);
+bool dt_multi_enable(DecodeTable *dt, bool enable);
+void dt_decode(DecodeTable *dt, BitReader *inbuf, uint8_t *out, size_t n);
+void dt_decode_streams(DecodeTable *dt, unsigned num_streams, const uint8_t *const *src,
+    const size_t *src_lengths, uint8_t *const *out, const size_t *out_lengths);
+
+#endif
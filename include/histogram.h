@@ -0,0 +1,24 @@
+#ifndef _HISTOGRAM_H
+#define _HISTOGRAM_H
+
+/*
+* File:     histogram.h
+* Purpose:  Header file for histogram.c, byte frequency counting.
+*
+* The counters of one table stall when the same byte repeats, because each
+* increment has to wait for the previous store to the same counter.  The
+* kernel spreads consecutive bytes over HISTOGRAM_TABLES sub-histograms and
+* reads 16 bytes per iteration with two 64-bit loads, then adds the
+* sub-histograms together.  Counts are 64 bits wide.
+*/
+
+#include <inttypes.h>
+#include <stddef.h>
+
+// the number of interleaved sub-histograms, one per byte of a 64-bit word
+#define HISTOGRAM_TABLES 8
+
+void histogram_count(const uint8_t *data, size_t n, uint64_t *histogram);
+void histogram_count_threads(const uint8_t *data, size_t n, uint64_t *histogram, unsigned threads);
+
+#endif
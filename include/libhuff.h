@@ -0,0 +1,225 @@
+#ifndef _LIBHUFF_H
+#define _LIBHUFF_H
+
+/*
+* File:     libhuff.h
+* Purpose:  Header file for libhuff, the compressor and decompressor behind
+*           huff and dehuff (huffenc.c and huffdec.c).
+*
+* huff_compress_buffer() writes exactly the bytes huff writes for the same
+* input: the block container of block.h.  huff_decompress_buffer() reads
+* every format dehuff reads.  A context keeps its threads, block buffers and
+* arenas from call to call, so once it has coded its largest input, further
+* calls with a context make no heap allocations.  The file entry points are
+* what the command-line tools use.  Functions that return a size return
+* HUFF_ERROR when they fail.  The library never writes to the terminal: a
+* file decoded with a context that fails leaves the reason in
+* huff_dctx_error(), and huff_status_message() says it in words.
+*
+* A HuffStream codes data that arrives in pieces, like zlib's z_stream: the
+* caller points next_in and next_out at its buffers, and each call consumes
+* and produces as much as it can, then returns.  Any split of the input or
+* the output is fine, down to single bytes.  The coders hold back at most one
+* block, so output starts once a block is complete (or flushed), however
+* long the stream.  Whole blocks are coded straight from the caller's input
+* and into the caller's output when they fit there.
+*
+* A HuffTable is a code fixed ahead of time for some kind of data.  A block
+* coded with one stores only the table's ID instead of its code lengths and
+* skips counting its bytes and building a tree, which is what matters for
+* small inputs.  A few tables are built in; others are trained on a sample
+* (see hufftrain) and must be given to the decompressor as well.  Every byte
+* value has a code in a table, so any data can be coded with any table.
+*/
+
+#include "bitreader.h"
+#include "bitwriter.h"
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+// the size returned on failure
+#define HUFF_ERROR ((size_t) -1)
+
+// the IDs of the built-in tables, and the lowest ID a trained table can have
+#define HUFF_TABLE_TEXT          1
+#define HUFF_TABLE_JSON          2
+#define HUFF_TABLE_SOURCE        3
+#define HUFF_TABLE_FIRST_TRAINED 128
+
+typedef struct HuffTable {
+    uint8_t id;
+    // a code for every byte value, and its canonical code with the first bit lowest
+    uint8_t code_lengths[256];
+    uint64_t codes[256];
+} HuffTable;
+
+// how a compression context codes its input
+typedef struct HuffParams {
+    // the number of input bytes in each block, 1 to BLOCK_MAX_SIZE
+    uint32_t block_size;
+    // the longest code, 1 to CANON_MAX_LENGTH
+    uint8_t max_length;
+    // the number of sub-streams in each block, 1 to BLOCK_MAX_STREAMS
+    uint8_t num_streams;
+    // the number of threads that code blocks, 0 means one per online core
+    unsigned threads;
+    // whether to time the stages in HuffStats, two clock reads per stage and block
+    bool timing;
+    // a table to code every block with, NULL to give every block its own
+    // code; a block the table would code worse than its bound gets its own
+    const HuffTable *table;
+    // whether a block without a table takes the built-in table that codes
+    // it in fewer bytes than its own code, if there is one
+    bool choose_table;
+} HuffParams;
+
+// the stages of coding that HuffStats times
+typedef enum HuffStage {
+    // reading the input and writing the output, on the calling thread
+    HUFF_STAGE_READ,
+    HUFF_STAGE_WRITE,
+    // compression: counting bytes, building the tree and limiting its code
+    // lengths, filling the code table, writing the code lengths and
+    // sub-stream table, and sizing and writing the codes
+    HUFF_STAGE_HISTOGRAM,
+    HUFF_STAGE_TREE,
+    HUFF_STAGE_CODES,
+    HUFF_STAGE_HEADER,
+    HUFF_STAGE_ENCODE,
+    // decompression: reading the code lengths and sub-stream table, building
+    // the decode table, and decoding
+    HUFF_STAGE_PARSE,
+    HUFF_STAGE_TABLE,
+    HUFF_STAGE_DECODE,
+    HUFF_NUM_STAGES
+} HuffStage;
+
+// what the last call of a context did
+typedef struct HuffStats {
+    uint64_t input_bytes;
+    uint64_t output_bytes;
+    uint64_t blocks;
+    // the blocks coded with a table instead of their own code
+    uint64_t table_blocks;
+    // the blocks stored as they are, and those of one byte value written as a run
+    uint64_t stored_blocks;
+    uint64_t run_blocks;
+    // the blocks with too many byte values for max_length bits, whose codes
+    // are limited to CANON_MAX_LENGTH bits instead
+    uint64_t widened_blocks;
+    // what the codes cost before and after the length limit, in bits
+    uint64_t optimal_bits;
+    uint64_t limited_bits;
+    // the uncompressed bytes, counted by the compressor; blocks coded with a
+    // given table are never counted
+    uint64_t histogram[256];
+    // the most leaves a block's code has, its deepest optimal tree and its longest code
+    uint16_t max_leaves;
+    uint8_t max_depth;
+    uint8_t max_code_length;
+    // the wall and CPU time of each stage in nanoseconds when timing is on,
+    // summed over the blocks, so over all threads
+    uint64_t wall_ns[HUFF_NUM_STAGES];
+    uint64_t cpu_ns[HUFF_NUM_STAGES];
+} HuffStats;
+
+typedef struct HuffCCtx HuffCCtx;
+typedef struct HuffDCtx HuffDCtx;
+
+// what huff_stream_compress() does with the input it has when it runs out
+typedef enum HuffFlush {
+    // keep a partial block for more input
+    HUFF_NO_FLUSH,
+    // code the partial block, so everything so far can be decoded
+    HUFF_FLUSH,
+    // code the partial block and end the stream
+    HUFF_FINISH
+} HuffFlush;
+
+typedef enum HuffStatus {
+    // progress was made, or more input or output space is needed
+    HUFF_OK,
+    // the whole stream has been produced or consumed
+    HUFF_STREAM_END,
+    // the input is not a valid stream
+    HUFF_DATA_ERROR,
+    HUFF_MEM_ERROR,
+    // the input is in none of the formats the decompressor reads
+    HUFF_FORMAT_ERROR,
+    // a block names a trained table the decompressor was not given
+    HUFF_TABLE_ERROR,
+    // a file could not be read or written
+    HUFF_IO_ERROR
+} HuffStatus;
+
+// what huff_decompress_indexed() did with a file
+typedef enum HuffIndexed {
+    // the file was decoded
+    HUFF_INDEXED_DONE,
+    // nothing was written: the input has no usable index or the output
+    // cannot be written at an offset, so the file is for huff_decompress_file()
+    HUFF_INDEXED_UNUSABLE,
+    // the output was started, but a block did not decode
+    HUFF_INDEXED_FAILED
+} HuffIndexed;
+
+typedef struct HuffStreamEncoder HuffStreamEncoder;
+typedef struct HuffStreamDecoder HuffStreamDecoder;
+
+typedef struct HuffStream {
+    // the next input byte and how many follow it, moved on by each call
+    const uint8_t *next_in;
+    size_t avail_in;
+    uint64_t total_in;
+    // where the next output byte goes and how much room is left there
+    uint8_t *next_out;
+    size_t avail_out;
+    uint64_t total_out;
+    // the state of the coder, set up by the init function
+    HuffStreamEncoder *encoder;
+    HuffStreamDecoder *decoder;
+} HuffStream;
+
+void huff_params_default(HuffParams *params);
+const HuffTable *huff_table_builtin(uint8_t id);
+const HuffTable *huff_table_by_name(const char *name);
+HuffTable *huff_table_create(const uint64_t *histogram, uint8_t id, uint8_t max_length);
+HuffTable *huff_table_load(const char *path);
+bool huff_table_save(const HuffTable *table, const char *path);
+void huff_table_free(HuffTable **table);
+
+const char *huff_stage_name(HuffStage stage);
+const char *huff_status_message(HuffStatus status);
+HuffCCtx *huff_cctx_create(const HuffParams *params);
+void huff_cctx_free(HuffCCtx **ctx);
+const HuffStats *huff_cctx_stats(const HuffCCtx *ctx);
+size_t huff_cctx_bound(const HuffCCtx *ctx, size_t n);
+size_t huff_compress_bound(size_t n);
+size_t huff_compress_buffer(const uint8_t *src, size_t n, uint8_t *dst, size_t cap);
+size_t huff_compress_ctx(HuffCCtx *ctx, const uint8_t *src, size_t n, uint8_t *dst, size_t cap);
+bool huff_compress_file(HuffCCtx *ctx, BitWriter *outbuf, FILE *fin, const uint8_t *data, size_t n);
+
+bool huff_stream_compress_init(HuffStream *strm, const HuffParams *params);
+HuffStatus huff_stream_compress(HuffStream *strm, HuffFlush flush);
+void huff_stream_compress_end(HuffStream *strm);
+
+HuffDCtx *huff_dctx_create(unsigned threads);
+void huff_dctx_free(HuffDCtx **ctx);
+void huff_dctx_set_timing(HuffDCtx *ctx, bool timing);
+bool huff_dctx_add_table(HuffDCtx *ctx, const HuffTable *table);
+const HuffStats *huff_dctx_stats(const HuffDCtx *ctx);
+HuffStatus huff_dctx_error(const HuffDCtx *ctx);
+size_t huff_decompressed_size(const uint8_t *src, size_t n);
+size_t huff_decompress_buffer(const uint8_t *src, size_t n, uint8_t *dst, size_t cap);
+size_t huff_decompress_ctx(HuffDCtx *ctx, const uint8_t *src, size_t n, uint8_t *dst, size_t cap);
+HuffIndexed huff_decompress_indexed(HuffDCtx *ctx, FILE *fout, const char *finame);
+bool huff_decompress_file(HuffDCtx *ctx, FILE *fout, BitReader *inbuf);
+
+bool huff_stream_decompress_init(HuffStream *strm);
+HuffStatus huff_stream_decompress(HuffStream *strm);
+void huff_stream_decompress_end(HuffStream *strm);
+
+#endif
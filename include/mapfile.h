@@ -0,0 +1,24 @@
+#ifndef _MAP_FILE_H
+#define _MAP_FILE_H
+
+/*
+* File:     mapfile.h
+* Purpose:  Header file for mapfile.c, memory-mapped input and output files.
+*
+* A regular file is mapped so the coders can work on its bytes in place,
+* without copying them through stdio buffers.  When a file cannot be mapped
+* (a pipe, a terminal, an empty file) the open functions return NULL and
+* the caller falls back to reading or writing large blocks.
+*/
+
+#include <inttypes.h>
+
+typedef struct MappedFile MappedFile;
+
+MappedFile *map_open_read(const char *filename);
+MappedFile *map_open_write(int fd, uint64_t size);
+void map_close(MappedFile **map);
+uint8_t *map_data(MappedFile *map);
+uint64_t map_size(MappedFile *map);
+
+#endif
@@ -0,0 +1,30 @@
+#ifndef _METRICS_H
+#define _METRICS_H
+
+/*
+* File:     metrics.h
+* Purpose:  Header file for metrics.c, the JSON record huff and dehuff write
+*           with --metrics.
+*
+* metrics_start() notes the clocks and the heap allocation counters and,
+* where the kernel allows it, opens hardware counters with perf_event_open()
+* for the calling thread and every thread it starts afterwards.  It is called
+* before the coding context is created, and metrics_stop() after the context
+* is freed: the counts of a thread are only added in once it has exited.
+* Counters the kernel refuses are left out of the record, they never fail
+* the run.
+*/
+
+#include "libhuff.h"
+
+#include <stdbool.h>
+
+typedef struct Metrics Metrics;
+
+Metrics *metrics_start(void);
+void metrics_stop(Metrics *metrics);
+bool metrics_write(const Metrics *metrics, const char *path, const char *tool,
+    const HuffStats *stats);
+void metrics_free(Metrics **metrics);
+
+#endif
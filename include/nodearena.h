@@ -0,0 +1,30 @@
+#ifndef _NODEARENA_H
+#define _NODEARENA_H
+
+/*
+* File:     nodearena.h
+* Purpose:  Header file for the arena-backed Node and PriorityQueue helpers
+*           in node.c and pq.c, kept apart from the node.h and pq.h
+*           interfaces.
+*
+* Nodes and queues created from an arena are released with the arena: arena
+* nodes are never passed to node_free(), and pq_free() leaves an arena
+* queue's trees alone.  node_free_tree() frees a whole node_create() tree
+* without recursion.  The heap allocation counters let tests check that a
+* loop builds its trees without calling malloc().
+*/
+
+#include "arena.h"
+#include "node.h"
+#include "pq.h"
+
+#include <inttypes.h>
+
+Node *node_create_arena(Arena *arena, uint8_t symbol, uint32_t weight);
+void node_free_tree(Node **tree);
+uint64_t node_heap_allocations(void);
+
+PriorityQueue *pq_create_arena(Arena *arena);
+uint64_t pq_heap_allocations(void);
+
+#endif
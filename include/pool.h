@@ -0,0 +1,36 @@
+#ifndef _POOL_H
+#define _POOL_H
+
+/*
+* File:     pool.h
+* Purpose:  Header file for pool.c, a fixed-size pool of worker threads.
+*
+* Jobs are owned by the caller, so submitting one allocates nothing.  Jobs
+* start in the order they are submitted; pool_wait_job() blocks until a
+* given job has finished, which lets the caller consume results in order.
+*/
+
+#include <stdbool.h>
+
+// the most worker threads a pool can have
+#define POOL_MAX_THREADS 256
+
+typedef struct Pool Pool;
+
+typedef struct PoolJob PoolJob;
+
+struct PoolJob {
+    void (*run)(void *arg);
+    void *arg;
+    // set by the pool; read it only through pool_wait_job()
+    bool done;
+    PoolJob *next;
+};
+
+Pool *pool_create(unsigned threads);
+void pool_free(Pool **pool);
+void pool_submit(Pool *pool, PoolJob *job, void (*run)(void *arg), void *arg);
+void pool_wait_job(Pool *pool, PoolJob *job);
+unsigned pool_online_cores(void);
+
+#endif
@@ -0,0 +1,28 @@
+#ifndef _TIMER_H
+#define _TIMER_H
+
+/*
+* File:     timer.h
+* Purpose:  Header file for timer.c, monotonic and CPU clocks for measuring stages.
+*
+* A TimerMark holds both clocks at one moment.  timer_lap() adds the time
+* since the mark to a stage's totals and moves the mark on, so the stages of
+* a piece of work are timed back to back with one pair of clock reads each.
+* CPU time is the calling thread's, so the difference between the two shows
+* time spent waiting, for I/O or for other threads.
+*/
+
+#include <inttypes.h>
+
+typedef struct TimerMark {
+    uint64_t wall_ns;
+    uint64_t cpu_ns;
+} TimerMark;
+
+uint64_t timer_now_ns(void);
+uint64_t timer_thread_cpu_ns(void);
+uint64_t timer_process_cpu_ns(void);
+TimerMark timer_mark(void);
+void timer_lap(TimerMark *mark, uint64_t *wall_ns, uint64_t *cpu_ns);
+
+#endif
@@ -0,0 +1,28 @@
+#ifndef _TRACE_H
+#define _TRACE_H
+
+/*
+* File:     trace.h
+* Purpose:  Header file for trace.c, a timeline of coding stages in Chrome
+*           trace-event format, for Perfetto or chrome://tracing.
+*
+* Between trace_start() and trace_write(), trace_span() records that a stage
+* of a block ran from one monotonic time (timer_now_ns()) to another, on the
+* calling thread.  Every thread appends to a buffer of its own, found through
+* a thread-local pointer, so recording takes no lock; the buffers are linked
+* into a list once, when a thread records its first span.  While no trace is
+* being recorded trace_span() only loads one flag.  trace_write() must be
+* called once the threads that recorded spans are done.
+*/
+
+#include <inttypes.h>
+#include <stdbool.h>
+
+// the block number of a span that is not about one block
+#define TRACE_NO_BLOCK UINT64_MAX
+
+void trace_start(void);
+void trace_span(const char *name, uint64_t block, uint64_t start_ns, uint64_t end_ns);
+bool trace_write(const char *path);
+
+#endif
@@ -0,0 +1,50 @@
+#ifndef _TREE_H
+#define _TREE_H
+
+/*
+* File:     tree.h
+* Purpose:  Header file for tree.c, Huffman tree construction without a
+*           linked-list priority queue.
+*
+* tree_build() uses the two-queue method: the leaves are sorted once, and
+* the merged nodes are created in order of weight, so they form a second
+* queue that is already sorted.  Each step takes the two smallest fronts,
+* which makes the build O(n) after the sort but for ties.  Trees are ordered
+* like the PriorityQueue orders them (weight, then symbol, merged nodes count
+* as symbol 0), and full ties are broken the way enqueue() inserts: a new
+* merged node goes in front of the nodes it ties with, or second when they
+* are at the front of the queue.  So the tree is the PriorityQueue's tree,
+* node for node.  All nodes live in a caller's array.
+*
+* A FlatTree is the same tree without pointers: one 16-bit word per node,
+* laid out breadth-first with the root at index 0.  A leaf is TREE_LEAF
+* ORed with its symbol; an internal node is the index of its left child,
+* and its right child comes right after it.  A full tree takes about 1 KB.
+*/
+
+#include "bitreader.h"
+#include "node.h"
+
+#include <inttypes.h>
+#include <stdbool.h>
+
+// the most nodes a tree over 256 symbols has
+#define TREE_MAX_NODES 511
+
+// the flag that marks a leaf of a FlatTree
+#define TREE_LEAF 0x8000
+
+typedef struct FlatTree {
+    uint16_t nodes[TREE_MAX_NODES];
+    uint16_t num_nodes;
+} FlatTree;
+
+bool tree_less_than(const Node *n1, const Node *n2);
+Node *tree_build(const uint32_t *histogram, Node *nodes, uint16_t *num_leaves);
+
+uint16_t tree_build_flat(const uint32_t *histogram, FlatTree *tree);
+bool tree_read_flat(BitReader *inbuf, uint16_t num_leaves, FlatTree *tree);
+void tree_flat_codes(const FlatTree *tree, uint64_t *codes, uint8_t *code_lengths);
+uint8_t tree_flat_decode(const FlatTree *tree, BitReader *inbuf);
+
+#endif
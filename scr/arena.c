@@ -0,0 +1,118 @@
+#include "arena.h"
+
+#include <stdalign.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+
+// every allocation is aligned for any type
+#define ARENA_ALIGN alignof(max_align_t)
+
+typedef struct ArenaChunk ArenaChunk;
+
+struct ArenaChunk {
+    ArenaChunk *next;
+    size_t size;
+    size_t used;
+    alignas(max_align_t) unsigned char data[];
+};
+
+struct Arena {
+    // the chunks in the order they were first used; current is being filled
+    ArenaChunk *first;
+    ArenaChunk *current;
+    size_t chunk_size;
+};
+
+// the number of chunks taken from the heap by all arenas
+static atomic_uint_fast64_t arena_allocations;
+
+// function that allocates a chunk with room for at least size bytes
+static ArenaChunk *arena_new_chunk(size_t size) {
+    ArenaChunk *chunk = (ArenaChunk *) malloc(sizeof(ArenaChunk) + size);
+    if (chunk == NULL) {
+        return NULL;
+    }
+    atomic_fetch_add(&arena_allocations, 1);
+    chunk->next = NULL;
+    chunk->size = size;
+    chunk->used = 0;
+    return chunk;
+}
+
+// function that creates an empty arena whose chunks hold chunk_size bytes
+// (0 means ARENA_CHUNK_SIZE); the first chunk is allocated on first use
+Arena *arena_create(size_t chunk_size) {
+    Arena *arena = (Arena *) calloc(1, sizeof(Arena));
+    if (arena == NULL) {
+        return NULL;
+    }
+    arena->chunk_size = chunk_size ? chunk_size : ARENA_CHUNK_SIZE;
+    return arena;
+}
+
+// function that frees the arena and, at once, everything allocated in it
+void arena_free(Arena **arena) {
+    if (*arena != NULL) {
+        ArenaChunk *chunk = (*arena)->first;
+        while (chunk != NULL) {
+            ArenaChunk *next = chunk->next;
+            free(chunk);
+            chunk = next;
+        }
+        free(*arena);
+        *arena = NULL;
+    }
+}
+
+// function that returns size bytes of uninitialized memory from the arena,
+// or NULL when the heap is exhausted
+void *arena_alloc(Arena *arena, size_t size) {
+    size = (size + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+    ArenaChunk *chunk = arena->current;
+    // move on through chunks kept by arena_reset() until one has room
+    while (chunk != NULL && chunk->size - chunk->used < size) {
+        if (chunk->next == NULL || chunk->next->size < size) {
+            chunk = NULL;
+            break;
+        }
+        chunk = chunk->next;
+        chunk->used = 0;
+        arena->current = chunk;
+    }
+    if (chunk == NULL) {
+        // a new chunk goes right after the current one and replaces a kept
+        // chunk there that is too small, so the list does not keep growing
+        chunk = arena_new_chunk(size > arena->chunk_size ? size : arena->chunk_size);
+        if (chunk == NULL) {
+            return NULL;
+        }
+        if (arena->current == NULL) {
+            arena->first = chunk;
+        } else {
+            ArenaChunk *small = arena->current->next;
+            if (small != NULL) {
+                chunk->next = small->next;
+                free(small);
+            }
+            arena->current->next = chunk;
+        }
+        arena->current = chunk;
+    }
+    void *p = chunk->data + chunk->used;
+    chunk->used += size;
+    return p;
+}
+
+// function that makes all of the arena's memory available again; the chunks
+// are kept for the next allocations, later chunks are rewound when reached
+void arena_reset(Arena *arena) {
+    arena->current = arena->first;
+    if (arena->first != NULL) {
+        arena->first->used = 0;
+    }
+}
+
+// function that returns how many chunks all arenas have taken from the heap
+uint64_t arena_heap_allocations(void) {
+    return atomic_load(&arena_allocations);
+}
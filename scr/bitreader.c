@@ -1,12 +1,30 @@
 #include "bitreader.h"
 
+#include "bitio_ext.h"
+
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+
+// size of the input buffer that is filled with one fread() at a time
+#define BR_BUFFER_SIZE (64 * 1024)
 
 struct BitReader {
+    // NULL when the reader reads a caller's memory buffer instead of a file
     FILE *underlying_stream;
-    uint8_t byte;
-    uint8_t bit_position;
+    // upcoming bits, the next bit to be read is the least significant bit
+    uint64_t bit_buffer;
+    // number of valid bits in bit_buffer
+    uint8_t bit_count;
+    // how many of the top bits of bit_buffer are zeros past the end of the input
+    uint8_t zero_bits;
+    // unread part of the input buffer
+    const uint8_t *next;
+    const uint8_t *end;
+    // set when the reader lives in an arena and is not freed on close
+    bool in_arena;
+    // the buffer of a reader that reads a file
+    uint8_t buffer[];
 };
 
 // all the functions in this file are written based on the sudo code given in asgn8.pdf
@@ -14,12 +32,12 @@ struct BitReader {
 //function that opens the file and allocates memory to read from the file
 BitReader *bit_read_open(const char *filename) {
     // allocate a new BitWriter
-    BitReader *reader = calloc(1, sizeof(BitReader));
+    BitReader *reader = calloc(1, sizeof(BitReader) + BR_BUFFER_SIZE);
     if (reader == NULL) {
         return NULL;
     }
-    // open the filename for writing as a binary file
-    FILE *f = fopen(filename, "r");
+    // open the filename for reading as a binary file, "-" is the standard input
+    FILE *f = strcmp(filename, "-") == 0 ? stdin : fopen(filename, "r");
     if (f == NULL) {
         fprintf(stderr, "error reading input file %s\n", filename);
         free(reader);
@@ -27,86 +45,170 @@ BitReader *bit_read_open(const char *filename) {
     }
     // store f in the BitWriter field underlying_stream
     reader->underlying_stream = f;
-    // clear the byte and bit_positions fields of the BitWriter to 0
-    reader->byte = 0;
-    reader->bit_position = 8;
+    // start with an empty bit buffer and an empty input buffer
+    reader->bit_buffer = 0;
+    reader->bit_count = 0;
+    reader->next = reader->buffer;
+    reader->end = reader->buffer;
+    return reader;
+}
+
+// function that opens a reader for the n bytes at src
+BitReader *bit_read_open_memory(const uint8_t *src, size_t n) {
+    return bit_read_open_arena(NULL, src, n);
+}
+
+// function that opens the same reader in an arena (the heap when arena is NULL)
+BitReader *bit_read_open_arena(Arena *arena, const uint8_t *src, size_t n) {
+    BitReader *reader = arena != NULL ? arena_alloc(arena, sizeof(BitReader))
+                                      : malloc(sizeof(BitReader));
+    if (reader == NULL) {
+        return NULL;
+    }
+    reader->in_arena = arena != NULL;
+    reader->underlying_stream = NULL;
+    reader->bit_buffer = 0;
+    reader->bit_count = 0;
+    reader->zero_bits = 0;
+    reader->next = src;
+    reader->end = src + n;
     return reader;
 }
 
 // fucntion that closes the opened file and frees the memory used in opening
 void bit_read_close(BitReader **pbuf) {
     if (*pbuf != NULL) {
-        if ((*pbuf)->bit_position > 0) {
-            // flush any remaining bits in the byte buffer to the underlying_stream
-            fputc((*pbuf)->byte, (*pbuf)->underlying_stream);
-        }
         // close the underlying_stream
-        fclose((*pbuf)->underlying_stream);
-        // free the BitWriter
-        free(*pbuf);
+        if ((*pbuf)->underlying_stream != NULL && (*pbuf)->underlying_stream != stdin) {
+            fclose((*pbuf)->underlying_stream);
+        }
+        // free the BitReader, one in an arena goes with the arena
+        if (!(*pbuf)->in_arena) {
+            free(*pbuf);
+        }
         // set the *pbuf pointer to NULL
         *pbuf = NULL;
     }
 }
 
-// function to read a bit from a bit reader
-uint8_t bit_read_bit(BitReader *buf) {
-    // if bit position exceeds 7 (end of byte), get the next byte
-    if (buf->bit_position > 7) {
-        int byte = fgetc(buf->underlying_stream);
-        if (byte == EOF) {
-            return 1;
+// function that tops the bit buffer up to at least BR_PEEK_MAX bits
+static void bit_read_refill(BitReader *buf) {
+    // fast path: load 8 bytes at once and keep only the whole bytes that fit
+    if (buf->end - buf->next >= 8) {
+        uint64_t word;
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+        memcpy(&word, buf->next, sizeof(word));
+#else
+        word = 0;
+        for (int i = 0; i < 8; i++) {
+            word |= (uint64_t) buf->next[i] << (8 * i);
         }
-        buf->byte = (unsigned char) byte;
-        buf->bit_position = 0;
+#endif
+        // bits of a byte that only partly fits are ORed in again by the next refill
+        buf->bit_buffer |= word << buf->bit_count;
+        uint8_t nbytes = (uint8_t) ((64 - buf->bit_count) >> 3);
+        buf->next += nbytes;
+        buf->bit_count = (uint8_t) (buf->bit_count + 8 * nbytes);
+        return;
+    }
+    // slow path near the end of the input buffer: one byte at a time
+    while (buf->bit_count <= 56) {
+        if (buf->next == buf->end) {
+            size_t n = 0;
+            if (buf->underlying_stream != NULL) {
+                n = fread(buf->buffer, 1, BR_BUFFER_SIZE, buf->underlying_stream);
+            }
+            if (n == 0) {
+                // past the end of the file every bit reads as 0
+                uint8_t real = buf->bit_count > buf->zero_bits
+                                   ? (uint8_t) (buf->bit_count - buf->zero_bits)
+                                   : 0;
+                buf->zero_bits = (uint8_t) (64 - real);
+                buf->bit_count = 64;
+                return;
+            }
+            buf->next = buf->buffer;
+            buf->end = buf->buffer + n;
+            if (n >= 8) {
+                bit_read_refill(buf);
+                return;
+            }
+        }
+        buf->bit_buffer |= (uint64_t) *buf->next++ << buf->bit_count;
+        buf->bit_count += 8;
     }
-    // extract the current bit from the byte and increment bit position
-    uint8_t bit = (buf->byte >> buf->bit_position) & 1;
-    buf->bit_position += 1;
-    return bit;
+}
+
+// function that returns the next n bits (n <= BR_PEEK_MAX) without consuming them
+uint64_t bit_peek(BitReader *buf, uint8_t n) {
+    if (buf->bit_count < n) {
+        bit_read_refill(buf);
+    }
+    return buf->bit_buffer & (((uint64_t) 1 << n) - 1);
+}
+
+// function that drops n bits that were looked at with bit_peek()
+void bit_consume(BitReader *buf, uint8_t n) {
+    buf->bit_buffer >>= n;
+    buf->bit_count = (uint8_t) (buf->bit_count - n);
+}
+
+// function that reads n bits (n <= BR_PEEK_MAX) in one operation
+uint64_t bit_read_bits(BitReader *buf, uint8_t n) {
+    uint64_t bits = bit_peek(buf, n);
+    bit_consume(buf, n);
+    return bits;
+}
+
+// function that skips the rest of the current byte
+void bit_read_align(BitReader *buf) {
+    // whole bytes are loaded at a time, so the partial byte is bit_count % 8 bits
+    bit_consume(buf, buf->bit_count % 8);
+}
+
+// function that reads n whole bytes into dst; the stream must be on a byte boundary.
+// It returns false when the input ends first, the bytes past its end read as 0.
+bool bit_read_bytes(BitReader *buf, uint8_t *dst, size_t n) {
+    // the bytes already in the bit buffer come first, unless they are past the end
+    bool ok = true;
+    while (n > 0 && buf->bit_count >= 8) {
+        ok = ok && buf->bit_count >= buf->zero_bits + 8;
+        *dst++ = (uint8_t) bit_read_bits(buf, 8);
+        --n;
+    }
+    // then the rest of the input buffer
+    size_t avail = (size_t) (buf->end - buf->next);
+    size_t chunk = n < avail ? n : avail;
+    memcpy(dst, buf->next, chunk);
+    buf->next += chunk;
+    dst += chunk;
+    n -= chunk;
+    // large reads go straight to the file
+    if (n > 0 && buf->underlying_stream != NULL) {
+        size_t got = fread(dst, 1, n, buf->underlying_stream);
+        dst += got;
+        n -= got;
+    }
+    memset(dst, 0, n);
+    return ok && n == 0;
+}
+
+// function to read a bit from a bit reader
+uint8_t bit_read_bit(BitReader *buf) {
+    return (uint8_t) bit_read_bits(buf, 1);
 }
 
 // function to read 8 bits from the BitReader
 uint8_t bit_read_uint8(BitReader *buf) {
-    // initialize byte as 0
-    uint8_t byte = 0x00;
-    // 0 to 7 means less than 8
-    for (int i = 0; i < 8; i++) {
-        // read a bit from the BitReader
-        uint8_t b = bit_read_bit(buf);
-        // set the bit at position i in the byte
-        byte |= (b << i);
-    }
-    // eturn the byte variable
-    return byte;
+    return (uint8_t) bit_read_bits(buf, 8);
 }
 
 // read a 16-bit unsigned integer from a BitReader
 uint16_t bit_read_uint16(BitReader *buf) {
-    // initialize word as 0
-    uint16_t word = 0x0000;
-    // 0 to 15 means less than 16
-    for (int i = 0; i < 16; i++) {
-        // read a bit from the buffer
-        uint16_t b = bit_read_bit(buf);
-        // bitwise OR to append the bit to the word
-        word |= (b << i);
-    }
-    // return the final 16-bit word
-    return word;
+    return (uint16_t) bit_read_bits(buf, 16);
 }
 
 // function to read 32 bits from buffer and convert to uint32_t
 uint32_t bit_read_uint32(BitReader *buf) {
-    // initialize word as 0
-    uint32_t word = 0x00000000;
-    // 0 to 31 means less than 32
-    for (int i = 0; i < 32; i++) {
-        // read a bit from buffer
-        uint32_t b = bit_read_bit(buf);
-        // shift the bit to the corresponding position and OR with word
-        word |= (b << i);
-    }
-    // return the 8-bit unsigned integer
-    return word;
+    return (uint32_t) bit_read_bits(buf, 32);
 }
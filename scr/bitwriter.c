@@ -1,96 +1,221 @@
 #include "bitwriter.h"
 
+#include "bitio_ext.h"
+
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+
+// size of the output buffer that collects finished bytes before they are written
+#define BW_BUFFER_SIZE (64 * 1024)
 
 struct BitWriter {
+    // NULL when the writer fills a caller's memory buffer instead of a file
     FILE *underlying_stream;
-    uint8_t byte;
-    uint8_t bit_position;
+    // pending bits, the oldest bit is the least significant bit
+    uint64_t accumulator;
+    // number of valid bits in accumulator
+    uint8_t bit_count;
+    // finished bytes, waiting to be written when writing to a file
+    uint8_t *buffer;
+    size_t buffer_size;
+    size_t buffer_used;
+    // set when the writer lives in an arena and is not freed on close
+    bool in_arena;
+    // the buffer of a writer that writes to a file
+    uint8_t storage[];
 };
 
 // all the functions in this file are written based on the sudo code given in asgn8.pdf
 
+// function that writes the finished bytes of the buffer to the underlying stream
+static void bit_write_flush_buffer(BitWriter *buf) {
+    // a memory buffer cannot be flushed, the bytes stay where they are
+    if (buf->buffer_used == 0 || buf->underlying_stream == NULL) {
+        return;
+    }
+    if (fwrite(buf->buffer, 1, buf->buffer_used, buf->underlying_stream) != buf->buffer_used) {
+        // handle error: Could not write bytes to underlying stream
+        fprintf(stderr, "Error writing to stream.\n");
+    }
+    buf->buffer_used = 0;
+}
+
+// function that moves every whole byte of the accumulator into the buffer
+static void bit_write_drain(BitWriter *buf) {
+    // make sure 8 bytes fit so the accumulator can be stored in one go
+    if (buf->buffer_size - buf->buffer_used < 8) {
+        bit_write_flush_buffer(buf);
+    }
+    uint8_t *p = buf->buffer + buf->buffer_used;
+    uint64_t acc = buf->accumulator;
+    // only the whole bytes count, the partial byte stays in the accumulator
+    uint8_t nbytes = buf->bit_count / 8;
+    size_t stored = nbytes;
+    if (buf->buffer_size - buf->buffer_used >= 8) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+        // the accumulator is already in stream order on little-endian hosts
+        memcpy(p, &acc, sizeof(acc));
+#else
+        for (int i = 0; i < 8; i++) {
+            p[i] = (uint8_t) (acc >> (8 * i));
+        }
+#endif
+    } else {
+        // the end of a memory buffer: store the bytes that still fit and drop
+        // the rest, so the accumulator empties even when the buffer is full
+        if (stored > buf->buffer_size - buf->buffer_used) {
+            stored = buf->buffer_size - buf->buffer_used;
+        }
+        for (size_t i = 0; i < stored; i++) {
+            p[i] = (uint8_t) (acc >> (8 * i));
+        }
+    }
+    buf->buffer_used += stored;
+    buf->bit_count = (uint8_t) (buf->bit_count - 8 * nbytes);
+    buf->accumulator = nbytes == 8 ? 0 : acc >> (8 * nbytes);
+}
+
 // function that opens binary file for write using fopen() and return a pointer
 BitWriter *bit_write_open(const char *filename) {
-    // allocate a new BitWriter
-    BitWriter *writer = calloc(1, sizeof(BitWriter));
-    // open the filename for writing as a binary file
-    FILE *f = fopen(filename, "w");
-    if (f == NULL || writer == NULL) {
+    // allocate a new BitWriter together with its buffer
+    BitWriter *writer = calloc(1, sizeof(BitWriter) + BW_BUFFER_SIZE);
+    if (writer == NULL) {
+        return NULL;
+    }
+    // open the filename for writing as a binary file, "-" is the standard output
+    FILE *f = strcmp(filename, "-") == 0 ? stdout : fopen(filename, "w");
+    if (f == NULL) {
+        free(writer);
         return NULL;
     }
     // store f in the BitWriter field underlying_stream
     writer->underlying_stream = f;
-    // clear the byte and bit_positions fields of the BitWriter to 0
-    writer->byte = 0;
-    writer->bit_position = 0;
+    // clear the accumulator and the buffer
+    writer->accumulator = 0;
+    writer->bit_count = 0;
+    writer->buffer = writer->storage;
+    writer->buffer_size = BW_BUFFER_SIZE;
+    writer->buffer_used = 0;
+    return writer;
+}
+
+// function that opens a writer that fills the capacity bytes at dst
+BitWriter *bit_write_open_memory(uint8_t *dst, size_t capacity) {
+    return bit_write_open_arena(NULL, dst, capacity);
+}
+
+// function that opens the same writer in an arena (the heap when arena is NULL)
+BitWriter *bit_write_open_arena(Arena *arena, uint8_t *dst, size_t capacity) {
+    BitWriter *writer = arena != NULL ? arena_alloc(arena, sizeof(BitWriter))
+                                      : malloc(sizeof(BitWriter));
+    if (writer == NULL) {
+        return NULL;
+    }
+    memset(writer, 0, sizeof(BitWriter));
+    writer->in_arena = arena != NULL;
+    writer->underlying_stream = NULL;
+    writer->buffer = dst;
+    writer->buffer_size = capacity;
+    writer->buffer_used = 0;
     return writer;
 }
 
 // function that closes binary file for write using fclose()
 void bit_write_close(BitWriter **pbuf) {
     if (*pbuf != NULL) {
-        if ((*pbuf)->bit_position > 0) {
-            // flush any remaining bits in the byte buffer to the underlying_stream
-            fputc((*pbuf)->byte, (*pbuf)->underlying_stream);
+        // move the whole bytes out of the accumulator
+        bit_write_drain(*pbuf);
+        if ((*pbuf)->bit_count > 0) {
+            // flush the last partial byte, the unused high bits are zero
+            (*pbuf)->bit_count = 8;
+            bit_write_drain(*pbuf);
+        }
+        // write everything that is left in the buffer
+        bit_write_flush_buffer(*pbuf);
+        // close the underlying_stream, the standard output is only flushed
+        if ((*pbuf)->underlying_stream == stdout) {
+            fflush(stdout);
+        } else if ((*pbuf)->underlying_stream != NULL) {
+            fclose((*pbuf)->underlying_stream);
+        }
+        // free the BitWriter, one in an arena goes with the arena
+        if (!(*pbuf)->in_arena) {
+            free(*pbuf);
         }
-        // close the underlying_stream
-        fclose((*pbuf)->underlying_stream);
-        // free the BitWriter
-        free(*pbuf);
         // set the *pbuf pointer to NULL
         *pbuf = NULL;
     }
 }
 
-// function that writes a single bit
-void bit_write_bit(BitWriter *buf, uint8_t x) {
-    if (buf->bit_position > 7) {
-        // flush the byte buffer to the underlying stream
-        if (fputc(buf->byte, buf->underlying_stream) == EOF) {
-            // handle error: Could not write byte to underlying stream
-            fprintf(stderr, "Error reading from stream.\n");
+// function that writes the low nbits of value, least significant bit first
+void bit_write_bits(BitWriter *buf, uint64_t value, uint8_t nbits) {
+    if (nbits == 0) {
+        return;
+    }
+    // split wide values so the accumulator never overflows
+    if (nbits > 56) {
+        bit_write_bits(buf, value, 32);
+        value >>= 32;
+        nbits -= 32;
+    }
+    // clear any bits above nbits
+    if (nbits < 64) {
+        value &= ((uint64_t) 1 << nbits) - 1;
+    }
+    // make room when the new bits would not fit in the accumulator
+    if (buf->bit_count + nbits > 64) {
+        bit_write_drain(buf);
+    }
+    buf->accumulator |= value << buf->bit_count;
+    buf->bit_count = (uint8_t) (buf->bit_count + nbits);
+}
+
+// function that pads the stream with 0 bits up to the next byte boundary
+void bit_write_align(BitWriter *buf) {
+    // the bits above bit_count are already 0
+    buf->bit_count = (uint8_t) ((buf->bit_count + 7) & ~7);
+}
+
+// function that writes n whole bytes; the stream must be on a byte boundary
+void bit_write_bytes(BitWriter *buf, const uint8_t *data, size_t n) {
+    // move the pending bytes out so the accumulator is empty
+    bit_write_drain(buf);
+    if (buf->underlying_stream != NULL && n > buf->buffer_size - buf->buffer_used) {
+        // large writes go straight to the file
+        bit_write_flush_buffer(buf);
+        if (n >= buf->buffer_size) {
+            if (fwrite(data, 1, n, buf->underlying_stream) != n) {
+                fprintf(stderr, "Error writing to stream.\n");
+            }
+            return;
         }
-        // clear the byte buffer and reset the bit position
-        buf->byte = 0;
-        buf->bit_position = 0;
     }
-    // set the bit_position bit of the byte to x
-    buf->byte |= (x & 1) << buf->bit_position;
-    // increment the bit position
-    buf->bit_position++;
+    if (n > buf->buffer_size - buf->buffer_used) {
+        // the bytes past the end of a memory buffer are dropped
+        n = buf->buffer_size - buf->buffer_used;
+    }
+    memcpy(buf->buffer + buf->buffer_used, data, n);
+    buf->buffer_used += n;
+}
+
+// function that writes a single bit
+void bit_write_bit(BitWriter *buf, uint8_t x) {
+    bit_write_bits(buf, x & 1, 1);
 }
 
 // funciton that writes 8 bits at a time
 void bit_write_uint8(BitWriter *buf, uint8_t x) {
-    // 0 to 7 means less than 8
-    for (int i = 0; i < 8; i++) {
-        // check if the LSB of x is 1
-        bit_write_bit(buf, x & 1);
-        // shift x right by 1 bit, effectively discarding the LSB of x
-        x >>= 1;
-    }
+    bit_write_bits(buf, x, 8);
 }
 
 // funciton that writes 16 bits at a time
 void bit_write_uint16(BitWriter *buf, uint16_t x) {
-    // 0 to 15 means less than 16
-    for (int i = 0; i < 16; i++) {
-        // check if the LSB of x is 1
-        bit_write_bit(buf, x & 1);
-        // shift x right by 1 bit, effectively discarding the LSB of x
-        x >>= 1;
-    }
+    bit_write_bits(buf, x, 16);
 }
 
 // function that writes 32 bits at a time
 void bit_write_uint32(BitWriter *buf, uint32_t x) {
-    // 0 to 31 means less than 32
-    for (int i = 0; i < 32; i++) {
-        // check if the LSB of x is 1
-        bit_write_bit(buf, x & 1);
-        // shift x right by 1 bit, effectively discarding the LSB of x
-        x >>= 1;
-    }
+    bit_write_bits(buf, x, 32);
 }
@@ -0,0 +1,232 @@
+#include "block.h"
+
+#include "bitio_ext.h"
+
+#include <stdlib.h>
+#include <sys/types.h>
+
+struct BlockIndex {
+    // offset of each block from the start of the file
+    uint64_t *offsets;
+    uint64_t count;
+    uint64_t capacity;
+    // sum of the uncompressed block lengths
+    uint64_t total;
+};
+
+// function that creates an empty block index
+BlockIndex *block_index_create(void) {
+    return (BlockIndex *) calloc(1, sizeof(BlockIndex));
+}
+
+// function that frees the block index
+void block_index_free(BlockIndex **index) {
+    if (*index != NULL) {
+        free((*index)->offsets);
+        free(*index);
+        *index = NULL;
+    }
+}
+
+// function that records a block at offset holding length uncompressed bytes
+bool block_index_append(BlockIndex *index, uint64_t offset, uint32_t length) {
+    // grow the offsets array when it is full
+    if (index->count == index->capacity) {
+        uint64_t capacity = index->capacity ? 2 * index->capacity : 64;
+        uint64_t *offsets = realloc(index->offsets, capacity * sizeof(uint64_t));
+        if (offsets == NULL) {
+            return false;
+        }
+        index->offsets = offsets;
+        index->capacity = capacity;
+    }
+    index->offsets[index->count++] = offset;
+    index->total += length;
+    return true;
+}
+
+// function that empties the index, keeping its memory for the next file
+void block_index_reset(BlockIndex *index) {
+    index->count = 0;
+    index->total = 0;
+}
+
+// function that returns the number of blocks in the index
+uint64_t block_index_count(BlockIndex *index) {
+    return index->count;
+}
+
+// function that returns the file offset of block i
+uint64_t block_index_offset(BlockIndex *index, uint64_t i) {
+    return index->offsets[i];
+}
+
+// function that returns the total uncompressed size
+uint64_t block_index_total(BlockIndex *index) {
+    return index->total;
+}
+
+// function that writes a 64-bit field as two 32-bit halves
+static void block_write_uint64(BitWriter *outbuf, uint64_t x) {
+    bit_write_uint32(outbuf, (uint32_t) x);
+    bit_write_uint32(outbuf, (uint32_t) (x >> 32));
+}
+
+// function that writes the block index and the trailer that locates it
+void block_index_write(BitWriter *outbuf, BlockIndex *index) {
+    for (uint64_t i = 0; i < index->count; ++i) {
+        block_write_uint64(outbuf, index->offsets[i]);
+    }
+    block_write_uint64(outbuf, index->total);
+    block_write_uint64(outbuf, index->count);
+    bit_write_uint8(outbuf, 'H');
+    bit_write_uint8(outbuf, 'F');
+    bit_write_uint8(outbuf, 'I');
+    bit_write_uint8(outbuf, 'X');
+}
+
+// function that decodes a little-endian 64-bit field
+static uint64_t block_get_uint64(const uint8_t *p) {
+    uint64_t x = 0;
+    for (int i = 7; i >= 0; --i) {
+        x = (x << 8) | p[i];
+    }
+    return x;
+}
+
+// function that reads the block index from the end of a seekable file
+// and returns NULL if the file has none
+BlockIndex *block_index_read(FILE *f) {
+    uint8_t trailer[BLOCK_TRAILER_SIZE];
+    if (fseeko(f, -BLOCK_TRAILER_SIZE, SEEK_END) != 0
+        || fread(trailer, 1, BLOCK_TRAILER_SIZE, f) != BLOCK_TRAILER_SIZE) {
+        return NULL;
+    }
+    if (trailer[16] != 'H' || trailer[17] != 'F' || trailer[18] != 'I' || trailer[19] != 'X') {
+        return NULL;
+    }
+    off_t end = ftello(f);
+    uint64_t total = block_get_uint64(trailer);
+    uint64_t count = block_get_uint64(trailer + 8);
+    // the offsets must fit in the file in front of the trailer
+    if (count > (uint64_t) (end - BLOCK_TRAILER_SIZE) / 8) {
+        return NULL;
+    }
+    BlockIndex *index = block_index_create();
+    if (index == NULL) {
+        return NULL;
+    }
+    index->offsets = (uint64_t *) calloc(count ? count : 1, sizeof(uint64_t));
+    if (index->offsets == NULL
+        || fseeko(f, (off_t) (end - BLOCK_TRAILER_SIZE - (off_t) (8 * count)), SEEK_SET) != 0) {
+        block_index_free(&index);
+        return NULL;
+    }
+    for (uint64_t i = 0; i < count; ++i) {
+        uint8_t field[8];
+        if (fread(field, 1, 8, f) != 8) {
+            block_index_free(&index);
+            return NULL;
+        }
+        index->offsets[i] = block_get_uint64(field);
+    }
+    index->count = count;
+    index->capacity = count;
+    index->total = total;
+    return index;
+}
+
+// function that returns whether version is one of the block container's versions
+bool block_version_known(uint8_t version) {
+    return version >= BLOCK_VERSION_SINGLE && version <= BLOCK_VERSION;
+}
+
+// function that writes the file header of the block container
+void block_write_file_header(BitWriter *outbuf, uint32_t block_size) {
+    // writing 'H' and 'F' as magic number followed by the format version
+    bit_write_uint8(outbuf, 'H');
+    bit_write_uint8(outbuf, 'F');
+    bit_write_uint8(outbuf, BLOCK_VERSION);
+    bit_write_uint32(outbuf, block_size);
+}
+
+// function that writes the header in front of a block
+void block_write_header(BitWriter *outbuf, uint32_t length, uint32_t compressed_length) {
+    bit_write_uint32(outbuf, length);
+    bit_write_uint32(outbuf, compressed_length);
+}
+
+// function that writes the marker that follows the last block
+void block_write_end(BitWriter *outbuf) {
+    bit_write_uint32(outbuf, 0);
+}
+
+// function that writes the bytes that name a preset table in place of a
+// block's code lengths
+void block_write_preset(BitWriter *outbuf, uint8_t id) {
+    bit_write_uint8(outbuf, 0xf0);
+    bit_write_uint8(outbuf, 0xff);
+    bit_write_uint8(outbuf, id);
+}
+
+// function that returns the ID of the preset table the n bytes of a block
+// (after its header) name, or -1 when the block has its own code lengths
+int block_read_preset(const uint8_t *in, size_t n) {
+    return n >= BLOCK_PRESET_SIZE && in[0] == 0xf0 && in[1] == 0xff ? in[2] : -1;
+}
+
+// function that writes a block's bytes as they are, after the marker that
+// stands in for its code lengths
+void block_write_stored(BitWriter *outbuf, const uint8_t *data, uint32_t length) {
+    bit_write_uint8(outbuf, 0xf0);
+    bit_write_uint8(outbuf, 0xfe);
+    bit_write_bytes(outbuf, data, length);
+}
+
+// function that writes a block whose every byte is value
+void block_write_run(BitWriter *outbuf, uint8_t value) {
+    bit_write_uint8(outbuf, 0xf0);
+    bit_write_uint8(outbuf, 0xfd);
+    bit_write_uint8(outbuf, value);
+}
+
+// function that returns what the n bytes of a block (after its header) hold
+BlockKind block_read_kind(const uint8_t *in, size_t n) {
+    if (n < 2 || in[0] != 0xf0) {
+        return BLOCK_CODED;
+    }
+    switch (in[1]) {
+    case 0xff: return n >= BLOCK_PRESET_SIZE ? BLOCK_PRESET : BLOCK_CODED;
+    case 0xfe: return BLOCK_STORED;
+    case 0xfd: return n >= BLOCK_RUN_SIZE ? BLOCK_RUN : BLOCK_CODED;
+    default: return BLOCK_CODED;
+    }
+}
+
+// function that returns how many of the length bytes of a block go to
+// sub-stream s when the block is split into num_streams slices
+uint32_t block_stream_length(uint32_t length, uint8_t num_streams, uint8_t s) {
+    uint32_t slice = (uint32_t) (((uint64_t) length + num_streams - 1) / num_streams);
+    uint64_t start = (uint64_t) slice * s;
+    if (start >= length) {
+        return 0;
+    }
+    return length - start < slice ? (uint32_t) (length - start) : slice;
+}
+
+// function that returns the most bytes huff writes for a block of length
+// input bytes, header included: a block is only coded when that is smaller
+// than storing it
+size_t block_bound(uint32_t length) {
+    return BLOCK_HEADER_SIZE + BLOCK_STORED_SIZE + (size_t) length;
+}
+
+// function that returns the most bytes a block of length input bytes takes
+// in any file, header included, which is more than block_bound() for files
+// written before blocks could be stored.  The code lengths take at most 192
+// bytes, the codes at most 8 bits per byte and 2 more, and each sub-stream is
+// padded to a whole byte.
+size_t block_read_bound(uint32_t length) {
+    return BLOCK_HEADER_SIZE + 192 + 1 + 4 * (BLOCK_MAX_STREAMS - 1) + (size_t) length + 2
+           + BLOCK_MAX_STREAMS;
+}
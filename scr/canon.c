@@ -0,0 +1,216 @@
+#include "canon.h"
+
+#include "bitio_ext.h"
+
+#include <stdlib.h>
+
+// a 4-bit run field holds the run length - 1 for runs of up to 15 absent
+// symbols; the value 15 is followed by 8 more bits holding the run length - 16
+#define CANON_SHORT_RUN 15
+#define CANON_LONG_RUN  (16 + 255)
+
+// function that reverses the low n bits of code
+static uint64_t canon_reverse(uint64_t code, uint8_t n) {
+    uint64_t reversed = 0;
+    for (uint8_t i = 0; i < n; ++i) {
+        reversed = (reversed << 1) | (code & 1);
+        code >>= 1;
+    }
+    return reversed;
+}
+
+// function that assigns canonical codes from the code lengths
+// (a code length of 0 means the symbol does not occur)
+void canon_assign(const uint8_t *code_lengths, uint64_t *codes) {
+    // count how many codes there are of each length
+    uint16_t length_count[64] = { 0 };
+    for (uint16_t s = 0; s < 256; ++s) {
+        length_count[code_lengths[s]]++;
+    }
+    length_count[0] = 0;
+    // the first code of each length follows the last code of the shorter lengths
+    uint64_t next_code[64] = { 0 };
+    uint64_t code = 0;
+    for (uint8_t length = 1; length < 64; ++length) {
+        code = (code + length_count[length - 1]) << 1;
+        next_code[length] = code;
+    }
+    // within a length, codes are handed out in symbol order
+    for (uint16_t s = 0; s < 256; ++s) {
+        uint8_t length = code_lengths[s];
+        if (length == 0) {
+            codes[s] = 0;
+            continue;
+        }
+        // canonical codes are defined first bit first; the stream wants first bit lowest
+        codes[s] = canon_reverse(next_code[length]++, length);
+    }
+}
+
+// function that writes the code lengths as 4-bit fields, where a 0 field starts
+// a run of absent symbols, and returns the number of bits; when outbuf is NULL
+// the bits are only counted
+uint32_t canon_write_lengths(BitWriter *outbuf, const uint8_t *code_lengths) {
+    uint32_t bits = 0;
+    uint16_t s = 0;
+    while (s < 256) {
+        if (code_lengths[s] != 0) {
+            // writing the length of a symbol that occurs
+            if (outbuf != NULL) {
+                bit_write_bits(outbuf, code_lengths[s], 4);
+            }
+            bits += 4;
+            ++s;
+        } else {
+            // writing a run of absent symbols
+            uint16_t run = 1;
+            while (s + run < 256 && run < CANON_LONG_RUN && code_lengths[s + run] == 0) {
+                ++run;
+            }
+            if (outbuf != NULL) {
+                bit_write_bits(outbuf, 0, 4);
+                if (run <= CANON_SHORT_RUN) {
+                    bit_write_bits(outbuf, run - 1u, 4);
+                } else {
+                    bit_write_bits(outbuf, CANON_SHORT_RUN, 4);
+                    bit_write_bits(outbuf, run - 16u, 8);
+                }
+            }
+            bits += run <= CANON_SHORT_RUN ? 8 : 16;
+            s = (uint16_t) (s + run);
+        }
+    }
+    return bits;
+}
+
+// function that reads the code lengths written by canon_write_lengths()
+// and returns false if they do not describe a valid prefix code
+bool canon_read_lengths(BitReader *inbuf, uint8_t *code_lengths) {
+    uint16_t s = 0;
+    while (s < 256) {
+        uint8_t length = (uint8_t) bit_read_bits(inbuf, 4);
+        if (length != 0) {
+            code_lengths[s++] = length;
+            continue;
+        }
+        // reading a run of absent symbols
+        uint16_t run = (uint16_t) (bit_read_bits(inbuf, 4) + 1);
+        if (run > CANON_SHORT_RUN) {
+            run = (uint16_t) (bit_read_bits(inbuf, 8) + 16);
+        }
+        if (s + run > 256) {
+            // a run past the last symbol
+            return false;
+        }
+        for (uint16_t i = 0; i < run; ++i) {
+            code_lengths[s++] = 0;
+        }
+    }
+    // the lengths must not claim more codes than there are (Kraft inequality)
+    uint32_t kraft = 0;
+    for (uint16_t i = 0; i < 256; ++i) {
+        if (code_lengths[i] != 0) {
+            kraft += (uint32_t) 1 << (CANON_MAX_LENGTH - code_lengths[i]);
+        }
+    }
+    return kraft <= (uint32_t) 1 << CANON_MAX_LENGTH;
+}
+
+// an item of a package-merge list: a leaf (symbol >= 0) or a package of two
+// items of the list below it (symbol < 0)
+typedef struct PackageItem {
+    uint64_t weight;
+    int16_t symbol;
+} PackageItem;
+
+// function that computes optimal code lengths of at most max_length bits with
+// the package-merge algorithm and returns false if max_length is too small
+bool canon_limit_lengths(const uint32_t *histogram, uint8_t max_length, uint8_t *code_lengths) {
+    return canon_limit_lengths_arena(NULL, histogram, max_length, code_lengths);
+}
+
+// function that does the same with its scratch lists in an arena (the heap
+// when arena is NULL); they are released with the arena
+bool canon_limit_lengths_arena(
+    Arena *arena, const uint32_t *histogram, uint8_t max_length, uint8_t *code_lengths) {
+    // sorting the symbols that occur by weight, then by symbol like pq_less_than()
+    uint16_t order[256];
+    uint16_t n = 0;
+    for (uint16_t s = 0; s < 256; ++s) {
+        code_lengths[s] = 0;
+        if (histogram[s] == 0) {
+            continue;
+        }
+        uint16_t i = n++;
+        while (i > 0 && histogram[order[i - 1]] > histogram[s]) {
+            order[i] = order[i - 1];
+            --i;
+        }
+        order[i] = s;
+    }
+    if (n <= 1) {
+        // a single symbol still needs one bit per occurrence
+        if (n == 1) {
+            code_lengths[order[0]] = 1;
+        }
+        return true;
+    }
+    if (max_length == 0 || max_length > CANON_MAX_LENGTH || n > (1u << max_length)) {
+        return false;
+    }
+    // list[level] holds the leaves merged with the packages of list[level - 1]
+    size_t items = (size_t) max_length * 2 * n;
+    PackageItem *lists = arena != NULL
+                             ? (PackageItem *) arena_alloc(arena, items * sizeof(PackageItem))
+                             : (PackageItem *) calloc(items, sizeof(PackageItem));
+    if (lists == NULL) {
+        return false;
+    }
+    uint16_t sizes[CANON_MAX_LENGTH];
+    for (uint16_t i = 0; i < n; ++i) {
+        lists[i].weight = histogram[order[i]];
+        lists[i].symbol = (int16_t) order[i];
+    }
+    sizes[0] = n;
+    for (uint8_t level = 1; level < max_length; ++level) {
+        PackageItem *below = lists + (size_t) (level - 1) * 2 * n;
+        PackageItem *list = lists + (size_t) level * 2 * n;
+        uint16_t packages = sizes[level - 1] / 2;
+        uint16_t leaf = 0, package = 0, size = 0;
+        // merging the leaves and the packages, leaves first on equal weights
+        while (leaf < n || package < packages) {
+            uint64_t package_weight = package < packages
+                                          ? below[2 * package].weight + below[2 * package + 1].weight
+                                          : 0;
+            if (package == packages
+                || (leaf < n && histogram[order[leaf]] <= package_weight)) {
+                list[size].weight = histogram[order[leaf]];
+                list[size++].symbol = (int16_t) order[leaf++];
+            } else {
+                list[size].weight = package_weight;
+                list[size++].symbol = -1;
+                ++package;
+            }
+        }
+        sizes[level] = size;
+    }
+    // the cheapest 2n - 2 items of the last list make up the code; every time a
+    // symbol appears in them or in the packages they contain, its code grows by a bit
+    uint16_t selected = (uint16_t) (2 * n - 2);
+    for (int level = max_length - 1; level >= 0; --level) {
+        PackageItem *list = lists + (size_t) level * 2 * n;
+        uint16_t packages = 0;
+        for (uint16_t i = 0; i < selected; ++i) {
+            if (list[i].symbol >= 0) {
+                code_lengths[list[i].symbol]++;
+            } else {
+                ++packages;
+            }
+        }
+        selected = (uint16_t) (2 * packages);
+    }
+    if (arena == NULL) {
+        free(lists);
+    }
+    return true;
+}
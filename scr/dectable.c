@@ -0,0 +1,503 @@
+#include "dectable.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// widest table below the primary one; deeper codes chain into further tables
+#define DT_SUB_BITS 8
+
+// an entry either holds a decoded symbol or links to a deeper table
+//   leaf: bits 0-7 symbol, bits 8-15 number of bits the code uses at this level
+//   link: bit 31 set, bits 0-23 offset of the deeper table, bits 24-30 its width
+#define DT_LINK          0x80000000u
+#define DT_LEAF(sym, n)  ((uint32_t) (sym) | (uint32_t) (n) << 8)
+#define DT_LEAF_SYMBOL(e) ((uint8_t) ((e) & 0xff))
+#define DT_LEAF_LENGTH(e) ((uint8_t) (((e) >> 8) & 0xff))
+#define DT_LINK_OFFSET(e) ((e) & 0x00ffffffu)
+#define DT_LINK_WIDTH(e)  ((uint8_t) (((e) >> 24) & 0x7f))
+
+// the multi-symbol table pays off when codes average at most this many bits,
+// which means a DT_MULTI_BITS window holds about 1.5 symbols or more on average
+#define DT_MULTI_MAX_AVERAGE 8.0
+
+// an entry of the multi-symbol table: up to 4 symbols that fit completely in
+// DT_MULTI_BITS bits, how many there are and how many bits they use together;
+// count is 0 when the first code is too long and the single-symbol path decodes it
+typedef struct MultiEntry {
+    uint8_t symbols[DT_MULTI_SYMBOLS];
+    uint8_t count;
+    uint8_t bits;
+} MultiEntry;
+
+struct DecodeTable {
+    // all tables live in one array, the primary table comes first
+    uint32_t *entries;
+    uint32_t num_entries;
+    uint32_t capacity;
+    // width of the primary table
+    uint8_t primary_bits;
+    // multi-symbol table indexed by DT_MULTI_BITS bits, NULL when not in use
+    MultiEntry *multi;
+    // the expected code length, assuming each code of length n has probability 2^-n
+    double average_length;
+    // where the table and its arrays live, NULL for the heap
+    Arena *arena;
+};
+
+// function that returns a mask with the low n bits set
+static uint64_t dt_mask(uint8_t n) {
+    return n >= 64 ? ~(uint64_t) 0 : ((uint64_t) 1 << n) - 1;
+}
+
+// function that reserves a zeroed table of 2^width entries and returns its offset
+static int64_t dt_alloc(DecodeTable *dt, uint8_t width) {
+    uint32_t size = (uint32_t) 1 << width;
+    // grow the entry array when the new table does not fit
+    if (dt->num_entries + size > dt->capacity) {
+        uint32_t capacity = dt->capacity ? dt->capacity : 1;
+        while (capacity < dt->num_entries + size) {
+            capacity *= 2;
+        }
+        if (capacity > DT_LINK_OFFSET(~0u) + 1) {
+            return -1;
+        }
+        uint32_t *entries;
+        if (dt->arena != NULL) {
+            // arena memory is not resized, the old array is left behind until the reset
+            entries = (uint32_t *) arena_alloc(dt->arena, capacity * sizeof(uint32_t));
+            if (entries != NULL && dt->num_entries > 0) {
+                memcpy(entries, dt->entries, dt->num_entries * sizeof(uint32_t));
+            }
+        } else {
+            entries = realloc(dt->entries, capacity * sizeof(uint32_t));
+        }
+        if (entries == NULL) {
+            return -1;
+        }
+        dt->entries = entries;
+        dt->capacity = capacity;
+    }
+    uint32_t offset = dt->num_entries;
+    for (uint32_t i = 0; i < size; ++i) {
+        dt->entries[offset + i] = 0;
+    }
+    dt->num_entries += size;
+    return offset;
+}
+
+// function that fills the table for every code that starts with prefix
+// (prefix_length bits) and returns the table's offset, or -1 on failure
+static int64_t dt_build(DecodeTable *dt, const uint64_t *codes, const uint8_t *code_lengths,
+    uint64_t prefix, uint8_t prefix_length, uint8_t width) {
+    int64_t offset = dt_alloc(dt, width);
+    if (offset < 0) {
+        return -1;
+    }
+    // the longest remaining code below each entry that must link further
+    uint8_t deeper[1 << DT_PRIMARY_BITS] = { 0 };
+    for (uint16_t s = 0; s < 256; ++s) {
+        uint8_t length = code_lengths[s];
+        // skip symbols that are absent or do not start with prefix
+        if (length <= prefix_length || (codes[s] & dt_mask(prefix_length)) != prefix) {
+            continue;
+        }
+        uint8_t remaining = (uint8_t) (length - prefix_length);
+        uint64_t rest = codes[s] >> prefix_length;
+        if (remaining <= width) {
+            // the code ends in this table: fill every entry whose low bits match
+            for (uint64_t i = rest & dt_mask(remaining); i < ((uint64_t) 1 << width);
+                 i += (uint64_t) 1 << remaining) {
+                dt->entries[offset + (int64_t) i] = DT_LEAF(s, remaining);
+            }
+        } else {
+            // the code continues in a deeper table
+            uint64_t i = rest & dt_mask(width);
+            uint8_t below = (uint8_t) (remaining - width);
+            if (below > deeper[i]) {
+                deeper[i] = below;
+            }
+        }
+    }
+    // build the deeper tables and link them in
+    for (uint32_t i = 0; i < ((uint32_t) 1 << width); ++i) {
+        if (deeper[i] == 0) {
+            continue;
+        }
+        uint8_t sub_width = deeper[i] < DT_SUB_BITS ? deeper[i] : DT_SUB_BITS;
+        int64_t sub = dt_build(dt, codes, code_lengths, prefix | (uint64_t) i << prefix_length,
+            (uint8_t) (prefix_length + width), sub_width);
+        if (sub < 0) {
+            return -1;
+        }
+        dt->entries[offset + i] = DT_LINK | (uint32_t) sub | (uint32_t) sub_width << 24;
+    }
+    return offset;
+}
+
+// function that allocates an empty decode table in the arena, or on the heap
+// when arena is NULL
+static DecodeTable *dt_new(Arena *arena) {
+    if (arena == NULL) {
+        return (DecodeTable *) calloc(1, sizeof(DecodeTable));
+    }
+    DecodeTable *dt = (DecodeTable *) arena_alloc(arena, sizeof(DecodeTable));
+    if (dt != NULL) {
+        memset(dt, 0, sizeof(DecodeTable));
+        dt->arena = arena;
+    }
+    return dt;
+}
+
+// function that returns whether the code lengths fill the code space exactly
+// (their Kraft sum is 1), so every entry of the tables decodes a symbol of at
+// least one bit; a single symbol with a 1-bit code is allowed as well
+static bool dt_lengths_complete(const uint8_t *code_lengths) {
+    uint16_t length_count[256] = { 0 };
+    for (uint16_t s = 0; s < 256; ++s) {
+        length_count[code_lengths[s]]++;
+    }
+    if (length_count[0] == 255 && length_count[1] == 1) {
+        return true;
+    }
+    // the codes of each length that no shorter code has taken, starting from the empty code
+    int64_t free_codes = 1;
+    for (uint16_t length = 1; length < 256; ++length) {
+        free_codes = 2 * free_codes - length_count[length];
+        // too many codes, or more room left than the other symbols can fill
+        if (free_codes < 0 || free_codes > 256) {
+            return false;
+        }
+    }
+    return free_codes == 0;
+}
+
+// function that creates a decode table from per-symbol codes and code lengths
+// (a code length of 0 means the symbol does not occur)
+DecodeTable *dt_create_from_codes(const uint64_t *codes, const uint8_t *code_lengths) {
+    return dt_create_from_codes_arena(NULL, codes, code_lengths);
+}
+
+// function that creates the same decode table with all of its memory taken
+// from the arena, so building one per block does not touch the heap once the
+// arena has grown; dt_free() then only forgets the table.  Lengths that leave
+// part of the code space unused (or overfill it) give NULL, since an entry
+// that decodes no code would never consume a bit.
+DecodeTable *dt_create_from_codes_arena(
+    Arena *arena, const uint64_t *codes, const uint8_t *code_lengths) {
+    if (!dt_lengths_complete(code_lengths)) {
+        return NULL;
+    }
+    DecodeTable *dt = dt_new(arena);
+    if (dt == NULL) {
+        return NULL;
+    }
+    // the primary table is no wider than the longest code
+    uint8_t max_length = 0;
+    for (uint16_t s = 0; s < 256; ++s) {
+        if (code_lengths[s] > max_length) {
+            max_length = code_lengths[s];
+        }
+    }
+    dt->primary_bits = max_length < DT_PRIMARY_BITS ? max_length : DT_PRIMARY_BITS;
+    if (dt_build(dt, codes, code_lengths, 0, 0, dt->primary_bits) < 0) {
+        dt_free(&dt);
+        return NULL;
+    }
+    // a single symbol's 1-bit code leaves the other entry, which decodes it as well
+    if (dt->num_entries == 2 && dt->entries[0] == 0) {
+        dt->entries[0] = dt->entries[1];
+    } else if (dt->num_entries == 2 && dt->entries[1] == 0) {
+        dt->entries[1] = dt->entries[0];
+    }
+    // codes that do not match their lengths can still leave an entry without a code
+    for (uint32_t i = 0; i < dt->num_entries; ++i) {
+        if (dt->entries[i] == 0) {
+            dt_free(&dt);
+            return NULL;
+        }
+    }
+    // a Huffman code of length n stands for a probability of about 2^-n
+    dt->average_length = 0.0;
+    for (uint16_t s = 0; s < 256; ++s) {
+        if (code_lengths[s] > 0) {
+            dt->average_length += code_lengths[s] / (double) ((uint64_t) 1 << code_lengths[s]);
+        }
+    }
+    // use the multi-symbol table when several codes usually fit in one lookup
+    if (max_length > 0 && dt->average_length <= DT_MULTI_MAX_AVERAGE) {
+        dt_multi_enable(dt, true);
+    }
+    return dt;
+}
+
+// function that collects the code of every leaf below node
+static void dt_collect_codes(
+    Node *node, uint64_t code, uint8_t code_length, uint64_t *codes, uint8_t *code_lengths) {
+    if (node == NULL) {
+        return;
+    }
+    if (node->left == NULL && node->right == NULL) {
+        codes[node->symbol] = code;
+        code_lengths[node->symbol] = code_length;
+        return;
+    }
+    // left appends 0 and right appends 1, the first bit is the least significant
+    dt_collect_codes(node->left, code, (uint8_t) (code_length + 1), codes, code_lengths);
+    code |= (uint64_t) 1 << code_length;
+    dt_collect_codes(node->right, code, (uint8_t) (code_length + 1), codes, code_lengths);
+}
+
+// function that creates the decode table of a tree that is a single leaf,
+// which decodes its symbol without reading any bits
+static DecodeTable *dt_create_leaf(uint8_t symbol) {
+    DecodeTable *dt = (DecodeTable *) calloc(1, sizeof(DecodeTable));
+    if (dt == NULL || dt_alloc(dt, 0) < 0) {
+        dt_free(&dt);
+        return NULL;
+    }
+    dt->entries[0] = DT_LEAF(symbol, 0);
+    return dt;
+}
+
+// function that creates a decode table from a Huffman tree
+DecodeTable *dt_create(Node *tree) {
+    if (tree == NULL) {
+        return NULL;
+    }
+    if (tree->left == NULL && tree->right == NULL) {
+        return dt_create_leaf(tree->symbol);
+    }
+    uint64_t codes[256] = { 0 };
+    uint8_t code_lengths[256] = { 0 };
+    dt_collect_codes(tree, 0, 0, codes, code_lengths);
+    return dt_create_from_codes(codes, code_lengths);
+}
+
+// function that creates a decode table from a flat Huffman tree
+DecodeTable *dt_create_flat(const FlatTree *tree) {
+    if (tree->num_nodes == 0) {
+        return NULL;
+    }
+    if (tree->nodes[0] & TREE_LEAF) {
+        return dt_create_leaf((uint8_t) tree->nodes[0]);
+    }
+    uint64_t codes[256];
+    uint8_t code_lengths[256];
+    tree_flat_codes(tree, codes, code_lengths);
+    return dt_create_from_codes(codes, code_lengths);
+}
+
+// function that frees the decode table
+void dt_free(DecodeTable **dt) {
+    if (*dt != NULL && (*dt)->arena != NULL) {
+        // the memory goes back with the next arena_reset()
+        *dt = NULL;
+    } else if (*dt != NULL) {
+        free((*dt)->multi);
+        free((*dt)->entries);
+        free(*dt);
+        *dt = NULL;
+    }
+}
+
+// function that builds (enable) or drops the multi-symbol table and
+// returns whether it is in use afterwards
+bool dt_multi_enable(DecodeTable *dt, bool enable) {
+    if (!enable || dt->primary_bits == 0) {
+        // codes of length 0 would never advance, so they always decode one at a time
+        if (dt->arena == NULL) {
+            free(dt->multi);
+        }
+        dt->multi = NULL;
+        return false;
+    }
+    if (dt->multi != NULL) {
+        return true;
+    }
+    size_t multi_size = ((size_t) 1 << DT_MULTI_BITS) * sizeof(MultiEntry);
+    MultiEntry *multi = dt->arena != NULL ? (MultiEntry *) arena_alloc(dt->arena, multi_size)
+                                          : (MultiEntry *) malloc(multi_size);
+    if (multi == NULL) {
+        return false;
+    }
+    memset(multi, 0, multi_size);
+    for (uint32_t x = 0; x < ((uint32_t) 1 << DT_MULTI_BITS); ++x) {
+        MultiEntry *m = &multi[x];
+        // decode codes from the primary table while they fit in the window
+        while (m->count < DT_MULTI_SYMBOLS) {
+            uint8_t remaining = (uint8_t) (DT_MULTI_BITS - m->bits);
+            uint32_t e = dt->entries[(x >> m->bits) & dt_mask(dt->primary_bits)];
+            // bits above the window read as 0, so only codes inside it are valid
+            if ((e & DT_LINK) || DT_LEAF_LENGTH(e) > remaining || DT_LEAF_LENGTH(e) == 0) {
+                break;
+            }
+            m->symbols[m->count++] = DT_LEAF_SYMBOL(e);
+            m->bits = (uint8_t) (m->bits + DT_LEAF_LENGTH(e));
+        }
+    }
+    dt->multi = multi;
+    return true;
+}
+
+// function that decodes a single symbol with the primary and deeper tables
+static uint8_t dt_decode_symbol(const DecodeTable *dt, BitReader *inbuf) {
+    // one lookup decodes every code that fits in the primary table
+    uint8_t width = dt->primary_bits;
+    uint32_t e = dt->entries[bit_peek(inbuf, width)];
+    // longer codes follow links into deeper tables
+    while (e & DT_LINK) {
+        bit_consume(inbuf, width);
+        width = DT_LINK_WIDTH(e);
+        e = dt->entries[DT_LINK_OFFSET(e) + bit_peek(inbuf, width)];
+    }
+    bit_consume(inbuf, DT_LEAF_LENGTH(e));
+    return DT_LEAF_SYMBOL(e);
+}
+
+// function that decodes n symbols from inbuf into out
+void dt_decode(DecodeTable *dt, BitReader *inbuf, uint8_t *out, size_t n) {
+    size_t i = 0;
+    const MultiEntry *multi = dt->multi;
+    if (multi != NULL) {
+        // each lookup stores DT_MULTI_SYMBOLS bytes but only count of them are kept
+        while (i + DT_MULTI_SYMBOLS <= n) {
+            const MultiEntry *m = &multi[bit_peek(inbuf, DT_MULTI_BITS)];
+            if (m->count == 0) {
+                out[i++] = dt_decode_symbol(dt, inbuf);
+                continue;
+            }
+            bit_consume(inbuf, m->bits);
+            memcpy(out + i, m->symbols, DT_MULTI_SYMBOLS);
+            i += m->count;
+        }
+    }
+    for (; i < n; ++i) {
+        out[i] = dt_decode_symbol(dt, inbuf);
+    }
+}
+
+// one sub-stream of dt_decode_streams(): its own bit buffer over memory
+typedef struct DtStream {
+    const uint8_t *next;
+    const uint8_t *end;
+    uint64_t bits;
+    uint8_t count;
+} DtStream;
+
+// function that tops the stream's bit buffer up to at least BR_PEEK_MAX bits;
+// past the end of the stream every bit reads as 0
+static inline void dt_stream_refill(DtStream *st) {
+    // a full buffer has no room for a byte, and a word shifted by 64 is undefined
+    if (st->count > 56) {
+        return;
+    }
+    if (st->end - st->next >= 8) {
+        uint64_t word;
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+        memcpy(&word, st->next, sizeof(word));
+#else
+        word = 0;
+        for (int i = 0; i < 8; i++) {
+            word |= (uint64_t) st->next[i] << (8 * i);
+        }
+#endif
+        st->bits |= word << st->count;
+        uint8_t nbytes = (uint8_t) ((64 - st->count) >> 3);
+        st->next += nbytes;
+        st->count = (uint8_t) (st->count + 8 * nbytes);
+        return;
+    }
+    while (st->count <= 56) {
+        uint64_t byte = st->next < st->end ? *st->next++ : 0;
+        st->bits |= byte << st->count;
+        st->count = (uint8_t) (st->count + 8);
+    }
+}
+
+// function that decodes one lookup's worth of symbols from a refilled stream
+// into out and returns how many it stored; with the multi-symbol table it
+// may write up to DT_MULTI_SYMBOLS bytes
+static inline size_t dt_stream_decode(const DecodeTable *dt, DtStream *st, uint8_t *out) {
+    if (dt->multi != NULL) {
+        const MultiEntry *m = &dt->multi[st->bits & dt_mask(DT_MULTI_BITS)];
+        if (m->count != 0) {
+            memcpy(out, m->symbols, DT_MULTI_SYMBOLS);
+            st->bits >>= m->bits;
+            st->count = (uint8_t) (st->count - m->bits);
+            return m->count;
+        }
+    }
+    uint8_t width = dt->primary_bits;
+    uint32_t e = dt->entries[st->bits & dt_mask(width)];
+    while (e & DT_LINK) {
+        st->bits >>= width;
+        st->count = (uint8_t) (st->count - width);
+        width = DT_LINK_WIDTH(e);
+        e = dt->entries[DT_LINK_OFFSET(e) + (st->bits & dt_mask(width))];
+    }
+    st->bits >>= DT_LEAF_LENGTH(e);
+    st->count = (uint8_t) (st->count - DT_LEAF_LENGTH(e));
+    out[0] = DT_LEAF_SYMBOL(e);
+    return 1;
+}
+
+// function that decodes num_streams independent sub-streams that share one
+// table; sub-stream s is src_lengths[s] bytes at src[s] and decodes to
+// out_lengths[s] bytes at out[s].  The codes must be at most 15 bits long,
+// so after a refill every stream has room for DT_STREAM_LOOKUPS lookups.
+void dt_decode_streams(DecodeTable *dt, unsigned num_streams, const uint8_t *const *src,
+    const size_t *src_lengths, uint8_t *const *out, const size_t *out_lengths) {
+    DtStream st[DT_MAX_STREAMS];
+    uint8_t *pos[DT_MAX_STREAMS];
+    uint8_t *end[DT_MAX_STREAMS];
+    for (unsigned s = 0; s < num_streams; ++s) {
+        st[s].next = src[s];
+        st[s].end = src[s] + src_lengths[s];
+        st[s].bits = 0;
+        st[s].count = 0;
+        pos[s] = out[s];
+        end[s] = out[s] + out_lengths[s];
+    }
+    // a round decodes DT_STREAM_LOOKUPS lookups from every stream; the lookups
+    // of different streams do not depend on each other and overlap in the CPU
+    const size_t room = DT_STREAM_LOOKUPS * DT_MULTI_SYMBOLS;
+    if (num_streams == DT_MAX_STREAMS) {
+        while ((size_t) (end[0] - pos[0]) >= room && (size_t) (end[1] - pos[1]) >= room
+               && (size_t) (end[2] - pos[2]) >= room && (size_t) (end[3] - pos[3]) >= room) {
+            dt_stream_refill(&st[0]);
+            dt_stream_refill(&st[1]);
+            dt_stream_refill(&st[2]);
+            dt_stream_refill(&st[3]);
+            for (int k = 0; k < DT_STREAM_LOOKUPS; ++k) {
+                pos[0] += dt_stream_decode(dt, &st[0], pos[0]);
+                pos[1] += dt_stream_decode(dt, &st[1], pos[1]);
+                pos[2] += dt_stream_decode(dt, &st[2], pos[2]);
+                pos[3] += dt_stream_decode(dt, &st[3], pos[3]);
+            }
+        }
+    }
+    // the rest of every stream, one stream at a time
+    for (unsigned s = 0; s < num_streams; ++s) {
+        while ((size_t) (end[s] - pos[s]) >= room) {
+            dt_stream_refill(&st[s]);
+            for (int k = 0; k < DT_STREAM_LOOKUPS; ++k) {
+                pos[s] += dt_stream_decode(dt, &st[s], pos[s]);
+            }
+        }
+        while (pos[s] < end[s]) {
+            dt_stream_refill(&st[s]);
+            if ((size_t) (end[s] - pos[s]) >= DT_MULTI_SYMBOLS) {
+                pos[s] += dt_stream_decode(dt, &st[s], pos[s]);
+            } else {
+                // too close to the end for a multi-symbol store
+                uint8_t symbols[DT_MULTI_SYMBOLS];
+                size_t n = dt_stream_decode(dt, &st[s], symbols);
+                if (n > (size_t) (end[s] - pos[s])) {
+                    n = (size_t) (end[s] - pos[s]);
+                }
+                memcpy(pos[s], symbols, n);
+                pos[s] += n;
+            }
+        }
+    }
+}
@@ -1,117 +1,64 @@
 #include "bitreader.h"
-#include "node.h"
-#include "pq.h"
+#include "libhuff.h"
+#include "metrics.h"
+#include "pool.h"
+#include "timer.h"
+#include "trace.h"
 
 #include <getopt.h>
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
-#define STACK_SIZE 64
+#include <string.h>
 
-// function that pushes nodes to the stack
-void stack_push(Node **stack, int *top, Node *node) {
-    // check if stack has space left
-    if (*top < STACK_SIZE - 1) {
-        // push node to stack
-        stack[++(*top)] = node;
-    } else {
-        // stack overflow error - couldn't push to stack
-        fprintf(stderr, "couldn't push to stack\n");
-    }
+// function that prints the usage message
+void print_help(void) {
+    fprintf(stdout, "Usage: dehuff -i infile -o outfile\n"
+                    "       dehuff -v -i infile -o outfile\n"
+                    "       dehuff -j threads -i infile -o outfile\n"
+                    "       dehuff -t table [-t table ...] -i infile -o outfile\n"
+                    "       dehuff --metrics=path -i infile -o outfile\n"
+                    "       dehuff --trace=file.json -i infile -o outfile\n"
+                    "       dehuff -h\n"
+                    "An infile or outfile of - is the standard input or output.  A table\n"
+                    "is a file from hufftrain that the input was coded with; the built-in\n"
+                    "tables are always known.\n");
 }
 
-// function that pops nodes from the stack
-Node *stack_pop(Node **stack, int *top) {
-    // check if stack is greater ot equal to 0
-    if (*top >= 0) {
-        // pop node from stack
-        return stack[(*top)--];
-    } else {
-        // stack underflow error - couldn't pop from stack
-        fprintf(stderr, "couldn't pop from stack\n");
-        return NULL;
+// function that prints the wall and CPU time of reading, the decoding
+// stages and writing, as milliseconds and shares of the wall time
+void print_stages(const HuffStats *stats, uint64_t wall_ns) {
+    HuffStage stages[] = { HUFF_STAGE_READ, HUFF_STAGE_PARSE, HUFF_STAGE_TABLE, HUFF_STAGE_DECODE,
+        HUFF_STAGE_WRITE };
+    fprintf(stderr, "  %-10s %10s %10s %7s\n", "stage", "wall ms", "cpu ms", "wall %");
+    for (size_t i = 0; i < sizeof(stages) / sizeof(stages[0]); ++i) {
+        HuffStage s = stages[i];
+        fprintf(stderr, "  %-10s %10.3f %10.3f %6.1f%%\n", huff_stage_name(s),
+            (double) stats->wall_ns[s] / 1e6, (double) stats->cpu_ns[s] / 1e6,
+            wall_ns ? 100.0 * (double) stats->wall_ns[s] / (double) wall_ns : 0.0);
     }
 }
 
-// function to perform Huffman decoding and write the decompressed data to the output file
-void dehuff_decompress_file(FILE *fout, BitReader *inbuf) {
-    // using the bit read functions to read header information
-    uint8_t type1 = bit_read_uint8(inbuf);
-    uint8_t type2 = bit_read_uint8(inbuf);
-    // read file size
-    uint32_t filesize = bit_read_uint32(inbuf);
-    // read the number of symbols in the file
-    uint16_t num_leaves = bit_read_uint16(inbuf);
-    // using the assert functions to check is the header information correct
-    assert(type1 == 'H');
-    assert(type2 == 'C');
-    // calculate the number of nodes in the Huffman tree
-    uint16_t num_nodes = 2 * num_leaves - 1;
-    // initialize a stack for building the Huffman tree
-    Node *stack[64];
-    // initialize top of the stack
-    int top = -1;
-    // iterating over the number of nodes to build the tree for huffman
-    for (uint16_t i = 0; i < num_nodes; ++i) {
-        // read one bit to determine node type
-        int bit = bit_read_bit(inbuf);
-        // create a new node based on the bit value
-        Node *node;
-        // if bit is 1
-        if (bit == 1) {
-            // creating the leaf of the node using symbol
-            uint8_t symbol = bit_read_uint8(inbuf);
-            node = node_create(symbol, 0);
-        } else {
-            // creating an internal node
-            node = node_create(0, 0);
-            // popping the right side
-            node->right = stack_pop(stack, &top);
-            // popping the left side
-            node->left = stack_pop(stack, &top);
-        }
-        // push the new node onto the stack
-        stack_push(stack, &top, node);
-    }
-    // the top of the stack now contains the root of the Huffman tree
-    if (top < 0) {
-        fprintf(stderr, "Error: Empty stack\n");
-        return;
+// function that prints what the decompression did: the shape of the codes,
+// the time of every stage, the throughput and whether the run waited on I/O
+// (the CPU time falls well short of the wall time) or not
+void print_stats(const HuffStats *stats, uint64_t wall_ns, uint64_t cpu_ns) {
+    double ratio = wall_ns ? (double) cpu_ns / (double) wall_ns : 0.0;
+    fprintf(stderr, "dehuff: %" PRIu64 " -> %" PRIu64 " bytes in %" PRIu64 " blocks\n",
+        stats->input_bytes, stats->output_bytes, stats->blocks);
+    if (stats->output_bytes != 0) {
+        fprintf(stderr, "  input %.4f bits/symbol\n",
+            8.0 * (double) stats->input_bytes / (double) stats->output_bytes);
     }
-    // the top of the stack now contains the root of the huffman tree
-    Node *code_tree = stack_pop(stack, &top);
-    // iterating over the file size to decode the compressed data
-    for (uint32_t i = 0; i < filesize; ++i) {
-        Node *node = code_tree;
-        // traverse the Huffman tree until a leaf node is reached
-        while (1) {
-            int bit = bit_read_bit(inbuf);
-            // move to the left or right child based on the bit value
-            // if bit is 0
-            if (bit == 0) {
-                // move node to the left
-                node = node->left;
-                // if not
-            } else {
-                // move node to the right
-                node = node->right;
-            }
-            // if it's a leaf node, break from the loop
-            if (node->left == NULL || node->right == NULL) {
-                break;
-            }
-        }
-        // write the symbol of the leaf node to the output file
-        fputc(node->symbol, fout);
+    if (stats->max_leaves != 0) {
+        fprintf(stderr, "  up to %u leaves, longest code %u bits\n", stats->max_leaves,
+            stats->max_code_length);
     }
-    // freeing the memory used for creating the node
-    node_free(&code_tree);
-}
-
-// function that prints the usage message
-void print_help(void) {
-    fprintf(stdout, "Usage: huff -i infile -o outfile\n"
-                    "       huff -v -i infile -o outfile\n"
-                    "       huff -h\n");
+    print_stages(stats, wall_ns);
+    fprintf(stderr, "  total      %10.3f %10.3f ms, %.1f MB/s, cpu/wall %.2f (%s)\n",
+        (double) wall_ns / 1e6, (double) cpu_ns / 1e6,
+        wall_ns ? (double) stats->output_bytes * 1e3 / (double) wall_ns : 0.0, ratio,
+        ratio < 0.9 ? "I/O-bound" : "CPU-bound");
 }
 
 // the main function
@@ -122,6 +69,25 @@ int main(int argc, char **argv) {
     FILE *fout = NULL;
     // definig a variable to take the input file
     const char *finame;
+    // the number of threads that decode blocks (0 means one per online core)
+    unsigned long threads = 1;
+    // whether to print the time of every stage
+    bool verbose = false;
+    // the tables read from files, by id
+    HuffTable *tables[256] = { NULL };
+    HuffTable *table;
+    // where to write the JSON metrics record, NULL for nowhere
+    const char *metrics_path = NULL;
+    // where to write the Chrome trace of the stages, NULL for nowhere
+    const char *trace_path = NULL;
+    // the options that only have a long form
+    static const struct option long_options[] = {
+        { "metrics", required_argument, NULL, 'm' },
+        { "trace", required_argument, NULL, 'T' },
+        { NULL, 0, NULL, 0 },
+    };
+    // the end of a number given on the command line
+    char *end;
     // checking the input and output files are provided
     while (argc < 5) {
         if (argc < 3) {
@@ -135,17 +101,39 @@ int main(int argc, char **argv) {
         }
     }
     // while the user provides an option
-    while ((option = getopt(argc, argv, "hi:o:")) != -1) {
+    while ((option = getopt_long(argc, argv, "hi:o:j:t:v", long_options, NULL)) != -1) {
         // checking the options that were provided (using switch)
         switch (option) {
         // if the option was 'h' print the help message
         case 'h': print_help(); return 0;
+        // if the option was 't' read a table the input may be coded with
+        case 't':
+            if (huff_table_by_name(optarg) != NULL) {
+                // the built-in tables need no file
+                break;
+            }
+            table = huff_table_load(optarg);
+            if (table == NULL || table->id < HUFF_TABLE_FIRST_TRAINED) {
+                fprintf(stderr, "Error reading table %s\n", optarg);
+                huff_table_free(&table);
+                return 1;
+            }
+            huff_table_free(&tables[table->id]);
+            tables[table->id] = table;
+            break;
+        // if the option was 'v' report the stages
+        case 'v': verbose = true; break;
+        // if the option was "--metrics" write the metrics record to that file
+        case 'm': metrics_path = optarg; break;
+        // if the option was "--trace" write a timeline of the stages to that file
+        case 'T': trace_path = optarg; break;
         // if the option was 'i' use the input file
         case 'i': finame = optarg; break;
         // if the option was 'o' print the output into this file
         case 'o':
-            // taking the output file from the command line (using w to write in the file)
-            fout = fopen(optarg, "w");
+            // taking the output file from the command line (using w to write in the file),
+            // "-" writes to the standard output
+            fout = strcmp(optarg, "-") == 0 ? stdout : fopen(optarg, "w");
             // check that fout is not NULL
             if (fout == NULL) {
                 // print error
@@ -156,18 +144,84 @@ int main(int argc, char **argv) {
                 return 1;
             }
             break;
+        // if the option was 'j' decode blocks on that many threads
+        case 'j':
+            threads = strtoul(optarg, &end, 10);
+            if (*end != '\0' || threads > POOL_MAX_THREADS) {
+                fprintf(stderr, "threads must be between 0 and %d\n", POOL_MAX_THREADS);
+                print_help();
+                return 1;
+            }
+            break;
             // the default case it to break
         default: break;
         } // end of switch
     } // end of while loop
 
-    // opening the input file to read it
-    BitReader *inbuf = bit_read_open(finame);
-    // using the decompressing function to decode the input
-    dehuff_decompress_file(fout, inbuf);
-    // closing the input file
-    bit_read_close(&inbuf);
-    // closing the output file
+    // the counters must be open before the context starts its threads
+    Metrics *metrics = metrics_path != NULL ? metrics_start() : NULL;
+    HuffDCtx *ctx = huff_dctx_create((unsigned) threads);
+    if (ctx == NULL) {
+        fprintf(stderr, "Error: out of memory\n");
+        metrics_free(&metrics);
+        return 1;
+    }
+    // the trace is recorded where the stages are timed
+    huff_dctx_set_timing(ctx, verbose || metrics_path != NULL || trace_path != NULL);
+    for (int id = 0; id < 256; ++id) {
+        if (tables[id] != NULL) {
+            huff_dctx_add_table(ctx, tables[id]);
+        }
+    }
+    if (trace_path != NULL) {
+        trace_start();
+    }
+    uint64_t wall_ns = timer_now_ns();
+    uint64_t cpu_ns = timer_process_cpu_ns();
+    // block containers with an index decode block by block, in parallel with -j
+    // (the standard input cannot be read at an offset)
+    HuffIndexed indexed = strcmp(finame, "-") != 0 ? huff_decompress_indexed(ctx, fout, finame)
+                                                   : HUFF_INDEXED_UNUSABLE;
+    bool ok = indexed == HUFF_INDEXED_DONE;
+    // a file the index does not fit is decoded as a stream; one that failed
+    // part way is not decoded again
+    if (indexed == HUFF_INDEXED_UNUSABLE) {
+        // opening the input file to read it
+        BitReader *inbuf = bit_read_open(finame);
+        // using the decompressing function to decode the input
+        ok = inbuf != NULL && huff_decompress_file(ctx, fout, inbuf);
+        // closing the input file
+        bit_read_close(&inbuf);
+    }
+    // the library says why decoding failed, the message is printed here
+    if (!ok && huff_dctx_error(ctx) != HUFF_OK) {
+        fprintf(stderr, "Error: %s\n", huff_status_message(huff_dctx_error(ctx)));
+    }
+    // closing the output file, so its flush is part of the time
     fclose(fout);
-    return 0;
+    wall_ns = timer_now_ns() - wall_ns;
+    cpu_ns = timer_process_cpu_ns() - cpu_ns;
+    // the statistics are kept past the context, which must be freed first for the metrics
+    HuffStats stats = *huff_dctx_stats(ctx);
+    huff_dctx_free(&ctx);
+    if (ok && verbose) {
+        print_stats(&stats, wall_ns, cpu_ns);
+    }
+    if (metrics != NULL) {
+        metrics_stop(metrics);
+        if (ok && !metrics_write(metrics, metrics_path, "dehuff", &stats)) {
+            fprintf(stderr, "Error writing metrics file\n");
+            ok = false;
+        }
+        metrics_free(&metrics);
+    }
+    // the context's threads are done, so every span is in
+    if (trace_path != NULL && !trace_write(trace_path)) {
+        fprintf(stderr, "Error writing trace file\n");
+        ok = false;
+    }
+    for (int id = 0; id < 256; ++id) {
+        huff_table_free(&tables[id]);
+    }
+    return ok ? 0 : 1;
 } // end of main
@@ -0,0 +1,123 @@
+#include "histogram.h"
+
+#include "pool.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// the sub-histograms use 32-bit counters, so they are added to the 64-bit
+// result after at most this many bytes
+#define HISTOGRAM_CHUNK ((size_t) 1 << 30)
+
+// below this many bytes per thread, starting threads costs more than it saves
+#define HISTOGRAM_MIN_SHARD ((size_t) 1 << 20)
+
+// function that returns the 8 bytes at p as a little-endian word
+static inline uint64_t histogram_load(const uint8_t *p) {
+    uint64_t word;
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    memcpy(&word, p, sizeof(word));
+#else
+    word = 0;
+    for (int i = 0; i < 8; i++) {
+        word |= (uint64_t) p[i] << (8 * i);
+    }
+#endif
+    return word;
+}
+
+// function that counts at most HISTOGRAM_CHUNK bytes into the sub-histograms
+static void histogram_count_chunk(
+    const uint8_t *data, size_t n, uint32_t tables[HISTOGRAM_TABLES][256]) {
+    size_t i = 0;
+    // 16 bytes per iteration, byte k of each word goes to sub-histogram k
+    for (; i + 16 <= n; i += 16) {
+        uint64_t a = histogram_load(data + i);
+        uint64_t b = histogram_load(data + i + 8);
+        ++tables[0][a & 0xff];
+        ++tables[1][(a >> 8) & 0xff];
+        ++tables[2][(a >> 16) & 0xff];
+        ++tables[3][(a >> 24) & 0xff];
+        ++tables[4][(a >> 32) & 0xff];
+        ++tables[5][(a >> 40) & 0xff];
+        ++tables[6][(a >> 48) & 0xff];
+        ++tables[7][a >> 56];
+        ++tables[0][b & 0xff];
+        ++tables[1][(b >> 8) & 0xff];
+        ++tables[2][(b >> 16) & 0xff];
+        ++tables[3][(b >> 24) & 0xff];
+        ++tables[4][(b >> 32) & 0xff];
+        ++tables[5][(b >> 40) & 0xff];
+        ++tables[6][(b >> 48) & 0xff];
+        ++tables[7][b >> 56];
+    }
+    // the last few bytes
+    for (; i < n; ++i) {
+        ++tables[i % HISTOGRAM_TABLES][data[i]];
+    }
+}
+
+// function that adds the frequency of every byte of data to histogram
+void histogram_count(const uint8_t *data, size_t n, uint64_t *histogram) {
+    uint32_t tables[HISTOGRAM_TABLES][256];
+    while (n > 0) {
+        size_t chunk = n < HISTOGRAM_CHUNK ? n : HISTOGRAM_CHUNK;
+        memset(tables, 0, sizeof(tables));
+        histogram_count_chunk(data, chunk, tables);
+        for (int c = 0; c < 256; ++c) {
+            for (int t = 0; t < HISTOGRAM_TABLES; ++t) {
+                histogram[c] += tables[t][c];
+            }
+        }
+        data += chunk;
+        n -= chunk;
+    }
+}
+
+// one shard of histogram_count_threads()
+typedef struct HistogramShard {
+    const uint8_t *data;
+    size_t n;
+    uint64_t histogram[256];
+    PoolJob job;
+} HistogramShard;
+
+// function that counts one shard into its own histogram
+static void histogram_count_shard(void *arg) {
+    HistogramShard *shard = (HistogramShard *) arg;
+    histogram_count(shard->data, shard->n, shard->histogram);
+}
+
+// function that adds the frequency of every byte of data to histogram,
+// counting equal shards on up to threads threads and merging the results
+void histogram_count_threads(const uint8_t *data, size_t n, uint64_t *histogram, unsigned threads) {
+    size_t max_shards = n / HISTOGRAM_MIN_SHARD;
+    unsigned num_shards = threads < max_shards ? threads : (unsigned) max_shards;
+    HistogramShard *shards = NULL;
+    Pool *pool = NULL;
+    if (num_shards > 1) {
+        shards = (HistogramShard *) calloc(num_shards, sizeof(HistogramShard));
+        pool = shards != NULL ? pool_create(num_shards) : NULL;
+    }
+    if (pool == NULL) {
+        // too little data or no threads: count it here
+        free(shards);
+        histogram_count(data, n, histogram);
+        return;
+    }
+    size_t shard_size = n / num_shards;
+    for (unsigned s = 0; s < num_shards; ++s) {
+        shards[s].data = data + s * shard_size;
+        // the last shard takes the rest
+        shards[s].n = s + 1 < num_shards ? shard_size : n - s * shard_size;
+        pool_submit(pool, &shards[s].job, histogram_count_shard, &shards[s]);
+    }
+    for (unsigned s = 0; s < num_shards; ++s) {
+        pool_wait_job(pool, &shards[s].job);
+        for (int c = 0; c < 256; ++c) {
+            histogram[c] += shards[s].histogram[c];
+        }
+    }
+    pool_free(&pool);
+    free(shards);
+}
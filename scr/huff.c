@@ -1,159 +1,96 @@
-#include "bitreader.h"
 #include "bitwriter.h"
-#include "node.h"
-#include "pq.h"
+#include "block.h"
+#include "canon.h"
+#include "libhuff.h"
+#include "mapfile.h"
+#include "metrics.h"
+#include "pool.h"
+#include "timer.h"
+#include "trace.h"
 
 #include <getopt.h>
+#include <math.h>
+#include <stdbool.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
-typedef struct Code {
-    uint64_t code;
-    uint8_t code_length;
-} Code;
-
-// function that fills the histogram
-uint32_t fill_histogram(FILE *fin, uint32_t *histogram) {
-    // clearing all elements of the histogram array
-    for (int i = 0; i < 256; ++i) {
-        histogram[i] = 0;
-    }
-    // at least 2 values of the histogram are not zero
-    ++histogram[0x00];
-    ++histogram[0xff];
-    // initialize the total size of the file
-    uint32_t filesize = 0;
-    // getting the file name
-    int byte;
-    // using a while loop to read bytes from the input file
-    while ((byte = fgetc(fin)) != EOF) {
-        // updating the histogram
-        // increment histogram
-        ++histogram[byte];
-        // increment filesize
-        ++filesize;
-    }
-    // rewind the input file to the beginning
-    fseek(fin, 0, SEEK_SET);
-    // return the file size
-    return filesize;
+// funciton that prints the usage message
+void print_help(void) {
+    fprintf(stdout, "Usage: huff -i infile -o outfile\n"
+                    "       huff -v -i infile -o outfile\n"
+                    "       huff -L maxbits -i infile -o outfile\n"
+                    "       huff -b blocksize -i infile -o outfile\n"
+                    "       huff -j threads -i infile -o outfile\n"
+                    "       huff -s streams -i infile -o outfile\n"
+                    "       huff -t table -i infile -o outfile\n"
+                    "       huff --metrics=path -i infile -o outfile\n"
+                    "       huff --trace=file.json -i infile -o outfile\n"
+                    "       huff -h\n"
+                    "An infile or outfile of - is the standard input or output.  A table is\n"
+                    "a file from hufftrain, a built-in table (text, json or source), or auto\n"
+                    "to code each block with a built-in table when that is smaller.\n");
 }
 
-// function that creates the tree
-Node *create_tree(uint32_t *histogram, uint16_t *num_leaves) {
-    // create priority queue
-    PriorityQueue *pq = pq_create();
-    // iterate over the priority queue to fill the histogram
-    for (uint16_t i = 0; i < 256; ++i) {
-        if (histogram[i] > 0) {
-            Node *n_node = node_create((uint8_t) i, histogram[i]);
-            enqueue(pq, n_node);
-        }
+// function that prints the wall and CPU time of the stages among first..last,
+// with reading and writing, as milliseconds and shares of the wall time
+void print_stages(const HuffStats *stats, HuffStage first, HuffStage last, uint64_t wall_ns) {
+    HuffStage stages[HUFF_NUM_STAGES];
+    int count = 0;
+    stages[count++] = HUFF_STAGE_READ;
+    for (int s = first; s <= (int) last; ++s) {
+        stages[count++] = (HuffStage) s;
     }
-
-    // running the Huffman Coding algorithm
-    // using a while loop if the size of the pq is not 1
-    while (!pq_size_is_1(pq)) {
-        // dequeue left
-        Node *left = dequeue(pq);
-        // dequeue right
-        Node *right = dequeue(pq);
-        // create a new node:
-        // weight = left->weight + right->weight
-        // symbol = 0
-        Node *n_node = node_create(0, left->weight + right->weight);
-        // assigning the left and right of the new node
-        n_node->left = left;
-        n_node->right = right;
-        // enqueue new node
-        enqueue(pq, n_node);
-        (*num_leaves)++;
+    stages[count++] = HUFF_STAGE_WRITE;
+    fprintf(stderr, "  %-10s %10s %10s %7s\n", "stage", "wall ms", "cpu ms", "wall %");
+    for (int i = 0; i < count; ++i) {
+        HuffStage s = stages[i];
+        fprintf(stderr, "  %-10s %10.3f %10.3f %6.1f%%\n", huff_stage_name(s),
+            (double) stats->wall_ns[s] / 1e6, (double) stats->cpu_ns[s] / 1e6,
+            wall_ns ? 100.0 * (double) stats->wall_ns[s] / (double) wall_ns : 0.0);
     }
-    // dequeue the queue's only entry and return it
-    Node *huffman_tree = dequeue(pq);
-    // free priority queue
-    pq_free(&pq);
-    // incrementing the number of leaves
-    (*num_leaves)++;
-    // returning the tree
-    return huffman_tree;
 }
 
-// function that fills the code table
-void fill_code_table(Code *code_table, Node *node, uint64_t code, uint8_t code_length) {
-    // if node is null
-    if (node == NULL) {
-        // the function returns
-        return;
-    }
-    // if the left and right are NULL
-    if (node->left == NULL && node->right == NULL) {
-        // store the Huffman Code for left node
-        code_table[node->symbol].code = code;
-        code_table[node->symbol].code_length = code_length;
-        // return
-        return;
-    }
-    // recursive calls for left and right nodes
-    fill_code_table(code_table, node->left, code, code_length + 1);
-    // appending 1 to code and recurse
-    code |= (uint64_t) 1 << code_length;
-    fill_code_table(code_table, node->right, code, code_length + 1);
+// function that prints the total time, the throughput and whether the run
+// waited on I/O (the CPU time falls well short of the wall time) or not
+void print_totals(uint64_t bytes, uint64_t wall_ns, uint64_t cpu_ns) {
+    double ratio = wall_ns ? (double) cpu_ns / (double) wall_ns : 0.0;
+    fprintf(stderr, "  total      %10.3f %10.3f ms, %.1f MB/s, cpu/wall %.2f (%s)\n",
+        (double) wall_ns / 1e6, (double) cpu_ns / 1e6,
+        wall_ns ? (double) bytes * 1e3 / (double) wall_ns : 0.0, ratio,
+        ratio < 0.9 ? "I/O-bound" : "CPU-bound");
 }
 
-// function that prints the Huffman Code
-void huff_write_tree(BitWriter *outbuf, Node *node) {
-    if (node->left == NULL) {
-        // writing the leaf node
-        bit_write_bit(outbuf, 1);
-        bit_write_uint8(outbuf, node->symbol);
-    } else {
-        // writing the internal node
-        // writing the left node
-        huff_write_tree(outbuf, node->left);
-        // writing the right node
-        huff_write_tree(outbuf, node->right);
-        // writing the out buffer
-        bit_write_bit(outbuf, 0);
+// function that prints what the compression did: the time of every stage,
+// the entropy of the input against what the codes achieved, and the shape
+// of the codes
+void print_stats(const HuffStats *stats, uint64_t wall_ns, uint64_t cpu_ns) {
+    // the order-0 entropy of the input in bits per byte, over the bytes that
+    // were counted (blocks coded with a given table are not)
+    uint64_t counted = 0;
+    for (int i = 0; i < 256; ++i) {
+        counted += stats->histogram[i];
     }
-}
-
-// function that compresses the file
-void huff_compress_file(BitWriter *outbuf, FILE *fin, uint32_t filesize, uint16_t num_leaves,
-    Node *code_tree, Code *code_table) {
-    // writing 'H' and 'C' as magic number
-    bit_write_uint8(outbuf, 'H');
-    bit_write_uint8(outbuf, 'C');
-    // writing  filesize
-    bit_write_uint32(outbuf, filesize);
-    // writing number of leaves
-    bit_write_uint16(outbuf, num_leaves);
-    // writing Huffman Tree
-    huff_write_tree(outbuf, code_tree);
-    // rewind the input file to the beginning
-    fseek(fin, 0, SEEK_SET);
-    // initializing the input file
-    int infile;
-    // reading the input file and write Huffman codes
-    while ((infile = fgetc(fin)) != EOF) {
-        // retrieve the code for the read character from code_table
-        uint64_t code = code_table[infile].code;
-        // retrieve the code_length for the read character from code_table
-        uint8_t code_length = code_table[infile].code_length;
-        // a for loop that runs code_length times
-        for (int i = 0; i < code_length; ++i) {
-            // write the least significant bit of code to output
-            bit_write_bit(outbuf, (code & 1));
-            // right shift the bits of code by 1
-            code >>= 1;
-        } // end for loop
-    } // end while loop
-}
-
-// funciton that prints the usage message
-void print_help(void) {
-    fprintf(stdout, "Usage: huff -i infile -o outfile\n"
-                    "       huff -v -i infile -o outfile\n"
-                    "       huff -h\n");
+    double entropy = 0.0;
+    int symbols = 0;
+    for (int i = 0; i < 256; ++i) {
+        if (stats->histogram[i] != 0) {
+            double p = (double) stats->histogram[i] / (double) counted;
+            entropy -= p * log2(p);
+            symbols += 1;
+        }
+    }
+    double n = stats->input_bytes ? (double) stats->input_bytes : 1.0;
+    fprintf(stderr, "huff: %" PRIu64 " -> %" PRIu64 " bytes in %" PRIu64 " blocks, %" PRIu64
+                    " coded with a table, %" PRIu64 " stored, %" PRIu64 " runs\n",
+        stats->input_bytes, stats->output_bytes, stats->blocks, stats->table_blocks,
+        stats->stored_blocks, stats->run_blocks);
+    fprintf(stderr, "  entropy %.4f bits/symbol, codes %.4f, output %.4f\n", entropy,
+        (double) stats->limited_bits / n, 8.0 * (double) stats->output_bytes / n);
+    fprintf(stderr, "  %d symbols, up to %u leaves, tree depth %u, longest code %u bits\n",
+        symbols, stats->max_leaves, stats->max_depth, stats->max_code_length);
+    print_stages(stats, HUFF_STAGE_HISTOGRAM, HUFF_STAGE_ENCODE, wall_ns);
+    print_totals(stats->input_bytes, wall_ns, cpu_ns);
 }
 
 // the main function
@@ -162,8 +99,37 @@ int main(int argc, char **argv) {
     int option;
     // defining a file to scan the input file
     FILE *fin = NULL;
+    // the input file mapped into memory, NULL when it cannot be mapped
+    MappedFile *map = NULL;
     // defining a variable for the output file name
     BitWriter *outb;
+    // the longest code length the user allows (0 means no limit was given)
+    unsigned long max_length = 0;
+    // the number of input bytes in each block
+    unsigned long block_size = BLOCK_DEFAULT_SIZE;
+    // the number of threads that encode blocks (0 means one per online core)
+    unsigned long threads = 1;
+    // the number of sub-streams in each block
+    unsigned long num_streams = BLOCK_DEFAULT_STREAMS;
+    // whether to print the time of every stage and the entropy
+    bool verbose = false;
+    // the table every block is coded with, and the one read from a file
+    const HuffTable *table = NULL;
+    HuffTable *loaded = NULL;
+    // whether each block takes a built-in table when that is smaller
+    bool choose_table = false;
+    // where to write the JSON metrics record, NULL for nowhere
+    const char *metrics_path = NULL;
+    // where to write the Chrome trace of the stages, NULL for nowhere
+    const char *trace_path = NULL;
+    // the options that only have a long form
+    static const struct option long_options[] = {
+        { "metrics", required_argument, NULL, 'm' },
+        { "trace", required_argument, NULL, 'T' },
+        { NULL, 0, NULL, 0 },
+    };
+    // the end of a number given on the command line
+    char *end;
     // checking the input and output files are provided
     while (argc < 5) {
         if (argc < 3) {
@@ -177,15 +143,34 @@ int main(int argc, char **argv) {
         }
     }
     // while the user provides an option
-    while ((option = getopt(argc, argv, "hi:o:")) != -1) {
+    while ((option = getopt_long(argc, argv, "hi:o:L:b:j:s:t:v", long_options, NULL)) != -1) {
         // checking the options that were provided (using switch)
         switch (option) {
         // if the option was 'h' print the help message
         case 'h': print_help(); return 0;
+        // if the option was 't' code the blocks with a table
+        case 't':
+            if (strcmp(optarg, "auto") == 0) {
+                choose_table = true;
+            } else if ((table = huff_table_by_name(optarg)) == NULL) {
+                huff_table_free(&loaded);
+                table = loaded = huff_table_load(optarg);
+                if (table == NULL) {
+                    fprintf(stderr, "Error reading table %s\n", optarg);
+                    return 1;
+                }
+            }
+            break;
+        // if the option was 'v' report the stages and the entropy
+        case 'v': verbose = true; break;
+        // if the option was "--metrics" write the metrics record to that file
+        case 'm': metrics_path = optarg; break;
+        // if the option was "--trace" write a timeline of the stages to that file
+        case 'T': trace_path = optarg; break;
         // if the option was 'i' use the input file
         case 'i':
-            // opening the file with r
-            fin = fopen(optarg, "r");
+            // opening the file with r, "-" reads the standard input
+            fin = strcmp(optarg, "-") == 0 ? stdin : fopen(optarg, "r");
             // check that finis not NULL
             if (fin == NULL) {
                 // print error
@@ -195,6 +180,8 @@ int main(int argc, char **argv) {
                 // exiting the program
                 return 1;
             }
+            // regular files are coded in place, other inputs are read
+            map = fin != stdin ? map_open_read(optarg) : NULL;
             break;
         // if the option was 'o' print the output into this file
         case 'o':
@@ -210,42 +197,124 @@ int main(int argc, char **argv) {
                 return 1;
             }
             break;
+        // if the option was 'L' limit the code lengths
+        case 'L':
+            max_length = strtoul(optarg, &end, 10);
+            if (*end != '\0' || max_length < 1 || max_length > CANON_MAX_LENGTH) {
+                fprintf(stderr, "maxbits must be between 1 and %d\n", CANON_MAX_LENGTH);
+                print_help();
+                return 1;
+            }
+            break;
+        // if the option was 'b' set the block size, with an optional k or m suffix
+        case 'b':
+            block_size = strtoul(optarg, &end, 10);
+            if (*end == 'k' || *end == 'K') {
+                block_size *= 1024;
+                ++end;
+            } else if (*end == 'm' || *end == 'M') {
+                block_size *= 1024 * 1024;
+                ++end;
+            }
+            if (*end != '\0' || block_size < 1 || block_size > BLOCK_MAX_SIZE) {
+                fprintf(stderr, "blocksize must be between 1 and %d bytes\n", BLOCK_MAX_SIZE);
+                print_help();
+                return 1;
+            }
+            break;
+        // if the option was 'j' encode blocks on that many threads
+        case 'j':
+            threads = strtoul(optarg, &end, 10);
+            if (*end != '\0' || threads > POOL_MAX_THREADS) {
+                fprintf(stderr, "threads must be between 0 and %d\n", POOL_MAX_THREADS);
+                print_help();
+                return 1;
+            }
+            break;
+        // if the option was 's' split each block into that many sub-streams
+        case 's':
+            num_streams = strtoul(optarg, &end, 10);
+            if (*end != '\0' || num_streams < 1 || num_streams > BLOCK_MAX_STREAMS) {
+                fprintf(stderr, "streams must be between 1 and %d\n", BLOCK_MAX_STREAMS);
+                print_help();
+                return 1;
+            }
+            break;
             // the default case it to break
         default: return 1; break;
         } // end of switch
     } // end of while loop
 
-    // creating a histogram
-    uint32_t histogram[256];
-    // initializing the file size and filling the histogram
-    uint32_t filesize = fill_histogram(fin, histogram);
-    // initializing the number of leaves
-    uint16_t num_leaves = 0;
-    // creating the tree
-    Node *code_tree = create_tree(histogram, &num_leaves);
-    // if the tree is NULL
-    if (code_tree == NULL) {
-        // print error and help message
-        fprintf(stderr, "could not create the tree");
-        print_help();
-        // closing input file
-        fclose(fin);
-    }
-    // allocating the table
-    Code *code_table = malloc(256 * sizeof(Code));
-    // filling the table
-    fill_code_table(code_table, code_tree, 0, 0);
     // compressing the file and printing result to output file
-    huff_compress_file(outb, fin, filesize, num_leaves, code_tree, code_table);
-    // freeing the table
-    free(code_table);
-    // freeing the node
-    node_free(&code_tree);
+    HuffParams params;
+    huff_params_default(&params);
+    params.block_size = (uint32_t) block_size;
+    params.max_length = (uint8_t) (max_length != 0 ? max_length : CANON_MAX_LENGTH);
+    params.num_streams = (uint8_t) num_streams;
+    params.threads = (unsigned) threads;
+    params.table = table;
+    params.choose_table = choose_table;
+    // the trace is recorded where the stages are timed
+    params.timing = verbose || metrics_path != NULL || trace_path != NULL;
+    if (trace_path != NULL) {
+        trace_start();
+    }
+    // the counters must be open before the context starts its threads
+    Metrics *metrics = metrics_path != NULL ? metrics_start() : NULL;
+    HuffCCtx *ctx = huff_cctx_create(&params);
+    if (ctx == NULL) {
+        fprintf(stderr, "huff: out of memory\n");
+        metrics_free(&metrics);
+        return 1;
+    }
+    uint64_t wall_ns = timer_now_ns();
+    uint64_t cpu_ns = timer_process_cpu_ns();
+    // a mapped input is coded in place, anything else is read
+    bool ok = map != NULL ? huff_compress_file(ctx, outb, NULL, map_data(map), map_size(map))
+                          : huff_compress_file(ctx, outb, fin, NULL, 0);
+    wall_ns = timer_now_ns() - wall_ns;
+    cpu_ns = timer_process_cpu_ns() - cpu_ns;
+    // the statistics are kept past the context, which must be freed first for the metrics
+    HuffStats stats = *huff_cctx_stats(ctx);
+    huff_cctx_free(&ctx);
+    if (!ok) {
+        fprintf(stderr, "huff: out of memory\n");
+    }
+    if (ok && stats.widened_blocks > 0) {
+        fprintf(stderr, "huff: too many symbols for %u-bit codes in %" PRIu64 " block(s), using %d bits\n",
+            params.max_length, stats.widened_blocks, CANON_MAX_LENGTH);
+    }
+    if (ok && verbose) {
+        print_stats(&stats, wall_ns, cpu_ns);
+    }
+    if (ok && max_length != 0) {
+        // reporting what the limit costs compared with the optimal tree
+        fprintf(stderr, "huff: codes limited to %u bits take %" PRIu64 " bits, %+.3f%% vs optimal\n",
+            params.max_length, stats.limited_bits,
+            stats.optimal_bits ? 100.0 * (double) (stats.limited_bits - stats.optimal_bits)
+                                     / (double) stats.optimal_bits
+                               : 0.0);
+    }
+    if (metrics != NULL) {
+        metrics_stop(metrics);
+        if (ok && !metrics_write(metrics, metrics_path, "huff", &stats)) {
+            fprintf(stderr, "Error writing metrics file\n");
+            ok = false;
+        }
+        metrics_free(&metrics);
+    }
+    // the context's threads are done, so every span is in
+    if (trace_path != NULL && !trace_write(trace_path)) {
+        fprintf(stderr, "Error writing trace file\n");
+        ok = false;
+    }
     // closing input file
     fclose(fin);
+    map_close(&map);
     // making input file null
     fin = NULL;
     // closing output file
     bit_write_close(&outb);
-    return 0;
+    huff_table_free(&loaded);
+    return ok ? 0 : 1;
 } // end of main
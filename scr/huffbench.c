@@ -0,0 +1,361 @@
+#include "block.h"
+#include "libhuff.h"
+#include "mapfile.h"
+#include "pool.h"
+#include "timer.h"
+
+#include <getopt.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// the default size of each generated corpus and the number of runs of each measurement
+#define BENCH_DEFAULT_SIZE    (16 * 1024 * 1024)
+#define BENCH_DEFAULT_REPEATS 3
+
+// the number of distinct words in the text corpora
+#define BENCH_WORDS 4096
+
+// function that prints the usage message
+void print_help(void) {
+    fprintf(stdout, "Usage: huffbench [-s size] [-r repeats] [-j threads] [-b blocksize] [file ...]\n"
+                    "       huffbench -w directory [-s size]\n"
+                    "       huffbench -h\n"
+                    "Measures huff and dehuff on generated corpora and on the given files and\n"
+                    "prints one JSON object per corpus and thread count.  -j is the most\n"
+                    "threads tried (default: one per online core).  -w writes the generated\n"
+                    "corpora to files in the directory instead.\n");
+}
+
+// function that returns the next number of a fixed-seed xorshift generator,
+// so every run generates the same corpora
+static uint64_t bench_random(uint64_t *state) {
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+    return *state * 0x2545f4914f6cdd1dULL;
+}
+
+// function that fills data with uniformly random bytes, which do not compress
+static void gen_random(uint8_t *data, size_t n) {
+    uint64_t state = 1;
+    for (size_t i = 0; i < n; ++i) {
+        data[i] = (uint8_t) (bench_random(&state) >> 56);
+    }
+}
+
+// function that fills data with a single repeated byte
+static void gen_repeat(uint8_t *data, size_t n) {
+    memset(data, 'a', n);
+}
+
+// function that fills data with random letters of the 4-letter alphabet of DNA
+static void gen_dna(uint8_t *data, size_t n) {
+    uint64_t state = 2;
+    for (size_t i = 0; i < n; ++i) {
+        data[i] = (uint8_t) ("ACGT"[bench_random(&state) >> 62]);
+    }
+}
+
+// function that fills data with random hexadecimal digits, a 16-letter alphabet
+static void gen_hex(uint8_t *data, size_t n) {
+    uint64_t state = 3;
+    for (size_t i = 0; i < n; ++i) {
+        data[i] = (uint8_t) ("0123456789abcdef"[bench_random(&state) >> 60]);
+    }
+}
+
+// function that fills data with words whose frequencies follow Zipf's law,
+// like natural-language text
+static void gen_zipf(uint8_t *data, size_t n) {
+    uint64_t state = 4;
+    // the vocabulary: random lowercase words of 1 to 10 letters
+    static char words[BENCH_WORDS][11];
+    static double cumulative[BENCH_WORDS];
+    double total = 0;
+    for (int w = 0; w < BENCH_WORDS; ++w) {
+        int length = 1 + (int) (bench_random(&state) % 10);
+        for (int c = 0; c < length; ++c) {
+            words[w][c] = (char) ('a' + bench_random(&state) % 26);
+        }
+        words[w][length] = '\0';
+        // the k-th most common word is k times rarer than the most common one
+        total += 1.0 / (w + 1);
+        cumulative[w] = total;
+    }
+    size_t i = 0;
+    for (uint64_t count = 1; i < n; ++count) {
+        double u = (double) (bench_random(&state) >> 11) / 9007199254740992.0 * total;
+        int lo = 0;
+        int hi = BENCH_WORDS - 1;
+        while (lo < hi) {
+            int mid = (lo + hi) / 2;
+            if (cumulative[mid] < u) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        for (const char *c = words[lo]; *c != '\0' && i < n; ++c) {
+            data[i++] = (uint8_t) *c;
+        }
+        if (i < n) {
+            data[i++] = count % 12 == 0 ? '\n' : ' ';
+        }
+    }
+}
+
+// function that fills data with lines like those of a web server's log
+static void gen_log(uint8_t *data, size_t n) {
+    static const char *levels[] = { "INFO", "INFO", "INFO", "DEBUG", "WARN", "ERROR" };
+    static const char *paths[] = { "/api/v1/items", "/api/v1/users", "/static/app.js",
+        "/login", "/api/v1/orders", "/health" };
+    static const char *methods[] = { "GET", "GET", "GET", "POST", "PUT", "DELETE" };
+    static const unsigned statuses[] = { 200, 200, 200, 200, 304, 404, 500, 201 };
+    uint64_t state = 5;
+    uint64_t ms = 0;
+    size_t i = 0;
+    while (i < n) {
+        char line[256];
+        ms += bench_random(&state) % 250;
+        uint64_t r = bench_random(&state);
+        int length = snprintf(line, sizeof(line),
+            "2026-10-18T%02u:%02u:%02u.%03uZ %-5s [worker-%u] %s %s/%u status=%u bytes=%u "
+            "latency_ms=%u\n",
+            (unsigned) (ms / 3600000 % 24), (unsigned) (ms / 60000 % 60),
+            (unsigned) (ms / 1000 % 60), (unsigned) (ms % 1000), levels[r % 6],
+            (unsigned) (r >> 8 & 7), methods[(r >> 12) % 6], paths[(r >> 20) % 6],
+            (unsigned) (r >> 24 & 0xffff), statuses[r >> 40 & 7], (unsigned) (r >> 43 & 0xffff),
+            (unsigned) (r >> 59));
+        for (int c = 0; c < length && i < n; ++c) {
+            data[i++] = (uint8_t) line[c];
+        }
+    }
+}
+
+// function that fills data with the output of huff on text, repeated as needed
+static void gen_compressed(uint8_t *data, size_t n) {
+    size_t text_size = n > 0 ? n : 1;
+    uint8_t *text = (uint8_t *) malloc(text_size);
+    size_t cap = huff_compress_bound(text_size);
+    uint8_t *packed = (uint8_t *) malloc(cap);
+    size_t size = HUFF_ERROR;
+    if (text != NULL && packed != NULL) {
+        gen_zipf(text, text_size);
+        size = huff_compress_buffer(text, text_size, packed, cap);
+    }
+    for (size_t i = 0; i < n; ++i) {
+        data[i] = size != HUFF_ERROR ? packed[i % size] : 0;
+    }
+    free(text);
+    free(packed);
+}
+
+// the generated corpora
+typedef struct BenchCorpus {
+    const char *name;
+    void (*generate)(uint8_t *data, size_t n);
+} BenchCorpus;
+
+static const BenchCorpus corpora[] = {
+    { "random", gen_random },
+    { "zipf", gen_zipf },
+    { "repeat", gen_repeat },
+    { "dna", gen_dna },
+    { "hex", gen_hex },
+    { "log", gen_log },
+    { "compressed", gen_compressed },
+};
+
+// function that prints s as a JSON string
+static void print_json_string(const char *s) {
+    putchar('"');
+    for (; *s != '\0'; ++s) {
+        if (*s == '"' || *s == '\\') {
+            printf("\\%c", *s);
+        } else if ((unsigned char) *s < 0x20) {
+            printf("\\u%04x", (unsigned) *s);
+        } else {
+            putchar(*s);
+        }
+    }
+    putchar('"');
+}
+
+// function that measures compression and decompression of the n bytes at
+// data with each thread count up to max_threads and prints a JSON line for
+// each; every time is the best of repeats runs
+static bool bench_corpus(const char *name, const uint8_t *data, size_t n, HuffParams params,
+    unsigned max_threads, unsigned repeats) {
+    params.threads = 1;
+    HuffCCtx *cctx = huff_cctx_create(&params);
+    if (cctx == NULL) {
+        fprintf(stderr, "huffbench: bad parameters\n");
+        return false;
+    }
+    size_t cap = huff_cctx_bound(cctx, n);
+    huff_cctx_free(&cctx);
+    uint8_t *packed = (uint8_t *) malloc(cap);
+    uint8_t *unpacked = (uint8_t *) malloc(n > 0 ? n : 1);
+    bool ok = packed != NULL && unpacked != NULL;
+    // 1, 2, 4, ... threads and then max_threads
+    for (unsigned threads = 1; ok && threads <= max_threads;
+         threads = threads < max_threads && 2 * threads > max_threads ? max_threads : 2 * threads) {
+        params.threads = threads;
+        cctx = huff_cctx_create(&params);
+        HuffDCtx *dctx = huff_dctx_create(threads);
+        ok = cctx != NULL && dctx != NULL;
+        uint64_t compress_ns = UINT64_MAX;
+        uint64_t decompress_ns = UINT64_MAX;
+        HuffStats stats = { 0 };
+        size_t size = 0;
+        for (unsigned r = 0; ok && r < repeats; ++r) {
+            uint64_t start = timer_now_ns();
+            size = huff_compress_ctx(cctx, data, n, packed, cap);
+            uint64_t elapsed = timer_now_ns() - start;
+            ok = size != HUFF_ERROR;
+            if (ok && elapsed < compress_ns) {
+                compress_ns = elapsed;
+                stats = *huff_cctx_stats(cctx);
+            }
+        }
+        for (unsigned r = 0; ok && r < repeats; ++r) {
+            uint64_t start = timer_now_ns();
+            ok = huff_decompress_ctx(dctx, packed, size, unpacked, n) == n;
+            uint64_t elapsed = timer_now_ns() - start;
+            decompress_ns = elapsed < decompress_ns ? elapsed : decompress_ns;
+        }
+        if (ok && memcmp(data, unpacked, n) != 0) {
+            ok = false;
+        }
+        if (!ok) {
+            fprintf(stderr, "huffbench: %s does not round-trip with %u threads\n", name, threads);
+        } else {
+            // the rates are in MB (10^6 bytes) of uncompressed data per second
+            printf("{\"corpus\":");
+            print_json_string(name);
+            printf(",\"bytes\":%zu,\"block_size\":%u,\"threads\":%u,\"compressed_bytes\":%zu,"
+                   "\"ratio\":%.4f,\"compress_mb_s\":%.1f,\"decompress_mb_s\":%.1f,"
+                   "\"compress_ns\":%" PRIu64 ",\"histogram_ns\":%" PRIu64 ",\"tree_ns\":%" PRIu64
+                   ",\"header_ns\":%" PRIu64 ",\"encode_ns\":%" PRIu64
+                   ",\"decode_ns\":%" PRIu64 "}\n",
+                n, params.block_size, threads, size, (double) n / (double) size,
+                (double) n * 1e3 / (double) (compress_ns ? compress_ns : 1),
+                (double) n * 1e3 / (double) (decompress_ns ? decompress_ns : 1), compress_ns,
+                stats.wall_ns[HUFF_STAGE_HISTOGRAM],
+                stats.wall_ns[HUFF_STAGE_TREE] + stats.wall_ns[HUFF_STAGE_CODES],
+                stats.wall_ns[HUFF_STAGE_HEADER], stats.wall_ns[HUFF_STAGE_ENCODE],
+                decompress_ns);
+            fflush(stdout);
+        }
+        huff_cctx_free(&cctx);
+        huff_dctx_free(&dctx);
+        if (threads == max_threads) {
+            break;
+        }
+    }
+    free(packed);
+    free(unpacked);
+    return ok;
+}
+
+// function that writes every generated corpus of n bytes to a file in directory
+static bool write_corpora(const char *directory, uint8_t *data, size_t n) {
+    for (size_t c = 0; c < sizeof(corpora) / sizeof(corpora[0]); ++c) {
+        char path[4096];
+        snprintf(path, sizeof(path), "%s/%s.bin", directory, corpora[c].name);
+        corpora[c].generate(data, n);
+        FILE *f = fopen(path, "w");
+        if (f == NULL || fwrite(data, 1, n, f) != n) {
+            fprintf(stderr, "huffbench: cannot write %s\n", path);
+            if (f != NULL) {
+                fclose(f);
+            }
+            return false;
+        }
+        fclose(f);
+    }
+    return true;
+}
+
+// the main function
+int main(int argc, char **argv) {
+    int option;
+    unsigned long size = BENCH_DEFAULT_SIZE;
+    unsigned long repeats = BENCH_DEFAULT_REPEATS;
+    unsigned long max_threads = pool_online_cores();
+    const char *directory = NULL;
+    HuffParams params;
+    huff_params_default(&params);
+    params.timing = true;
+    char *end;
+    while ((option = getopt(argc, argv, "hs:r:j:b:w:")) != -1) {
+        switch (option) {
+        case 'h': print_help(); return 0;
+        case 's':
+            size = strtoul(optarg, &end, 10);
+            if (*end != '\0') {
+                print_help();
+                return 1;
+            }
+            break;
+        case 'r':
+            repeats = strtoul(optarg, &end, 10);
+            if (*end != '\0' || repeats < 1) {
+                print_help();
+                return 1;
+            }
+            break;
+        case 'j':
+            max_threads = strtoul(optarg, &end, 10);
+            if (*end != '\0' || max_threads < 1 || max_threads > POOL_MAX_THREADS) {
+                fprintf(stderr, "threads must be between 1 and %d\n", POOL_MAX_THREADS);
+                return 1;
+            }
+            break;
+        case 'b': {
+            unsigned long block_size = strtoul(optarg, &end, 10);
+            if (*end != '\0' || block_size < 1 || block_size > BLOCK_MAX_SIZE) {
+                fprintf(stderr, "block size must be between 1 and %d\n", BLOCK_MAX_SIZE);
+                return 1;
+            }
+            params.block_size = (uint32_t) block_size;
+            break;
+        }
+        case 'w': directory = optarg; break;
+        default: print_help(); return 1;
+        }
+    }
+
+    uint8_t *data = (uint8_t *) malloc(size > 0 ? size : 1);
+    if (data == NULL) {
+        fprintf(stderr, "huffbench: out of memory\n");
+        return 1;
+    }
+    bool ok = true;
+    if (directory != NULL) {
+        ok = write_corpora(directory, data, size);
+        free(data);
+        return ok ? 0 : 1;
+    }
+    // the generated corpora, then the files of the command line
+    for (size_t c = 0; ok && c < sizeof(corpora) / sizeof(corpora[0]); ++c) {
+        corpora[c].generate(data, size);
+        ok = bench_corpus(
+            corpora[c].name, data, size, params, (unsigned) max_threads, (unsigned) repeats);
+    }
+    free(data);
+    for (int i = optind; ok && i < argc; ++i) {
+        MappedFile *map = map_open_read(argv[i]);
+        if (map == NULL) {
+            fprintf(stderr, "huffbench: cannot map %s\n", argv[i]);
+            ok = false;
+            break;
+        }
+        ok = bench_corpus(argv[i], map_data(map), (size_t) map_size(map), params,
+            (unsigned) max_threads, (unsigned) repeats);
+        map_close(&map);
+    }
+    return ok ? 0 : 1;
+}
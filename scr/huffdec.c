@@ -0,0 +1,1124 @@
+#include "libhuff.h"
+
+#include "arena.h"
+#include "bitio_ext.h"
+#include "bitreader.h"
+#include "block.h"
+#include "canon.h"
+#include "dectable.h"
+#include "mapfile.h"
+#include "pool.h"
+#include "timer.h"
+#include "trace.h"
+#include "tree.h"
+
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// number of decoded bytes collected before each fwrite()
+#define OUT_BUFFER_SIZE (64 * 1024)
+
+// the chunk size of a decoding arena: one chunk holds a block's reader and
+// its largest decode table (entries with the copies left by growing them,
+// and the multi-symbol table), so which blocks a thread gets never makes
+// it take a second chunk
+#define DEHUFF_ARENA_SIZE (256 * 1024)
+
+// function that reads the legacy post-order tree (format 'H' 'C') and
+// returns a decode table for it
+static DecodeTable *dehuff_read_tree(BitReader *inbuf) {
+    // read the number of symbols in the file
+    uint16_t num_leaves = bit_read_uint16(inbuf);
+    // the tree is read into a flat array on the stack, no node is allocated
+    FlatTree code_tree;
+    if (!tree_read_flat(inbuf, num_leaves, &code_tree)) {
+        return NULL;
+    }
+    // building the lookup table that replaces walking the tree bit by bit
+    return dt_create_flat(&code_tree);
+}
+
+// function that reads the code lengths of a canonical code (format 'H' 'F' 2)
+// and returns a decode table for it, no tree is needed
+static DecodeTable *dehuff_read_lengths(BitReader *inbuf) {
+    uint8_t code_lengths[256];
+    if (!canon_read_lengths(inbuf, code_lengths)) {
+        return NULL;
+    }
+    uint64_t codes[256];
+    canon_assign(code_lengths, codes);
+    return dt_create_from_codes(codes, code_lengths);
+}
+
+// function that decodes n symbols with table and writes them to the output file
+static void dehuff_decode_symbols(FILE *fout, BitReader *inbuf, DecodeTable *table, uint64_t n) {
+    // decoding the compressed data one output buffer at a time
+    uint8_t out[OUT_BUFFER_SIZE];
+    for (uint64_t done = 0; done < n;) {
+        size_t chunk = n - done < OUT_BUFFER_SIZE ? (size_t) (n - done) : OUT_BUFFER_SIZE;
+        dt_decode(table, inbuf, out, chunk);
+        // write the decoded symbols to the output file
+        fwrite(out, 1, chunk, fout);
+        done += chunk;
+    }
+}
+
+// function that returns the little-endian 32-bit field at p
+static uint32_t dehuff_get_uint32(const uint8_t *p) {
+    return (uint32_t) p[0] | (uint32_t) p[1] << 8 | (uint32_t) p[2] << 16 | (uint32_t) p[3] << 24;
+}
+
+// function that returns the little-endian 64-bit field at p
+static uint64_t dehuff_get_uint64(const uint8_t *p) {
+    return (uint64_t) dehuff_get_uint32(p) | (uint64_t) dehuff_get_uint32(p + 4) << 32;
+}
+
+// function that adds the time since mark to a stage of block when stats are
+// kept, and records the stage in the trace when one is being recorded
+static void dehuff_lap(HuffStats *stats, TimerMark *mark, HuffStage stage, uint64_t block) {
+    if (stats != NULL) {
+        uint64_t start_ns = mark->wall_ns;
+        timer_lap(mark, &stats->wall_ns[stage], &stats->cpu_ns[stage]);
+        trace_span(huff_stage_name(stage), block, start_ns, mark->wall_ns);
+    }
+}
+
+// function that decodes the compressed_length bytes of one block of the
+// container (everything after the block header) into the length bytes at out;
+// the reader and the decode table come from arena, which is reset first.
+// When stats is not NULL, the block's code shape and stage times go there,
+// and its stages are traced as block number.  A block that names a preset
+// table is decoded with the one of that ID in tables (which may be NULL) or
+// the built-in one.  Stored and run blocks are copied and filled.  It returns
+// HUFF_OK, or why the block does not decode.
+static HuffStatus dehuff_decode_block(Arena *arena, HuffStats *stats, uint64_t number,
+    const HuffTable *const *tables, const uint8_t *in, uint32_t compressed_length, uint8_t *out,
+    uint32_t length, uint8_t version) {
+    TimerMark mark = { 0, 0 };
+    if (stats != NULL) {
+        mark = timer_mark();
+    }
+    uint64_t start_ns = mark.wall_ns;
+    BlockKind kind = version == BLOCK_VERSION ? block_read_kind(in, compressed_length) : BLOCK_CODED;
+    if (kind == BLOCK_STORED || kind == BLOCK_RUN) {
+        bool ok = compressed_length
+                  == (kind == BLOCK_STORED ? BLOCK_STORED_SIZE + (uint64_t) length : BLOCK_RUN_SIZE);
+        if (!ok) {
+            // the bytes do not match the block's length
+        } else if (kind == BLOCK_STORED) {
+            memcpy(out, in + BLOCK_STORED_SIZE, length);
+        } else {
+            memset(out, in[2], length);
+        }
+        dehuff_lap(stats, &mark, HUFF_STAGE_DECODE, number);
+        if (stats != NULL) {
+            trace_span("block", number, start_ns, mark.wall_ns);
+        }
+        return ok ? HUFF_OK : HUFF_DATA_ERROR;
+    }
+    arena_reset(arena);
+    BitReader *inbuf = bit_read_open_arena(arena, in, compressed_length);
+    if (inbuf == NULL) {
+        return HUFF_MEM_ERROR;
+    }
+    uint8_t code_lengths[256];
+    uint64_t own_codes[256];
+    const uint64_t *codes = own_codes;
+    // where the sub-stream table starts
+    size_t pos;
+    int id = kind == BLOCK_PRESET ? block_read_preset(in, compressed_length) : -1;
+    if (id >= 0) {
+        // the block is coded with a table both sides have
+        const HuffTable *preset = tables != NULL ? tables[id] : NULL;
+        preset = preset != NULL ? preset : huff_table_builtin((uint8_t) id);
+        if (preset == NULL) {
+            bit_read_close(&inbuf);
+            return HUFF_TABLE_ERROR;
+        }
+        memcpy(code_lengths, preset->code_lengths, sizeof(code_lengths));
+        codes = preset->codes;
+        pos = BLOCK_PRESET_SIZE;
+    } else {
+        // every other block brings its own code lengths
+        if (!canon_read_lengths(inbuf, code_lengths)) {
+            bit_read_close(&inbuf);
+            return HUFF_DATA_ERROR;
+        }
+        canon_assign(code_lengths, own_codes);
+        pos = (canon_write_lengths(NULL, code_lengths) + 7) / 8;
+    }
+    dehuff_lap(stats, &mark, HUFF_STAGE_PARSE, number);
+    DecodeTable *table = dt_create_from_codes_arena(arena, codes, code_lengths);
+    if (table == NULL) {
+        // the lengths do not make a complete code
+        bit_read_close(&inbuf);
+        return HUFF_DATA_ERROR;
+    }
+    if (stats != NULL) {
+        uint16_t leaves = 0;
+        for (int s = 0; s < 256; ++s) {
+            leaves = (uint16_t) (leaves + (code_lengths[s] != 0));
+            if (code_lengths[s] > stats->max_code_length) {
+                stats->max_code_length = code_lengths[s];
+            }
+        }
+        stats->max_leaves = leaves > stats->max_leaves ? leaves : stats->max_leaves;
+        stats->max_depth = stats->max_code_length;
+    }
+    dehuff_lap(stats, &mark, HUFF_STAGE_TABLE, number);
+    bool ok = true;
+    if (version == BLOCK_VERSION_SINGLE) {
+        // one stream of codes right after the code lengths
+        dt_decode(table, inbuf, out, length);
+    } else {
+        // the sub-stream table starts on the byte after the code lengths
+        uint8_t num_streams = pos < compressed_length ? in[pos++] : 0;
+        ok = num_streams >= 1 && num_streams <= BLOCK_MAX_STREAMS
+             && pos + 4 * (size_t) (num_streams - 1) <= compressed_length;
+        const uint8_t *src[BLOCK_MAX_STREAMS];
+        size_t src_lengths[BLOCK_MAX_STREAMS];
+        uint8_t *dst[BLOCK_MAX_STREAMS];
+        size_t dst_lengths[BLOCK_MAX_STREAMS];
+        size_t stream_start = ok ? pos + 4 * (size_t) (num_streams - 1) : 0;
+        uint8_t *next_out = out;
+        for (uint8_t s = 0; ok && s < num_streams; ++s) {
+            // the last sub-stream takes the rest of the block
+            size_t n = s + 1 < num_streams ? dehuff_get_uint32(in + pos + 4 * s)
+                                           : compressed_length - stream_start;
+            ok = stream_start + n <= compressed_length;
+            src[s] = in + stream_start;
+            src_lengths[s] = n;
+            stream_start += n;
+            dst[s] = next_out;
+            dst_lengths[s] = block_stream_length(length, num_streams, s);
+            next_out += dst_lengths[s];
+        }
+        dehuff_lap(stats, &mark, HUFF_STAGE_PARSE, number);
+        if (ok) {
+            dt_decode_streams(table, num_streams, src, src_lengths, dst, dst_lengths);
+        }
+    }
+    dehuff_lap(stats, &mark, HUFF_STAGE_DECODE, number);
+    if (stats != NULL) {
+        // the whole block, around its stages
+        trace_span("block", number, start_ns, mark.wall_ns);
+    }
+    dt_free(&table);
+    bit_read_close(&inbuf);
+    // a sub-stream table that does not fit the block is the only failure left
+    return ok ? HUFF_OK : HUFF_DATA_ERROR;
+}
+
+// one block of the container, located through the block index
+typedef struct DehuffBlock {
+    // where the compressed bytes start in the input and how many there are
+    uint64_t offset;
+    uint32_t compressed_length;
+    // where the decoded bytes go in the output and how many there are
+    uint64_t out_offset;
+    uint32_t length;
+} DehuffBlock;
+
+// the blocks of one file, shared by the threads that decode them
+typedef struct DehuffBlocks {
+    int in_fd;
+    int out_fd;
+    // the mapped input and output files, NULL when pread() and pwrite() are used
+    const uint8_t *in_map;
+    uint8_t *out_map;
+    uint64_t in_size;
+    // one of the versions of the block container
+    uint8_t version;
+    DehuffBlock *blocks;
+    uint64_t count;
+    // the next block a thread takes
+    atomic_uint_fast64_t next;
+    // set when any block fails, the other threads then stop early
+    atomic_bool failed;
+} DehuffBlocks;
+
+// what one decoding thread keeps from block to block and from call to call
+typedef struct DehuffWorker {
+    DehuffBlocks *work;
+    // buffers for blocks that are not mapped, grown to the largest block
+    uint8_t *in;
+    uint8_t *out;
+    size_t in_size;
+    size_t out_size;
+    // the reader and decode table of the current block
+    Arena *arena;
+    // the context's trained tables, by ID
+    const HuffTable *const *tables;
+    // what this thread did in the current call, NULL when the context does not time
+    HuffStats *stats;
+    HuffStats own_stats;
+    // why this thread stopped in the current call, HUFF_OK while it has not failed
+    HuffStatus error;
+    // the pool's handle for the thread's job
+    PoolJob job;
+} DehuffWorker;
+
+struct HuffDCtx {
+    unsigned threads;
+    bool timing;
+    Pool *pool;
+    // one worker per thread
+    DehuffWorker *workers;
+    // the blocks of the current input
+    DehuffBlock *blocks;
+    uint64_t capacity;
+    HuffStats stats;
+    // why the last call failed, HUFF_OK when it did not
+    HuffStatus error;
+    // the trained tables blocks may name, by ID; built-in IDs stay NULL
+    const HuffTable *tables[256];
+};
+
+// function that makes the buffer at *buf hold at least n bytes
+static bool dehuff_reserve(uint8_t **buf, size_t *size, size_t n) {
+    if (n <= *size) {
+        return true;
+    }
+    free(*buf);
+    *buf = (uint8_t *) malloc(n);
+    *size = *buf != NULL ? n : 0;
+    return *buf != NULL;
+}
+
+// function that decodes the blocks of the block container (format 'H' 'F' 3
+// to 5) up to the end marker, then checks the block index after it; input
+// that ends early or whose lengths are out of range fails, with the reason
+// in worker->error
+static bool dehuff_decompress_blocks(
+    DehuffWorker *worker, FILE *fout, BitReader *inbuf, uint8_t version) {
+    HuffStats *stats = worker->stats;
+    TimerMark mark = { 0, 0 };
+    // the block size is only a hint for the decoder
+    uint8_t field[BLOCK_TRAILER_SIZE];
+    bool ok = bit_read_bytes(inbuf, field, 4);
+    // the offset of every block, to check against the index
+    BlockIndex *index = block_index_create();
+    uint64_t offset = BLOCK_FILE_HEADER_SIZE;
+    ok = ok && index != NULL;
+    while (ok) {
+        ok = bit_read_bytes(inbuf, field, 4);
+        uint32_t length = dehuff_get_uint32(field);
+        if (!ok || length == 0) {
+            break;
+        }
+        // the compressed length tells how much to read for the block
+        ok = bit_read_bytes(inbuf, field, 4);
+        uint32_t compressed_length = dehuff_get_uint32(field);
+        // the lengths bound what the buffers must hold
+        if (!ok || length > BLOCK_MAX_SIZE || compressed_length > block_read_bound(length)) {
+            ok = false;
+            break;
+        }
+        // the worker's buffers are grown to the largest block
+        if (!dehuff_reserve(&worker->in, &worker->in_size, compressed_length)
+            || !dehuff_reserve(&worker->out, &worker->out_size, length)
+            || !block_index_append(index, offset, length)) {
+            worker->error = HUFF_MEM_ERROR;
+            block_index_free(&index);
+            return false;
+        }
+        offset += BLOCK_HEADER_SIZE + (uint64_t) compressed_length;
+        if (stats != NULL) {
+            mark = timer_mark();
+        }
+        ok = bit_read_bytes(inbuf, worker->in, compressed_length);
+        // the blocks are numbered by how many this worker has decoded
+        uint64_t number = worker->own_stats.blocks;
+        dehuff_lap(stats, &mark, HUFF_STAGE_READ, number);
+        if (!ok) {
+            break;
+        }
+        worker->error = dehuff_decode_block(worker->arena, stats, number, worker->tables,
+            worker->in, compressed_length, worker->out, length, version);
+        if (worker->error != HUFF_OK) {
+            block_index_free(&index);
+            return false;
+        }
+        // write the decoded symbols to the output file
+        if (stats != NULL) {
+            mark = timer_mark();
+        }
+        fwrite(worker->out, 1, length, fout);
+        dehuff_lap(stats, &mark, HUFF_STAGE_WRITE, number);
+        worker->own_stats.input_bytes += BLOCK_HEADER_SIZE + (uint64_t) compressed_length;
+        worker->own_stats.output_bytes += length;
+        worker->own_stats.blocks += 1;
+    }
+    // each offset in the index must be where that block started
+    for (uint64_t i = 0; ok && i < block_index_count(index); ++i) {
+        ok = bit_read_bytes(inbuf, field, 8)
+             && dehuff_get_uint64(field) == block_index_offset(index, i);
+    }
+    ok = ok && bit_read_bytes(inbuf, field, BLOCK_TRAILER_SIZE)
+         && dehuff_get_uint64(field) == block_index_total(index)
+         && dehuff_get_uint64(field + 8) == block_index_count(index)
+         && memcmp(field + 16, "HFIX", 4) == 0;
+    if (!ok) {
+        worker->error = index != NULL ? HUFF_DATA_ERROR : HUFF_MEM_ERROR;
+    }
+    block_index_free(&index);
+    return ok;
+}
+
+// function that reads n bytes at offset with pread(), retrying short reads
+static bool dehuff_pread(int fd, uint8_t *buf, size_t n, uint64_t offset) {
+    while (n > 0) {
+        ssize_t got = pread(fd, buf, n, (off_t) offset);
+        if (got <= 0) {
+            return false;
+        }
+        buf += got;
+        n -= (size_t) got;
+        offset += (uint64_t) got;
+    }
+    return true;
+}
+
+// function that writes n bytes at offset with pwrite(), retrying short writes
+static bool dehuff_pwrite(int fd, const uint8_t *buf, size_t n, uint64_t offset) {
+    while (n > 0) {
+        ssize_t put = pwrite(fd, buf, n, (off_t) offset);
+        if (put <= 0) {
+            return false;
+        }
+        buf += put;
+        n -= (size_t) put;
+        offset += (uint64_t) put;
+    }
+    return true;
+}
+
+// function that copies n input bytes at offset into buf, from the mapped input if there is one
+static bool dehuff_read_at(DehuffBlocks *work, uint8_t *buf, size_t n, uint64_t offset) {
+    if (offset > work->in_size || n > work->in_size - offset) {
+        return false;
+    }
+    if (work->in_map != NULL) {
+        memcpy(buf, work->in_map + offset, n);
+        return true;
+    }
+    return dehuff_pread(work->in_fd, buf, n, offset);
+}
+
+// function that every decoding thread runs: take the next block, decode it
+// and put it where it belongs in the output.  Mapped files and buffers are
+// decoded in place, otherwise the block goes through this worker's buffers.
+static void dehuff_decode_blocks(void *arg) {
+    DehuffWorker *worker = (DehuffWorker *) arg;
+    DehuffBlocks *work = worker->work;
+    uint64_t i;
+    while (!atomic_load(&work->failed) && (i = atomic_fetch_add(&work->next, 1)) < work->count) {
+        DehuffBlock *block = &work->blocks[i];
+        const uint8_t *src;
+        uint8_t *dst;
+        if ((work->in_map == NULL
+                && !dehuff_reserve(&worker->in, &worker->in_size, block->compressed_length))
+            || (work->out_map == NULL
+                && !dehuff_reserve(&worker->out, &worker->out_size, block->length))) {
+            worker->error = HUFF_MEM_ERROR;
+            atomic_store(&work->failed, true);
+            break;
+        }
+        TimerMark mark = { 0, 0 };
+        if (worker->stats != NULL) {
+            mark = timer_mark();
+        }
+        if (work->in_map != NULL) {
+            src = work->in_map + block->offset + BLOCK_HEADER_SIZE;
+        } else if (dehuff_pread(work->in_fd, worker->in, block->compressed_length,
+                       block->offset + BLOCK_HEADER_SIZE)) {
+            src = worker->in;
+            dehuff_lap(worker->stats, &mark, HUFF_STAGE_READ, i);
+        } else {
+            worker->error = HUFF_IO_ERROR;
+            atomic_store(&work->failed, true);
+            break;
+        }
+        dst = work->out_map != NULL ? work->out_map + block->out_offset : worker->out;
+        worker->error = dehuff_decode_block(worker->arena, worker->stats, i, worker->tables, src,
+            block->compressed_length, dst, block->length, work->version);
+        if (worker->error != HUFF_OK) {
+            atomic_store(&work->failed, true);
+            break;
+        }
+        if (worker->stats != NULL) {
+            mark = timer_mark();
+        }
+        if (work->out_map == NULL
+            && !dehuff_pwrite(work->out_fd, worker->out, block->length, block->out_offset)) {
+            worker->error = HUFF_IO_ERROR;
+            atomic_store(&work->failed, true);
+            break;
+        }
+        if (work->out_map == NULL) {
+            dehuff_lap(worker->stats, &mark, HUFF_STAGE_WRITE, i);
+        }
+        worker->own_stats.input_bytes += BLOCK_HEADER_SIZE + (uint64_t) block->compressed_length;
+        worker->own_stats.output_bytes += block->length;
+        worker->own_stats.blocks += 1;
+    }
+}
+
+// function that clears the context's statistics and errors for a new call
+static void dehuff_stats_begin(HuffDCtx *ctx) {
+    memset(&ctx->stats, 0, sizeof(ctx->stats));
+    ctx->error = HUFF_OK;
+    for (unsigned t = 0; t < ctx->threads; ++t) {
+        ctx->workers[t].error = HUFF_OK;
+        memset(&ctx->workers[t].own_stats, 0, sizeof(HuffStats));
+        ctx->workers[t].stats = ctx->timing ? &ctx->workers[t].own_stats : NULL;
+    }
+}
+
+// function that adds up what the threads did in a call, and keeps the
+// first thread's reason for failing
+static void dehuff_stats_end(HuffDCtx *ctx) {
+    HuffStats *stats = &ctx->stats;
+    for (unsigned t = 0; t < ctx->threads; ++t) {
+        if (ctx->error == HUFF_OK) {
+            ctx->error = ctx->workers[t].error;
+        }
+        const HuffStats *own = &ctx->workers[t].own_stats;
+        stats->input_bytes += own->input_bytes;
+        stats->output_bytes += own->output_bytes;
+        stats->blocks += own->blocks;
+        stats->max_leaves = own->max_leaves > stats->max_leaves ? own->max_leaves : stats->max_leaves;
+        stats->max_depth = own->max_depth > stats->max_depth ? own->max_depth : stats->max_depth;
+        if (own->max_code_length > stats->max_code_length) {
+            stats->max_code_length = own->max_code_length;
+        }
+        for (int s = 0; s < HUFF_NUM_STAGES; ++s) {
+            stats->wall_ns[s] += own->wall_ns[s];
+            stats->cpu_ns[s] += own->cpu_ns[s];
+        }
+    }
+}
+
+// function that decodes every block of work on the context's threads and
+// returns false if any of them failed
+static bool dehuff_run(HuffDCtx *ctx, DehuffBlocks *work) {
+    dehuff_stats_begin(ctx);
+    for (unsigned t = 0; t < ctx->threads; ++t) {
+        ctx->workers[t].work = work;
+    }
+    if (ctx->pool != NULL && work->count > 1) {
+        for (unsigned t = 0; t < ctx->threads; ++t) {
+            pool_submit(ctx->pool, &ctx->workers[t].job, dehuff_decode_blocks, &ctx->workers[t]);
+        }
+        for (unsigned t = 0; t < ctx->threads; ++t) {
+            pool_wait_job(ctx->pool, &ctx->workers[t].job);
+        }
+    } else {
+        // without a pool this thread decodes every block itself
+        dehuff_decode_blocks(&ctx->workers[0]);
+    }
+    dehuff_stats_end(ctx);
+    return !atomic_load(&work->failed);
+}
+
+// function that makes room for count blocks in the context
+static bool dehuff_reserve_blocks(HuffDCtx *ctx, uint64_t count) {
+    if (count <= ctx->capacity) {
+        return true;
+    }
+    uint64_t capacity = ctx->capacity ? ctx->capacity : 64;
+    while (capacity < count) {
+        capacity *= 2;
+    }
+    DehuffBlock *blocks = (DehuffBlock *) realloc(ctx->blocks, capacity * sizeof(DehuffBlock));
+    if (blocks == NULL) {
+        return false;
+    }
+    ctx->blocks = blocks;
+    ctx->capacity = capacity;
+    return true;
+}
+
+// function that decodes a block container file using its block index, on
+// the context's threads when there is more than one.  Regular files are mapped so blocks
+// decode straight from the input pages into the output pages.  It returns
+// HUFF_INDEXED_UNUSABLE, having written nothing, when the input has no index
+// or the output cannot be written at an offset, so the caller can decode the
+// file as a stream instead.  An index whose blocks do not follow one another
+// or whose lengths are out of range gives HUFF_INDEXED_FAILED before anything
+// is written, and so does a block that does not decode.
+HuffIndexed huff_decompress_indexed(HuffDCtx *ctx, FILE *fout, const char *finame) {
+    ctx->error = HUFF_OK;
+    FILE *fin = fopen(finame, "r");
+    if (fin == NULL) {
+        return HUFF_INDEXED_UNUSABLE;
+    }
+    MappedFile *in_map = map_open_read(finame);
+    MappedFile *out_map = NULL;
+    DehuffBlocks work = { .in_fd = fileno(fin), .out_fd = fileno(fout) };
+    struct stat st;
+    if (in_map != NULL) {
+        work.in_map = map_data(in_map);
+        work.in_size = map_size(in_map);
+    } else if (fstat(work.in_fd, &st) == 0) {
+        work.in_size = (uint64_t) st.st_size;
+    }
+    uint8_t header[BLOCK_FILE_HEADER_SIZE];
+    BlockIndex *index = NULL;
+    // the output must start at offset 0 of a file that can be written anywhere
+    bool usable = lseek(work.out_fd, 0, SEEK_CUR) == 0
+                  && dehuff_read_at(&work, header, sizeof(header), 0) && header[0] == 'H'
+                  && header[1] == 'F'
+                  && block_version_known(header[2])
+                  && (index = block_index_read(fin)) != NULL;
+    if (usable) {
+        work.version = header[2];
+        work.count = block_index_count(index);
+        usable = dehuff_reserve_blocks(ctx, work.count);
+        work.blocks = ctx->blocks;
+    }
+    // the block headers give every block's place in the output, and each
+    // block must start where the one before it ends
+    bool ok = usable;
+    uint64_t offset = BLOCK_FILE_HEADER_SIZE;
+    uint64_t out_offset = 0;
+    for (uint64_t i = 0; ok && i < work.count; ++i) {
+        DehuffBlock *block = &work.blocks[i];
+        uint8_t field[BLOCK_HEADER_SIZE];
+        block->offset = block_index_offset(index, i);
+        ok = block->offset == offset && dehuff_read_at(&work, field, sizeof(field), offset);
+        block->length = dehuff_get_uint32(field);
+        block->compressed_length = dehuff_get_uint32(field + 4);
+        block->out_offset = out_offset;
+        out_offset += block->length;
+        // the lengths bound what the output takes, and the whole block must be in the input
+        ok = ok && block->length > 0 && block->length <= BLOCK_MAX_SIZE
+             && block->compressed_length <= block_read_bound(block->length)
+             && block->compressed_length <= work.in_size - offset - BLOCK_HEADER_SIZE;
+        offset += BLOCK_HEADER_SIZE + (uint64_t) block->compressed_length;
+    }
+    // the end marker and the index follow the last block
+    ok = ok && out_offset == block_index_total(index)
+         && offset + 4 + 8 * work.count + BLOCK_TRAILER_SIZE == work.in_size;
+    HuffIndexed result = usable ? HUFF_INDEXED_FAILED : HUFF_INDEXED_UNUSABLE;
+    if (usable && !ok) {
+        ctx->error = HUFF_DATA_ERROR;
+    }
+    if (ok) {
+        // decoding straight into the output file's pages when it can be mapped
+        out_map = map_open_write(work.out_fd, out_offset);
+        work.out_map = out_map != NULL ? map_data(out_map) : NULL;
+        result = dehuff_run(ctx, &work) ? HUFF_INDEXED_DONE : HUFF_INDEXED_FAILED;
+        ctx->stats.input_bytes = work.in_size;
+    }
+    map_close(&out_map);
+    map_close(&in_map);
+    block_index_free(&index);
+    fclose(fin);
+    return result;
+}
+
+// function to perform Huffman decoding and write the decompressed data to the
+// output file; it reads every format as a stream, one block at a time
+bool huff_decompress_file(HuffDCtx *ctx, FILE *fout, BitReader *inbuf) {
+    dehuff_stats_begin(ctx);
+    HuffStats *stats = ctx->timing ? &ctx->stats : NULL;
+    TimerMark mark = { 0, 0 };
+    if (stats != NULL) {
+        mark = timer_mark();
+    }
+    // using the bit read functions to read header information
+    uint8_t type1 = bit_read_uint8(inbuf);
+    uint8_t type2 = bit_read_uint8(inbuf);
+    uint8_t version = type1 == 'H' && type2 == 'F' ? bit_read_uint8(inbuf) : 0;
+    uint32_t filesize;
+    DecodeTable *table;
+    if (type1 == 'H' && type2 == 'C') {
+        // legacy format: file size, then the tree
+        filesize = bit_read_uint32(inbuf);
+        table = dehuff_read_tree(inbuf);
+    } else if (version == 2) {
+        // format version 2: file size, then the canonical code lengths
+        filesize = bit_read_uint32(inbuf);
+        table = dehuff_read_lengths(inbuf);
+    } else if (block_version_known(version)) {
+        // the block formats (see block_version_known): independent blocks
+        bool ok = dehuff_decompress_blocks(&ctx->workers[0], fout, inbuf, version);
+        dehuff_stats_end(ctx);
+        return ok;
+    } else {
+        ctx->error = HUFF_FORMAT_ERROR;
+        return false;
+    }
+    if (table == NULL) {
+        ctx->error = HUFF_DATA_ERROR;
+        return false;
+    }
+    dehuff_lap(stats, &mark, HUFF_STAGE_TABLE, 0);
+    dehuff_decode_symbols(fout, inbuf, table, filesize);
+    dehuff_lap(stats, &mark, HUFF_STAGE_DECODE, 0);
+    ctx->stats.output_bytes = filesize;
+    ctx->stats.blocks = 1;
+    // freeing the decode table
+    dt_free(&table);
+    return true;
+}
+
+// function that creates a decompression context with that many threads
+// (0 means one per online core)
+HuffDCtx *huff_dctx_create(unsigned threads) {
+    if (threads > POOL_MAX_THREADS) {
+        return NULL;
+    }
+    HuffDCtx *ctx = (HuffDCtx *) calloc(1, sizeof(HuffDCtx));
+    if (ctx == NULL) {
+        return NULL;
+    }
+    ctx->threads = threads != 0 ? threads : pool_online_cores();
+    ctx->workers = (DehuffWorker *) calloc(ctx->threads, sizeof(DehuffWorker));
+    ctx->pool = ctx->threads > 1 ? pool_create(ctx->threads) : NULL;
+    bool ok = ctx->workers != NULL && (ctx->threads == 1 || ctx->pool != NULL);
+    for (unsigned t = 0; ok && t < ctx->threads; ++t) {
+        ctx->workers[t].arena = arena_create(DEHUFF_ARENA_SIZE);
+        ctx->workers[t].tables = ctx->tables;
+        // the chunk is taken now, a thread that gets no block in the first
+        // calls would otherwise take it in a later one
+        ok = ctx->workers[t].arena != NULL && arena_alloc(ctx->workers[t].arena, 1) != NULL;
+    }
+    if (!ok) {
+        huff_dctx_free(&ctx);
+    }
+    return ctx;
+}
+
+// function that frees the decompression context and stops its threads
+void huff_dctx_free(HuffDCtx **ctx) {
+    if (*ctx != NULL) {
+        pool_free(&(*ctx)->pool);
+        for (unsigned t = 0; (*ctx)->workers != NULL && t < (*ctx)->threads; ++t) {
+            free((*ctx)->workers[t].in);
+            free((*ctx)->workers[t].out);
+            arena_free(&(*ctx)->workers[t].arena);
+        }
+        free((*ctx)->workers);
+        free((*ctx)->blocks);
+        free(*ctx);
+        *ctx = NULL;
+    }
+}
+
+// function that turns the stage timing of the context's calls on or off
+void huff_dctx_set_timing(HuffDCtx *ctx, bool timing) {
+    ctx->timing = timing;
+}
+
+// function that lets the context decode blocks coded with a trained table,
+// which must outlive the context; it returns false for a built-in table's ID
+bool huff_dctx_add_table(HuffDCtx *ctx, const HuffTable *table) {
+    if (table->id < HUFF_TABLE_FIRST_TRAINED) {
+        return false;
+    }
+    ctx->tables[table->id] = table;
+    return true;
+}
+
+// function that returns what the context's last call did
+const HuffStats *huff_dctx_stats(const HuffDCtx *ctx) {
+    return &ctx->stats;
+}
+
+// function that returns why the context's last call failed, HUFF_OK if it did not
+HuffStatus huff_dctx_error(const HuffDCtx *ctx) {
+    return ctx->error;
+}
+
+// function that returns whether the block index at src + offset gives the
+// offset of each of the count blocks that follow the file header
+static bool dehuff_check_index(const uint8_t *src, size_t offset, uint64_t count) {
+    size_t at = BLOCK_FILE_HEADER_SIZE;
+    for (uint64_t i = 0; i < count; ++i) {
+        if (dehuff_get_uint64(src + offset + 8 * i) != at) {
+            return false;
+        }
+        at += BLOCK_HEADER_SIZE + (size_t) dehuff_get_uint32(src + at + 4);
+    }
+    return true;
+}
+
+// function that walks the block headers of a block container in memory,
+// recording the blocks in the context when ctx is not NULL, and returns the
+// decoded size, or HUFF_ERROR when a block runs past the end of the input,
+// its lengths are out of range or the block index at the end does not match
+// the blocks
+static size_t dehuff_scan_blocks(HuffDCtx *ctx, const uint8_t *src, size_t n, uint64_t *count) {
+    size_t offset = BLOCK_FILE_HEADER_SIZE;
+    size_t total = 0;
+    *count = 0;
+    while (true) {
+        if (n - offset < 4) {
+            return HUFF_ERROR;
+        }
+        uint32_t length = dehuff_get_uint32(src + offset);
+        if (length == 0) {
+            // the index must fill the rest of the input exactly
+            const uint8_t *trailer = src + n - BLOCK_TRAILER_SIZE;
+            bool ok = n - offset - 4 == 8 * *count + BLOCK_TRAILER_SIZE
+                      && dehuff_get_uint64(trailer) == total
+                      && dehuff_get_uint64(trailer + 8) == *count
+                      && memcmp(trailer + 16, "HFIX", 4) == 0
+                      && dehuff_check_index(src, offset + 4, *count);
+            return ok ? total : HUFF_ERROR;
+        }
+        if (n - offset < BLOCK_HEADER_SIZE) {
+            return HUFF_ERROR;
+        }
+        uint32_t compressed_length = dehuff_get_uint32(src + offset + 4);
+        if (length > BLOCK_MAX_SIZE || compressed_length > block_read_bound(length)
+            || compressed_length > n - offset - BLOCK_HEADER_SIZE) {
+            return HUFF_ERROR;
+        }
+        if (ctx != NULL) {
+            if (!dehuff_reserve_blocks(ctx, *count + 1)) {
+                return HUFF_ERROR;
+            }
+            DehuffBlock *block = &ctx->blocks[*count];
+            block->offset = offset;
+            block->compressed_length = compressed_length;
+            block->out_offset = total;
+            block->length = length;
+        }
+        *count += 1;
+        total += length;
+        offset += BLOCK_HEADER_SIZE + (size_t) compressed_length;
+    }
+}
+
+// function that returns the size the n compressed bytes at src decode to,
+// or HUFF_ERROR when they are not a complete compressed file
+size_t huff_decompressed_size(const uint8_t *src, size_t n) {
+    if (n >= 6 && src[0] == 'H' && src[1] == 'C') {
+        // the legacy format: the file size follows the header
+        return dehuff_get_uint32(src + 2);
+    }
+    if (n >= 7 && src[0] == 'H' && src[1] == 'F' && src[2] == 2) {
+        // format version 2: the same after the version
+        return dehuff_get_uint32(src + 3);
+    }
+    if (n >= BLOCK_FILE_HEADER_SIZE && src[0] == 'H' && src[1] == 'F'
+        && block_version_known(src[2])) {
+        uint64_t count;
+        return dehuff_scan_blocks(NULL, src, n, &count);
+    }
+    return HUFF_ERROR;
+}
+
+// function that decompresses the n bytes at src into the cap bytes at dst and
+// returns the decompressed size, or HUFF_ERROR when the input is not valid
+// or dst is too small; the blocks of a block container are decoded on the
+// context's threads, straight from src into dst
+size_t huff_decompress_ctx(HuffDCtx *ctx, const uint8_t *src, size_t n, uint8_t *dst, size_t cap) {
+    size_t size = huff_decompressed_size(src, n);
+    if (size == HUFF_ERROR || size > cap) {
+        return HUFF_ERROR;
+    }
+    if (src[1] == 'C' || src[2] == 2) {
+        // formats with one code are decoded as one stream, the tables come from the heap
+        dehuff_stats_begin(ctx);
+        HuffStats *stats = ctx->timing ? &ctx->stats : NULL;
+        TimerMark mark = { 0, 0 };
+        if (stats != NULL) {
+            mark = timer_mark();
+        }
+        DehuffWorker *worker = &ctx->workers[0];
+        arena_reset(worker->arena);
+        BitReader *inbuf = bit_read_open_arena(worker->arena, src, n);
+        if (inbuf == NULL) {
+            return HUFF_ERROR;
+        }
+        // skipping the header and the file size
+        bit_read_bits(inbuf, src[1] == 'C' ? 48 : 56);
+        DecodeTable *table = src[1] == 'C' ? dehuff_read_tree(inbuf) : dehuff_read_lengths(inbuf);
+        bool ok = table != NULL;
+        dehuff_lap(stats, &mark, HUFF_STAGE_TABLE, 0);
+        if (ok) {
+            dt_decode(table, inbuf, dst, size);
+            dehuff_lap(stats, &mark, HUFF_STAGE_DECODE, 0);
+        }
+        ctx->stats.input_bytes = n;
+        ctx->stats.output_bytes = ok ? size : 0;
+        ctx->stats.blocks = 1;
+        dt_free(&table);
+        bit_read_close(&inbuf);
+        return ok ? size : HUFF_ERROR;
+    }
+    DehuffBlocks work = { .in_fd = -1, .out_fd = -1, .in_map = src, .out_map = dst, .in_size = n };
+    work.version = src[2];
+    dehuff_scan_blocks(ctx, src, n, &work.count);
+    work.blocks = ctx->blocks;
+    bool ok = dehuff_run(ctx, &work);
+    ctx->stats.input_bytes = n;
+    return ok ? size : HUFF_ERROR;
+}
+
+// function that decompresses with a single-threaded context of its own
+size_t huff_decompress_buffer(const uint8_t *src, size_t n, uint8_t *dst, size_t cap) {
+    HuffDCtx *ctx = huff_dctx_create(1);
+    if (ctx == NULL) {
+        return HUFF_ERROR;
+    }
+    size_t size = huff_decompress_ctx(ctx, src, n, dst, cap);
+    huff_dctx_free(&ctx);
+    return size;
+}
+
+// where a streaming decoder is in the block container
+typedef enum DehuffState {
+    DEHUFF_FILE_HEADER,
+    DEHUFF_BLOCK_HEADER,
+    DEHUFF_PAYLOAD,
+    DEHUFF_INDEX,
+    DEHUFF_TRAILER,
+    DEHUFF_DONE,
+    DEHUFF_ERROR
+} DehuffState;
+
+struct HuffStreamDecoder {
+    DehuffState state;
+    // the fixed-size fields being read, and how many of their bytes are in
+    uint8_t field[BLOCK_TRAILER_SIZE];
+    size_t have;
+    // one of the versions of the block container
+    uint8_t version;
+    // the current block
+    uint32_t length;
+    uint32_t compressed_length;
+    // a block that arrives in pieces is collected here, grown to the largest block
+    uint8_t *in;
+    size_t in_size;
+    size_t in_have;
+    // a block that does not fit in the caller's output is decoded here
+    uint8_t *out;
+    size_t out_size;
+    const uint8_t *pending;
+    size_t pending_length;
+    // the reader and decode table of the current block
+    Arena *arena;
+    // where each block started, checked against the index at the end
+    BlockIndex *index;
+    uint64_t offset;
+    uint64_t next_block;
+};
+
+// function that sets up strm to decompress a block container
+bool huff_stream_decompress_init(HuffStream *strm) {
+    HuffStreamDecoder *dec = (HuffStreamDecoder *) calloc(1, sizeof(HuffStreamDecoder));
+    if (dec == NULL) {
+        return false;
+    }
+    dec->state = DEHUFF_FILE_HEADER;
+    dec->arena = arena_create(DEHUFF_ARENA_SIZE);
+    dec->index = block_index_create();
+    strm->total_in = 0;
+    strm->total_out = 0;
+    strm->encoder = NULL;
+    strm->decoder = dec;
+    if (dec->arena == NULL || dec->index == NULL) {
+        huff_stream_decompress_end(strm);
+        return false;
+    }
+    return true;
+}
+
+// function that frees what huff_stream_decompress_init() set up
+void huff_stream_decompress_end(HuffStream *strm) {
+    HuffStreamDecoder *dec = strm->decoder;
+    if (dec != NULL) {
+        free(dec->in);
+        free(dec->out);
+        arena_free(&dec->arena);
+        block_index_free(&dec->index);
+        free(dec);
+        strm->decoder = NULL;
+    }
+}
+
+// function that moves as much pending output as fits into the caller's buffer
+static void dehuff_stream_deliver(HuffStream *strm, HuffStreamDecoder *dec) {
+    size_t n = dec->pending_length < strm->avail_out ? dec->pending_length : strm->avail_out;
+    if (n == 0) {
+        return;
+    }
+    memcpy(strm->next_out, dec->pending, n);
+    strm->next_out += n;
+    strm->avail_out -= n;
+    strm->total_out += n;
+    dec->pending += n;
+    dec->pending_length -= n;
+}
+
+// function that moves n input bytes on
+static void dehuff_stream_skip(HuffStream *strm, HuffStreamDecoder *dec, size_t n) {
+    strm->next_in += n;
+    strm->avail_in -= n;
+    strm->total_in += n;
+    dec->offset += n;
+}
+
+// function that collects input into the field until it holds need bytes and
+// returns whether it does
+static bool dehuff_stream_field(HuffStream *strm, HuffStreamDecoder *dec, size_t need) {
+    size_t n = need - dec->have < strm->avail_in ? need - dec->have : strm->avail_in;
+    if (n > 0) {
+        memcpy(dec->field + dec->have, strm->next_in, n);
+        dec->have += n;
+        dehuff_stream_skip(strm, dec, n);
+    }
+    return dec->have == need;
+}
+
+// function that decodes the current block from in, straight into the
+// caller's output when it fits there
+static HuffStatus dehuff_stream_block(HuffStream *strm, HuffStreamDecoder *dec, const uint8_t *in) {
+    uint8_t *dst = strm->next_out;
+    if (strm->avail_out < dec->length) {
+        if (!dehuff_reserve(&dec->out, &dec->out_size, dec->length)) {
+            return HUFF_MEM_ERROR;
+        }
+        dst = dec->out;
+    }
+    HuffStatus status = dehuff_decode_block(
+        dec->arena, NULL, 0, NULL, in, dec->compressed_length, dst, dec->length, dec->version);
+    if (status != HUFF_OK) {
+        return status;
+    }
+    if (dst == strm->next_out) {
+        strm->next_out += dec->length;
+        strm->avail_out -= dec->length;
+        strm->total_out += dec->length;
+    } else {
+        dec->pending = dec->out;
+        dec->pending_length = dec->length;
+    }
+    dec->in_have = 0;
+    dec->have = 0;
+    dec->state = DEHUFF_BLOCK_HEADER;
+    return HUFF_OK;
+}
+
+// function that reads the next step of the container, with a state of DEHUFF_ERROR
+// meaning the input is not valid
+static HuffStatus dehuff_stream_step(HuffStream *strm, HuffStreamDecoder *dec) {
+    switch (dec->state) {
+    case DEHUFF_FILE_HEADER:
+        // 'H' 'F', the version and the block size, which is only a hint
+        if (dehuff_stream_field(strm, dec, BLOCK_FILE_HEADER_SIZE)) {
+            dec->version = dec->field[2];
+            bool ok = dec->field[0] == 'H' && dec->field[1] == 'F'
+                      && block_version_known(dec->version);
+            dec->state = ok ? DEHUFF_BLOCK_HEADER : DEHUFF_ERROR;
+            dec->have = 0;
+        }
+        return HUFF_OK;
+    case DEHUFF_BLOCK_HEADER:
+        // the length comes first, the end marker has no compressed length
+        if (dec->have < 4 && !dehuff_stream_field(strm, dec, 4)) {
+            return HUFF_OK;
+        }
+        dec->length = dehuff_get_uint32(dec->field);
+        if (dec->length == 0) {
+            dec->state = DEHUFF_INDEX;
+            dec->have = 0;
+            return HUFF_OK;
+        }
+        if (!dehuff_stream_field(strm, dec, BLOCK_HEADER_SIZE)) {
+            return HUFF_OK;
+        }
+        dec->compressed_length = dehuff_get_uint32(dec->field + 4);
+        // the lengths bound what the buffers must hold
+        if (dec->length > BLOCK_MAX_SIZE || dec->compressed_length > block_read_bound(dec->length)
+            || !block_index_append(dec->index, dec->offset - BLOCK_HEADER_SIZE, dec->length)) {
+            dec->state = DEHUFF_ERROR;
+            return HUFF_OK;
+        }
+        dec->state = DEHUFF_PAYLOAD;
+        return HUFF_OK;
+    case DEHUFF_PAYLOAD:
+        if (dec->in_have == 0 && strm->avail_in >= dec->compressed_length) {
+            // a whole block in the caller's input is decoded where it is
+            const uint8_t *in = strm->next_in;
+            dehuff_stream_skip(strm, dec, dec->compressed_length);
+            return dehuff_stream_block(strm, dec, in);
+        }
+        if (!dehuff_reserve(&dec->in, &dec->in_size, dec->compressed_length)) {
+            return HUFF_MEM_ERROR;
+        }
+        size_t n = dec->compressed_length - dec->in_have;
+        n = strm->avail_in < n ? strm->avail_in : n;
+        if (n == 0) {
+            return HUFF_OK;
+        }
+        memcpy(dec->in + dec->in_have, strm->next_in, n);
+        dec->in_have += n;
+        dehuff_stream_skip(strm, dec, n);
+        if (dec->in_have == dec->compressed_length) {
+            return dehuff_stream_block(strm, dec, dec->in);
+        }
+        return HUFF_OK;
+    case DEHUFF_INDEX:
+        // each offset must be where that block started
+        if (dec->next_block == block_index_count(dec->index)) {
+            dec->state = DEHUFF_TRAILER;
+        } else if (dehuff_stream_field(strm, dec, 8)) {
+            bool ok = dehuff_get_uint64(dec->field)
+                      == block_index_offset(dec->index, dec->next_block++);
+            dec->state = ok ? DEHUFF_INDEX : DEHUFF_ERROR;
+            dec->have = 0;
+        }
+        return HUFF_OK;
+    case DEHUFF_TRAILER:
+        if (dehuff_stream_field(strm, dec, BLOCK_TRAILER_SIZE)) {
+            bool ok = dehuff_get_uint64(dec->field) == block_index_total(dec->index)
+                      && dehuff_get_uint64(dec->field + 8) == block_index_count(dec->index)
+                      && memcmp(dec->field + 16, "HFIX", 4) == 0;
+            dec->state = ok ? DEHUFF_DONE : DEHUFF_ERROR;
+        }
+        return HUFF_OK;
+    default: return HUFF_OK;
+    }
+}
+
+// function that decompresses from strm->next_in to strm->next_out until the
+// input runs out or the output is full.  The block container (format 'H' 'F'
+// 3 to 5) can be split anywhere; older formats are not streamed.  It returns
+// HUFF_STREAM_END once the index at the end has been read and checked, and
+// leaves any input after it unread.
+HuffStatus huff_stream_decompress(HuffStream *strm) {
+    HuffStreamDecoder *dec = strm->decoder;
+    while (true) {
+        // output that is ready goes first; nothing else happens until it is out
+        dehuff_stream_deliver(strm, dec);
+        if (dec->pending_length > 0) {
+            return HUFF_OK;
+        }
+        if (dec->state == DEHUFF_DONE) {
+            return HUFF_STREAM_END;
+        }
+        uint64_t before = strm->total_in;
+        DehuffState state = dec->state;
+        HuffStatus status = dehuff_stream_step(strm, dec);
+        if (status != HUFF_OK) {
+            return status;
+        }
+        if (dec->state == DEHUFF_ERROR) {
+            return HUFF_DATA_ERROR;
+        }
+        // no input was taken and nothing changed: more input is needed
+        if (strm->total_in == before && dec->state == state && dec->pending_length == 0) {
+            return HUFF_OK;
+        }
+    }
+}
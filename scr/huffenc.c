@@ -0,0 +1,994 @@
+#include "libhuff.h"
+
+#include "arena.h"
+#include "bitio_ext.h"
+#include "bitwriter.h"
+#include "block.h"
+#include "canon.h"
+#include "histogram.h"
+#include "pool.h"
+#include "timer.h"
+#include "trace.h"
+#include "tree.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct Code {
+    uint64_t code;
+    uint8_t code_length;
+} Code;
+
+// function that fills the histogram of a block of data
+static void fill_histogram(const uint8_t *data, uint32_t n, uint32_t *histogram) {
+    // counting every byte of the block
+    uint64_t counts[256] = { 0 };
+    histogram_count(data, n, counts);
+    // a block has fewer than 2^32 bytes, so its counts fit in 32 bits
+    for (int i = 0; i < 256; ++i) {
+        histogram[i] = (uint32_t) counts[i];
+    }
+}
+
+// function that fills the code table from the tree, symbols that do not
+// occur get a code length of 0
+static void fill_code_table(Code *code_table, const FlatTree *tree) {
+    uint64_t codes[256];
+    uint8_t code_lengths[256];
+    tree_flat_codes(tree, codes, code_lengths);
+    for (int i = 0; i < 256; ++i) {
+        code_table[i].code = codes[i];
+        code_table[i].code_length = code_lengths[i];
+    }
+}
+
+// function that limits the code lengths to max_length bits (keeping the optimal
+// lengths when they already fit) and returns the number of bits the codes take;
+// widened is set when there are too many symbols for max_length bits and the
+// lengths are limited to CANON_MAX_LENGTH instead.  The limiting works in arena.
+static uint64_t huff_limit_lengths(Arena *arena, uint32_t *histogram, Code *code_table,
+    uint8_t max_length, uint8_t *code_lengths, bool *widened) {
+    uint8_t longest = 0;
+    for (int i = 0; i < 256; ++i) {
+        code_lengths[i] = code_table[i].code_length;
+        if (code_lengths[i] > longest) {
+            longest = code_lengths[i];
+        }
+    }
+    // package-merge is only needed when the optimal tree is too deep
+    *widened = longest > max_length
+               && !canon_limit_lengths_arena(arena, histogram, max_length, code_lengths);
+    if (*widened) {
+        // too many symbols for max_length, fall back to what the header can hold
+        canon_limit_lengths_arena(arena, histogram, CANON_MAX_LENGTH, code_lengths);
+    }
+    uint64_t bits = 0;
+    for (int i = 0; i < 256; ++i) {
+        bits += (uint64_t) histogram[i] * code_lengths[i];
+    }
+    return bits;
+}
+
+// function that turns the code table into canonical codes for the given code lengths
+static void huff_make_canonical(Code *code_table, const uint8_t *code_lengths) {
+    uint64_t codes[256];
+    canon_assign(code_lengths, codes);
+    for (int i = 0; i < 256; ++i) {
+        code_table[i].code = codes[i];
+        code_table[i].code_length = code_lengths[i];
+    }
+}
+
+// one block of input and, once a worker has encoded it, its compressed bytes
+typedef struct HuffBlock {
+    // the input bytes of the block, in buffer or in the caller's memory
+    const uint8_t *data;
+    uint32_t length;
+    // the slot's own copy of the input when it is read from a file
+    uint8_t *buffer;
+    uint8_t max_length;
+    // the number of sub-streams the codes are split into
+    uint8_t num_streams;
+    // the table to code the block with (NULL for its own code), whether to
+    // look for a cheaper built-in table, and the ID of the table it was
+    // coded with, 0 for its own code
+    const HuffTable *table;
+    bool choose_table;
+    uint8_t table_id;
+    // whether the block is coded, or stored or written as a run because
+    // coding would not make it smaller
+    BlockKind kind;
+    // the block header, code lengths and codes, BLOCK_HEADER_SIZE + compressed_length bytes
+    uint8_t *out;
+    uint32_t compressed_length;
+    // what the codes of this block cost before and after the length limit
+    uint64_t optimal_bits;
+    uint64_t limited_bits;
+    // the block's byte counts and the shape of its code, see HuffStats
+    uint32_t histogram[256];
+    uint16_t leaves;
+    uint8_t depth;
+    uint8_t code_length;
+    // whether max_length was too short for the block's symbols
+    bool widened;
+    // the block's place in the input, which names it in a trace
+    uint64_t number;
+    // whether to time (and trace) the stages, and how long they took
+    bool timing;
+    uint64_t wall_ns[HUFF_NUM_STAGES];
+    uint64_t cpu_ns[HUFF_NUM_STAGES];
+    // out and the writer live here; reset for every block, it stops growing
+    // once it holds the largest block, so steady-state encoding does not malloc
+    Arena *arena;
+    // a place for out chosen by the caller, used when the block fits there
+    uint8_t *dst;
+    size_t dst_capacity;
+    // the pool's handle for the encoding job
+    PoolJob job;
+} HuffBlock;
+
+// function that adds the time since mark to a stage of the block when it is
+// timed, and records the stage in the trace when one is being recorded
+static void huff_lap(HuffBlock *block, TimerMark *mark, HuffStage stage) {
+    if (block->timing) {
+        uint64_t start_ns = mark->wall_ns;
+        timer_lap(mark, &block->wall_ns[stage], &block->cpu_ns[stage]);
+        trace_span(huff_stage_name(stage), block->number, start_ns, mark->wall_ns);
+    }
+}
+
+// function that counts the block's bytes and returns how many byte values occur
+static int huff_count(HuffBlock *block, TimerMark *mark) {
+    fill_histogram(block->data, block->length, block->histogram);
+    int symbols = 0;
+    for (int i = 0; i < 256; ++i) {
+        symbols += block->histogram[i] != 0;
+    }
+    huff_lap(block, mark, HUFF_STAGE_HISTOGRAM);
+    return symbols;
+}
+
+// function that tells whether the block is one byte value repeated; it stops
+// at the first byte that differs, so it costs next to nothing on other data
+static bool huff_is_run(HuffBlock *block) {
+    const uint8_t *data = block->data;
+    for (uint32_t i = 1; i < block->length; ++i) {
+        if (data[i] != data[0]) {
+            return false;
+        }
+    }
+    // the histogram a count would give, for the statistics
+    memset(block->histogram, 0, sizeof(block->histogram));
+    block->histogram[data[0]] = block->length;
+    return true;
+}
+
+// function that returns the bits the codes of the block's bytes take with code_lengths
+static uint64_t huff_code_bits(const HuffBlock *block, const uint8_t *code_lengths) {
+    uint64_t bits = 0;
+    for (int i = 0; i < 256; ++i) {
+        bits += (uint64_t) block->histogram[i] * code_lengths[i];
+    }
+    return bits;
+}
+
+// function that gives the block a code of its own from its histogram, in
+// which at least 2 byte values occur: it builds the tree and limits its
+// code lengths
+static void huff_build_code(
+    HuffBlock *block, TimerMark *mark, Code *code_table, uint8_t *code_lengths) {
+    uint32_t *histogram = block->histogram;
+    // creating the tree as a flat array on the stack, no node is allocated on the heap
+    FlatTree code_tree;
+    block->leaves = tree_build_flat(histogram, &code_tree);
+    huff_lap(block, mark, HUFF_STAGE_TREE);
+    // filling the table
+    fill_code_table(code_table, &code_tree);
+    // the optimal tree's cost, before any length limit
+    block->optimal_bits = 0;
+    block->depth = 0;
+    for (int i = 0; i < 256; ++i) {
+        block->optimal_bits += (uint64_t) histogram[i] * code_table[i].code_length;
+        if (code_table[i].code_length > block->depth) {
+            block->depth = code_table[i].code_length;
+        }
+    }
+    huff_lap(block, mark, HUFF_STAGE_CODES);
+    // limiting the code lengths, at most to what the header can hold; the
+    // scratch space goes when the arena is reset for the output
+    block->limited_bits = huff_limit_lengths(
+        block->arena, histogram, code_table, block->max_length, code_lengths, &block->widened);
+    huff_lap(block, mark, HUFF_STAGE_TREE);
+    // switching to canonical codes
+    huff_make_canonical(code_table, code_lengths);
+    huff_lap(block, mark, HUFF_STAGE_CODES);
+}
+
+// function that returns the built-in table that codes the block, whose bytes
+// it has counted, in fewer bits than its own code_lengths do (with their
+// header), or NULL when none does; the cost of a code is a sum over the
+// histogram, so every table is tried
+static const HuffTable *huff_choose_table(const HuffBlock *block, const uint8_t *code_lengths) {
+    // the block's own code: its code lengths padded to a byte, then the codes
+    uint64_t best = 8 * (uint64_t) ((canon_write_lengths(NULL, code_lengths) + 7) / 8)
+                    + huff_code_bits(block, code_lengths);
+    const HuffTable *chosen = NULL;
+    const HuffTable *table;
+    for (uint8_t id = 1; (table = huff_table_builtin(id)) != NULL; ++id) {
+        uint64_t bits = 8 * (uint64_t) BLOCK_PRESET_SIZE;
+        for (int i = 0; i < 256 && bits < best; ++i) {
+            bits += (uint64_t) block->histogram[i] * table->code_lengths[i];
+        }
+        if (bits < best) {
+            best = bits;
+            chosen = table;
+        }
+    }
+    return chosen;
+}
+
+// function that codes the block with a preset table
+static void huff_use_table(
+    HuffBlock *block, const HuffTable *table, Code *code_table, uint8_t *code_lengths) {
+    memcpy(code_lengths, table->code_lengths, 256);
+    for (int i = 0; i < 256; ++i) {
+        code_table[i].code = table->codes[i];
+        code_table[i].code_length = table->code_lengths[i];
+    }
+    block->table_id = table->id;
+}
+
+// function that works out the size of every sub-stream of the block with
+// code_table, and returns the bytes everything after the block header takes
+// when the code takes header_bytes in front of the sub-stream table
+static uint64_t huff_size_streams(
+    HuffBlock *block, const Code *code_table, uint64_t header_bytes, uint32_t *stream_bytes) {
+    const uint8_t *data = block->data;
+    uint8_t num_streams = block->num_streams;
+    uint64_t compressed_bytes = header_bytes + 1 + 4 * (uint64_t) (num_streams - 1);
+    uint64_t bits = 0;
+    uint32_t start = 0;
+    for (uint8_t s = 0; s < num_streams; ++s) {
+        uint32_t end = start + block_stream_length(block->length, num_streams, s);
+        uint64_t stream_bits = 0;
+        for (uint32_t i = start; i < end; ++i) {
+            stream_bits += code_table[data[i]].code_length;
+        }
+        stream_bytes[s] = (uint32_t) ((stream_bits + 7) / 8);
+        compressed_bytes += stream_bytes[s];
+        bits += stream_bits;
+        start = end;
+    }
+    if (block->table_id != 0) {
+        // what the table costs, for the statistics
+        block->optimal_bits = bits;
+        block->limited_bits = bits;
+    }
+    return compressed_bytes;
+}
+
+// function that writes the codes of the bytes of data from start to end as one
+// sub-stream, padded to a byte boundary, and returns the bits the codes take
+static uint64_t huff_write_stream(
+    BitWriter *outbuf, const Code *code_table, const uint8_t *data, uint32_t start, uint32_t end) {
+    uint64_t bits = 0;
+    for (uint32_t i = start; i < end; ++i) {
+        // write the whole code for the read character from code_table in one call
+        bit_write_bits(outbuf, code_table[data[i]].code, code_table[data[i]].code_length);
+        bits += code_table[data[i]].code_length;
+    }
+    // every sub-stream, and so the next block, starts on a byte boundary
+    bit_write_align(outbuf);
+    return bits;
+}
+
+// function that stores x as 4 little-endian bytes at p
+static void huff_put_uint32(uint8_t *p, uint32_t x) {
+    for (int i = 0; i < 4; ++i) {
+        p[i] = (uint8_t) (x >> (8 * i));
+    }
+}
+
+// function that writes the code lengths (or the preset table's ID), the
+// sub-stream table and the codes of a coded block
+static void huff_write_codes(HuffBlock *block, BitWriter *outbuf, TimerMark *mark,
+    const Code *code_table, const uint8_t *code_lengths, const uint32_t *stream_bytes) {
+    if (block->table_id != 0) {
+        // naming the table, the decoder has it too
+        block_write_preset(outbuf, block->table_id);
+    } else {
+        // writing the code lengths, the decoder rebuilds the codes from them
+        canon_write_lengths(outbuf, code_lengths);
+        bit_write_align(outbuf);
+    }
+    // the sub-stream table: the last length follows from the others
+    uint8_t num_streams = block->num_streams;
+    bit_write_uint8(outbuf, num_streams);
+    for (uint8_t s = 0; s + 1 < num_streams; ++s) {
+        bit_write_uint32(outbuf, stream_bytes[s]);
+    }
+    huff_lap(block, mark, HUFF_STAGE_HEADER);
+    // writing the code of every byte in the block, one slice per sub-stream
+    uint32_t start = 0;
+    for (uint8_t s = 0; s < num_streams; ++s) {
+        uint32_t end = start + block_stream_length(block->length, num_streams, s);
+        huff_write_stream(outbuf, code_table, block->data, start, end);
+        start = end;
+    }
+}
+
+// function that codes the block with its preset table in a single pass over
+// its bytes: the codes go straight into the output, then the sub-stream
+// table and the compressed length in the block header are filled in.  The
+// output has room for a stored block, which a coded block must be smaller
+// than; it returns false, with nothing kept, when the codes take at least
+// stored_bytes after the block header.
+static bool huff_write_preset(
+    HuffBlock *block, TimerMark *mark, const Code *code_table, uint64_t stored_bytes) {
+    uint8_t num_streams = block->num_streams;
+    size_t size = BLOCK_HEADER_SIZE + (size_t) stored_bytes;
+    arena_reset(block->arena);
+    block->out = block->dst != NULL && size <= block->dst_capacity
+                     ? block->dst
+                     : (uint8_t *) arena_alloc(block->arena, size);
+    BitWriter *outbuf = bit_write_open_arena(block->arena, block->out, size);
+    if (block->out == NULL || outbuf == NULL) {
+        // the caller sees the missing output and fails
+        block->out = NULL;
+        return true;
+    }
+    // the compressed length and the sub-stream table are not known yet
+    block_write_header(outbuf, block->length, 0);
+    block_write_preset(outbuf, block->table_id);
+    bit_write_uint8(outbuf, num_streams);
+    for (uint8_t s = 0; s + 1 < num_streams; ++s) {
+        bit_write_uint32(outbuf, 0);
+    }
+    huff_lap(block, mark, HUFF_STAGE_HEADER);
+    // bytes past the end of the output are dropped, and writing stops once
+    // the block is no smaller than storing it
+    uint32_t stream_bytes[BLOCK_MAX_STREAMS];
+    uint64_t compressed_bytes = BLOCK_PRESET_SIZE + 1 + 4 * (uint64_t) (num_streams - 1);
+    uint64_t bits = 0;
+    uint32_t start = 0;
+    for (uint8_t s = 0; s < num_streams && compressed_bytes < stored_bytes; ++s) {
+        uint32_t end = start + block_stream_length(block->length, num_streams, s);
+        uint64_t stream_bits = huff_write_stream(outbuf, code_table, block->data, start, end);
+        stream_bytes[s] = (uint32_t) ((stream_bits + 7) / 8);
+        compressed_bytes += stream_bytes[s];
+        bits += stream_bits;
+        start = end;
+    }
+    bit_write_close(&outbuf);
+    huff_lap(block, mark, HUFF_STAGE_ENCODE);
+    if (compressed_bytes >= stored_bytes) {
+        block->out = NULL;
+        return false;
+    }
+    // filling in what the writer could not know
+    block->compressed_length = (uint32_t) compressed_bytes;
+    huff_put_uint32(block->out + 4, block->compressed_length);
+    uint8_t *table = block->out + BLOCK_HEADER_SIZE + BLOCK_PRESET_SIZE + 1;
+    for (uint8_t s = 0; s + 1 < num_streams; ++s) {
+        huff_put_uint32(table + 4 * s, stream_bytes[s]);
+    }
+    // what the table costs, for the statistics
+    block->optimal_bits = bits;
+    block->limited_bits = bits;
+    return true;
+}
+
+// function that compresses one block (header, code lengths and codes) into
+// block->out; it only touches the block, so blocks can be encoded in parallel.
+// A block with a given table is coded in one pass when that makes it smaller
+// than storing it.  Otherwise whether the block is coded, stored or written
+// as a run is decided from its histogram before anything is encoded.
+static void huff_compress_block(void *arg) {
+    HuffBlock *block = (HuffBlock *) arg;
+    TimerMark mark = { 0, 0 };
+    if (block->timing) {
+        memset(block->wall_ns, 0, sizeof(block->wall_ns));
+        memset(block->cpu_ns, 0, sizeof(block->cpu_ns));
+        mark = timer_mark();
+    }
+    uint64_t start_ns = mark.wall_ns;
+    Code code_table[256];
+    uint8_t code_lengths[256];
+    uint32_t stream_bytes[BLOCK_MAX_STREAMS];
+    uint64_t compressed_bytes = 0;
+    // what storing the block takes after its header, coding has to take less
+    uint64_t stored_bytes = BLOCK_STORED_SIZE + (uint64_t) block->length;
+    uint8_t num_streams = block->num_streams;
+    block->table_id = 0;
+    block->kind = BLOCK_CODED;
+    block->widened = false;
+    // a run beats any table, so it is looked for first
+    bool run = block->table != NULL && huff_is_run(block);
+    if (block->table != NULL && !run) {
+        // a given table needs no histogram, tree or code lengths, one pass codes the block
+        memset(block->histogram, 0, sizeof(block->histogram));
+        block->leaves = 256;
+        block->depth = 0;
+        huff_use_table(block, block->table, code_table, code_lengths);
+        if (huff_write_preset(block, &mark, code_table, stored_bytes)) {
+            block->code_length = 0;
+            for (int i = 0; i < 256; ++i) {
+                if (code_lengths[i] > block->code_length) {
+                    block->code_length = code_lengths[i];
+                }
+            }
+            if (block->timing) {
+                trace_span("block", block->number, start_ns, mark.wall_ns);
+            }
+            return;
+        }
+        // the data is too unlike the table, its histogram decides
+        block->table_id = 0;
+    }
+    if (run || (block->table_id == 0 && huff_count(block, &mark) == 1)) {
+        // one byte value: the block is that value and its length
+        block->kind = BLOCK_RUN;
+        block->leaves = 1;
+        block->depth = 0;
+        block->optimal_bits = 0;
+        block->limited_bits = 0;
+        compressed_bytes = BLOCK_RUN_SIZE;
+        memset(code_lengths, 0, sizeof(code_lengths));
+    } else if (block->table_id == 0) {
+        huff_build_code(block, &mark, code_table, code_lengths);
+        const HuffTable *table
+            = block->choose_table ? huff_choose_table(block, code_lengths) : NULL;
+        if (table != NULL) {
+            huff_use_table(block, table, code_table, code_lengths);
+        }
+        huff_lap(block, &mark, HUFF_STAGE_CODES);
+        uint64_t header_bytes = table != NULL ? BLOCK_PRESET_SIZE
+                                              : (canon_write_lengths(NULL, code_lengths) + 7) / 8;
+        // the most the coded block can take, from the histogram: every
+        // sub-stream pads at most one byte
+        uint64_t bound = header_bytes + 1 + 4 * (uint64_t) (num_streams - 1)
+                         + huff_code_bits(block, code_lengths) / 8 + num_streams;
+        if (bound >= stored_bytes) {
+            // the codes save too little to be worth decoding
+            block->kind = BLOCK_STORED;
+            block->table_id = 0;
+            block->optimal_bits = 8 * (uint64_t) block->length;
+            block->limited_bits = block->optimal_bits;
+            compressed_bytes = stored_bytes;
+            memset(code_lengths, 0, sizeof(code_lengths));
+        } else {
+            // the size of every sub-stream is known before any code is written
+            compressed_bytes = huff_size_streams(block, code_table, header_bytes, stream_bytes);
+            huff_lap(block, &mark, HUFF_STAGE_ENCODE);
+        }
+    }
+    block->code_length = 0;
+    for (int i = 0; i < 256; ++i) {
+        if (code_lengths[i] > block->code_length) {
+            block->code_length = code_lengths[i];
+        }
+    }
+    block->compressed_length = (uint32_t) compressed_bytes;
+    size_t size = BLOCK_HEADER_SIZE + (size_t) block->compressed_length;
+    arena_reset(block->arena);
+    block->out = block->dst != NULL && size <= block->dst_capacity
+                     ? block->dst
+                     : (uint8_t *) arena_alloc(block->arena, size);
+    BitWriter *outbuf = bit_write_open_arena(block->arena, block->out, size);
+    if (block->out == NULL || outbuf == NULL) {
+        // the caller sees the missing output and fails
+        block->out = NULL;
+        return;
+    }
+    block_write_header(outbuf, block->length, block->compressed_length);
+    switch (block->kind) {
+    // the bytes are copied as they are, nothing is packed into bits
+    case BLOCK_STORED: block_write_stored(outbuf, block->data, block->length); break;
+    case BLOCK_RUN: block_write_run(outbuf, block->data[0]); break;
+    default: huff_write_codes(block, outbuf, &mark, code_table, code_lengths, stream_bytes); break;
+    }
+    bit_write_close(&outbuf);
+    huff_lap(block, &mark, HUFF_STAGE_ENCODE);
+    if (block->timing) {
+        // the whole block, around its stages
+        trace_span("block", block->number, start_ns, mark.wall_ns);
+    }
+}
+
+struct HuffCCtx {
+    HuffParams params;
+    // the ring of blocks in flight, 2 * threads of them with a pool
+    HuffBlock *slots;
+    unsigned num_slots;
+    Pool *pool;
+    BlockIndex *index;
+    // where huff_compress_ctx() keeps its writer
+    Arena *arena;
+    HuffStats stats;
+};
+
+// function that fills params with what huff uses without options
+void huff_params_default(HuffParams *params) {
+    params->block_size = BLOCK_DEFAULT_SIZE;
+    params->max_length = CANON_MAX_LENGTH;
+    params->num_streams = BLOCK_DEFAULT_STREAMS;
+    params->threads = 1;
+    params->timing = false;
+    params->table = NULL;
+    params->choose_table = false;
+}
+
+// function that returns the name of a stage, for reports
+const char *huff_stage_name(HuffStage stage) {
+    static const char *names[HUFF_NUM_STAGES] = { "read", "write", "histogram", "tree", "codes",
+        "header", "encode", "parse", "table", "decode" };
+    return stage < HUFF_NUM_STAGES ? names[stage] : "unknown";
+}
+
+// function that returns what a status means, for the tools' error messages
+const char *huff_status_message(HuffStatus status) {
+    switch (status) {
+    case HUFF_OK: return "no error";
+    case HUFF_STREAM_END: return "end of stream";
+    case HUFF_DATA_ERROR: return "input is cut short or corrupt";
+    case HUFF_MEM_ERROR: return "out of memory";
+    case HUFF_FORMAT_ERROR: return "input is not a Huffman-compressed file";
+    case HUFF_TABLE_ERROR: return "input is coded with a table that was not given";
+    case HUFF_IO_ERROR: return "could not read the input or write the output";
+    default: return "unknown error";
+    }
+}
+
+// function that creates a compression context (NULL params means the
+// defaults), or returns NULL when a parameter is out of range
+HuffCCtx *huff_cctx_create(const HuffParams *params) {
+    HuffParams defaults;
+    if (params == NULL) {
+        huff_params_default(&defaults);
+        params = &defaults;
+    }
+    if (params->block_size < 1 || params->block_size > BLOCK_MAX_SIZE || params->max_length < 1
+        || params->max_length > CANON_MAX_LENGTH || params->num_streams < 1
+        || params->num_streams > BLOCK_MAX_STREAMS || params->threads > POOL_MAX_THREADS) {
+        return NULL;
+    }
+    HuffCCtx *ctx = (HuffCCtx *) calloc(1, sizeof(HuffCCtx));
+    if (ctx == NULL) {
+        return NULL;
+    }
+    ctx->params = *params;
+    if (ctx->params.threads == 0) {
+        ctx->params.threads = pool_online_cores();
+    }
+    unsigned threads = ctx->params.threads;
+    ctx->num_slots = threads > 1 ? 2 * threads : 1;
+    ctx->slots = (HuffBlock *) calloc(ctx->num_slots, sizeof(HuffBlock));
+    ctx->pool = threads > 1 ? pool_create(threads) : NULL;
+    ctx->index = block_index_create();
+    ctx->arena = arena_create(1024);
+    bool ok = ctx->slots != NULL && (threads == 1 || ctx->pool != NULL) && ctx->index != NULL
+              && ctx->arena != NULL;
+    for (unsigned i = 0; ok && i < ctx->num_slots; ++i) {
+        ctx->slots[i].max_length = params->max_length;
+        ctx->slots[i].num_streams = params->num_streams;
+        ctx->slots[i].timing = params->timing;
+        ctx->slots[i].table = params->table;
+        ctx->slots[i].choose_table = params->choose_table;
+        // one chunk holds the largest block and its writer
+        ctx->slots[i].arena = arena_create(block_bound(params->block_size) + 1024);
+        ok = ctx->slots[i].arena != NULL;
+    }
+    if (!ok) {
+        huff_cctx_free(&ctx);
+    }
+    return ctx;
+}
+
+// function that frees the compression context and stops its threads
+void huff_cctx_free(HuffCCtx **ctx) {
+    if (*ctx != NULL) {
+        pool_free(&(*ctx)->pool);
+        block_index_free(&(*ctx)->index);
+        arena_free(&(*ctx)->arena);
+        for (unsigned i = 0; (*ctx)->slots != NULL && i < (*ctx)->num_slots; ++i) {
+            free((*ctx)->slots[i].buffer);
+            arena_free(&(*ctx)->slots[i].arena);
+        }
+        free((*ctx)->slots);
+        free(*ctx);
+        *ctx = NULL;
+    }
+}
+
+// function that returns what the last compression with the context did
+const HuffStats *huff_cctx_stats(const HuffCCtx *ctx) {
+    return &ctx->stats;
+}
+
+// function that returns the most bytes the context can make out of n bytes
+size_t huff_cctx_bound(const HuffCCtx *ctx, size_t n) {
+    uint32_t block_size = ctx->params.block_size;
+    size_t blocks = n / block_size + (n % block_size != 0);
+    return BLOCK_FILE_HEADER_SIZE + n + blocks * (block_bound(0) + 8) + 4 + BLOCK_TRAILER_SIZE;
+}
+
+// function that returns the most bytes huff_compress_buffer() makes out of n bytes
+size_t huff_compress_bound(size_t n) {
+    size_t blocks = n / BLOCK_DEFAULT_SIZE + (n % BLOCK_DEFAULT_SIZE != 0);
+    return BLOCK_FILE_HEADER_SIZE + n + blocks * (block_bound(0) + 8) + 4 + BLOCK_TRAILER_SIZE;
+}
+
+// function that adds what coding a block did to stats
+static void huff_add_block_stats(HuffStats *stats, const HuffBlock *block) {
+    for (int i = 0; i < 256; ++i) {
+        stats->histogram[i] += block->histogram[i];
+    }
+    stats->table_blocks += block->table_id != 0;
+    stats->stored_blocks += block->kind == BLOCK_STORED;
+    stats->run_blocks += block->kind == BLOCK_RUN;
+    stats->widened_blocks += block->widened;
+    stats->max_leaves = block->leaves > stats->max_leaves ? block->leaves : stats->max_leaves;
+    stats->max_depth = block->depth > stats->max_depth ? block->depth : stats->max_depth;
+    if (block->code_length > stats->max_code_length) {
+        stats->max_code_length = block->code_length;
+    }
+    for (int s = 0; block->timing && s < HUFF_NUM_STAGES; ++s) {
+        stats->wall_ns[s] += block->wall_ns[s];
+        stats->cpu_ns[s] += block->cpu_ns[s];
+    }
+}
+
+// function that adds the time since mark to a stage of the context's calling
+// thread when it is timed, and records the stage in the trace
+static void huff_ctx_lap(HuffCCtx *ctx, TimerMark *mark, HuffStage stage, uint64_t block) {
+    if (ctx->params.timing) {
+        uint64_t start_ns = mark->wall_ns;
+        timer_lap(mark, &ctx->stats.wall_ns[stage], &ctx->stats.cpu_ns[stage]);
+        trace_span(huff_stage_name(stage), block, start_ns, mark->wall_ns);
+    }
+}
+
+// function that compresses block by block and writes the block index; with
+// more than one thread the blocks are encoded on the pool while at most
+// 2 * threads blocks are in flight, and they are still written in input
+// order.  The input is read from fin, or is the n bytes at data when fin is
+// NULL, which are coded in place.  It fails without writing more once the
+// output would pass limit bytes.
+static bool huff_compress_blocks(HuffCCtx *ctx, BitWriter *outbuf, FILE *fin, const uint8_t *data,
+    size_t n, uint64_t limit) {
+    uint32_t block_size = ctx->params.block_size;
+    unsigned num_slots = ctx->num_slots;
+    HuffBlock *slots = ctx->slots;
+    memset(&ctx->stats, 0, sizeof(ctx->stats));
+    block_index_reset(ctx->index);
+    // the slots' buffers are only needed for files, they are kept once made
+    for (unsigned i = 0; fin != NULL && i < num_slots; ++i) {
+        if (slots[i].buffer == NULL) {
+            slots[i].buffer = (uint8_t *) malloc(block_size);
+            if (slots[i].buffer == NULL) {
+                return false;
+            }
+        }
+    }
+    bool timing = ctx->params.timing;
+    TimerMark mark = { 0, 0 };
+    bool ok = limit >= BLOCK_FILE_HEADER_SIZE;
+    if (ok) {
+        block_write_file_header(outbuf, block_size);
+    }
+    // the offset of the next block from the start of the output
+    uint64_t offset = BLOCK_FILE_HEADER_SIZE;
+    // blocks are numbered in input order; next_read - next_write are in flight
+    uint64_t next_read = 0;
+    uint64_t next_write = 0;
+    // the part of the input in memory that is not in a block yet
+    size_t taken = 0;
+    bool eof = !ok;
+    while (true) {
+        // reading blocks until every slot is busy
+        while (!eof && next_read - next_write < num_slots) {
+            HuffBlock *block = &slots[next_read % num_slots];
+            size_t length;
+            if (fin == NULL) {
+                length = n - taken < block_size ? n - taken : block_size;
+                block->data = length > 0 ? data + taken : NULL;
+                taken += length;
+            } else {
+                if (timing) {
+                    mark = timer_mark();
+                }
+                length = fread(block->buffer, 1, block_size, fin);
+                block->data = block->buffer;
+                huff_ctx_lap(ctx, &mark, HUFF_STAGE_READ, next_read);
+            }
+            if (length == 0) {
+                eof = true;
+                break;
+            }
+            block->length = (uint32_t) length;
+            block->number = next_read;
+            if (ctx->pool != NULL) {
+                pool_submit(ctx->pool, &block->job, huff_compress_block, block);
+            } else {
+                huff_compress_block(block);
+            }
+            ++next_read;
+        }
+        if (next_write == next_read) {
+            break;
+        }
+        // writing the oldest block as soon as it is encoded
+        HuffBlock *block = &slots[next_write % num_slots];
+        if (ctx->pool != NULL) {
+            // the time this thread waits for the block shows up in the trace as a stall
+            uint64_t wait_ns = timing ? timer_now_ns() : 0;
+            pool_wait_job(ctx->pool, &block->job);
+            if (timing) {
+                trace_span("wait", block->number, wait_ns, timer_now_ns());
+            }
+        }
+        ++next_write;
+        uint64_t size = BLOCK_HEADER_SIZE + (uint64_t) block->compressed_length;
+        if (!ok || block->out == NULL || offset + size > limit) {
+            // the blocks in flight still have to finish before the slots are free
+            ok = false;
+            eof = true;
+            continue;
+        }
+        if (timing) {
+            mark = timer_mark();
+        }
+        bit_write_bytes(outbuf, block->out, size);
+        huff_ctx_lap(ctx, &mark, HUFF_STAGE_WRITE, block->number);
+        block->out = NULL;
+        block_index_append(ctx->index, offset, block->length);
+        offset += size;
+        ctx->stats.input_bytes += block->length;
+        ctx->stats.blocks += 1;
+        ctx->stats.optimal_bits += block->optimal_bits;
+        ctx->stats.limited_bits += block->limited_bits;
+        huff_add_block_stats(&ctx->stats, block);
+    }
+    // the end marker and the index
+    uint64_t end = offset + 4 + 8 * block_index_count(ctx->index) + BLOCK_TRAILER_SIZE;
+    if (!ok || end > limit) {
+        return false;
+    }
+    if (timing) {
+        mark = timer_mark();
+    }
+    block_write_end(outbuf);
+    block_index_write(outbuf, ctx->index);
+    huff_ctx_lap(ctx, &mark, HUFF_STAGE_WRITE, TRACE_NO_BLOCK);
+    ctx->stats.output_bytes = end;
+    return true;
+}
+
+// function that compresses the input of a file to outbuf: the input is read
+// from fin, or is the n bytes at data (a mapped file) when fin is NULL
+bool huff_compress_file(HuffCCtx *ctx, BitWriter *outbuf, FILE *fin, const uint8_t *data, size_t n) {
+    return huff_compress_blocks(ctx, outbuf, fin, data, n, UINT64_MAX);
+}
+
+// function that compresses the n bytes at src into the cap bytes at dst and
+// returns the compressed size, or HUFF_ERROR when dst is too small
+size_t huff_compress_ctx(HuffCCtx *ctx, const uint8_t *src, size_t n, uint8_t *dst, size_t cap) {
+    // the writer lives in the context's arena, so this allocates nothing once warm
+    arena_reset(ctx->arena);
+    BitWriter *outbuf = bit_write_open_arena(ctx->arena, dst, cap);
+    if (outbuf == NULL) {
+        return HUFF_ERROR;
+    }
+    bool ok = huff_compress_blocks(ctx, outbuf, NULL, src, n, cap);
+    bit_write_close(&outbuf);
+    return ok ? (size_t) ctx->stats.output_bytes : HUFF_ERROR;
+}
+
+// function that compresses with a context of its own, using the default parameters
+size_t huff_compress_buffer(const uint8_t *src, size_t n, uint8_t *dst, size_t cap) {
+    HuffCCtx *ctx = huff_cctx_create(NULL);
+    if (ctx == NULL) {
+        return HUFF_ERROR;
+    }
+    size_t size = huff_compress_ctx(ctx, src, n, dst, cap);
+    huff_cctx_free(&ctx);
+    return size;
+}
+
+struct HuffStreamEncoder {
+    HuffParams params;
+    // the block being collected from the input, and how much of it there is
+    uint8_t *buffer;
+    uint32_t buffered;
+    // the block being coded, its output lives in the slot's arena
+    HuffBlock slot;
+    // output that did not fit in the caller's buffer yet
+    const uint8_t *pending;
+    size_t pending_length;
+    // the file header, and the end marker and index once the stream ends
+    uint8_t header[BLOCK_FILE_HEADER_SIZE];
+    uint8_t *trailer;
+    bool started;
+    bool finished;
+    // where the next block starts in the output, for the index
+    uint64_t offset;
+    BlockIndex *index;
+};
+
+// function that sets up strm to compress with params (NULL means the defaults)
+bool huff_stream_compress_init(HuffStream *strm, const HuffParams *params) {
+    HuffParams defaults;
+    if (params == NULL) {
+        huff_params_default(&defaults);
+        params = &defaults;
+    }
+    if (params->block_size < 1 || params->block_size > BLOCK_MAX_SIZE || params->max_length < 1
+        || params->max_length > CANON_MAX_LENGTH || params->num_streams < 1
+        || params->num_streams > BLOCK_MAX_STREAMS) {
+        return false;
+    }
+    HuffStreamEncoder *enc = (HuffStreamEncoder *) calloc(1, sizeof(HuffStreamEncoder));
+    if (enc == NULL) {
+        return false;
+    }
+    enc->params = *params;
+    enc->buffer = (uint8_t *) malloc(params->block_size);
+    enc->slot.max_length = params->max_length;
+    enc->slot.num_streams = params->num_streams;
+    enc->slot.table = params->table;
+    enc->slot.choose_table = params->choose_table;
+    enc->slot.arena = arena_create(block_bound(params->block_size) + 1024);
+    enc->index = block_index_create();
+    enc->offset = BLOCK_FILE_HEADER_SIZE;
+    strm->total_in = 0;
+    strm->total_out = 0;
+    strm->encoder = enc;
+    strm->decoder = NULL;
+    if (enc->buffer == NULL || enc->slot.arena == NULL || enc->index == NULL) {
+        huff_stream_compress_end(strm);
+        return false;
+    }
+    return true;
+}
+
+// function that frees what huff_stream_compress_init() set up
+void huff_stream_compress_end(HuffStream *strm) {
+    HuffStreamEncoder *enc = strm->encoder;
+    if (enc != NULL) {
+        free(enc->buffer);
+        free(enc->trailer);
+        arena_free(&enc->slot.arena);
+        block_index_free(&enc->index);
+        free(enc);
+        strm->encoder = NULL;
+    }
+}
+
+// function that moves as much pending output as fits into the caller's buffer
+static void huff_stream_deliver(HuffStream *strm, HuffStreamEncoder *enc) {
+    size_t n = enc->pending_length < strm->avail_out ? enc->pending_length : strm->avail_out;
+    if (n == 0) {
+        return;
+    }
+    memcpy(strm->next_out, enc->pending, n);
+    strm->next_out += n;
+    strm->avail_out -= n;
+    strm->total_out += n;
+    enc->pending += n;
+    enc->pending_length -= n;
+}
+
+// function that codes the length bytes at data as the next block, straight
+// into the caller's output when the block fits there
+static bool huff_stream_block(HuffStream *strm, HuffStreamEncoder *enc, const uint8_t *data,
+    uint32_t length) {
+    HuffBlock *block = &enc->slot;
+    block->data = data;
+    block->length = length;
+    block->dst = strm->next_out;
+    block->dst_capacity = strm->avail_out;
+    huff_compress_block(block);
+    if (block->out == NULL || !block_index_append(enc->index, enc->offset, length)) {
+        return false;
+    }
+    size_t size = BLOCK_HEADER_SIZE + (size_t) block->compressed_length;
+    enc->offset += size;
+    if (block->out == strm->next_out) {
+        strm->next_out += size;
+        strm->avail_out -= size;
+        strm->total_out += size;
+    } else {
+        enc->pending = block->out;
+        enc->pending_length = size;
+    }
+    return true;
+}
+
+// function that writes the end marker and the block index into a buffer of their own
+static bool huff_stream_trailer(HuffStreamEncoder *enc) {
+    size_t size = 4 + 8 * block_index_count(enc->index) + BLOCK_TRAILER_SIZE;
+    enc->trailer = (uint8_t *) malloc(size);
+    BitWriter *outbuf = bit_write_open_memory(enc->trailer, size);
+    if (enc->trailer == NULL || outbuf == NULL) {
+        return false;
+    }
+    block_write_end(outbuf);
+    block_index_write(outbuf, enc->index);
+    bit_write_close(&outbuf);
+    enc->pending = enc->trailer;
+    enc->pending_length = size;
+    return true;
+}
+
+// function that compresses from strm->next_in to strm->next_out until the
+// input runs out or the output is full.  Full blocks are coded as they
+// arrive; flush decides what happens to a partial block at the end of the
+// input.  It returns HUFF_STREAM_END once HUFF_FINISH has produced all of
+// the stream's output.
+HuffStatus huff_stream_compress(HuffStream *strm, HuffFlush flush) {
+    HuffStreamEncoder *enc = strm->encoder;
+    uint32_t block_size = enc->params.block_size;
+    while (true) {
+        // output that is ready goes first; nothing else happens until it is out
+        huff_stream_deliver(strm, enc);
+        if (enc->pending_length > 0) {
+            return HUFF_OK;
+        }
+        if (enc->finished) {
+            return HUFF_STREAM_END;
+        }
+        if (!enc->started) {
+            BitWriter *outbuf = bit_write_open_memory(enc->header, sizeof(enc->header));
+            if (outbuf == NULL) {
+                return HUFF_MEM_ERROR;
+            }
+            block_write_file_header(outbuf, block_size);
+            bit_write_close(&outbuf);
+            enc->pending = enc->header;
+            enc->pending_length = sizeof(enc->header);
+            enc->started = true;
+            continue;
+        }
+        if (enc->buffered == 0 && strm->avail_in >= block_size) {
+            // a whole block in the caller's input is coded where it is
+            const uint8_t *data = strm->next_in;
+            strm->next_in += block_size;
+            strm->avail_in -= block_size;
+            strm->total_in += block_size;
+            if (!huff_stream_block(strm, enc, data, block_size)) {
+                return HUFF_MEM_ERROR;
+            }
+            continue;
+        }
+        // the rest of a block is collected in the buffer
+        size_t n = block_size - enc->buffered;
+        n = strm->avail_in < n ? strm->avail_in : n;
+        if (n > 0) {
+            memcpy(enc->buffer + enc->buffered, strm->next_in, n);
+            enc->buffered += (uint32_t) n;
+            strm->next_in += n;
+            strm->avail_in -= n;
+            strm->total_in += n;
+        }
+        if (enc->buffered == block_size
+            || (flush != HUFF_NO_FLUSH && strm->avail_in == 0 && enc->buffered > 0)) {
+            uint32_t length = enc->buffered;
+            enc->buffered = 0;
+            if (!huff_stream_block(strm, enc, enc->buffer, length)) {
+                return HUFF_MEM_ERROR;
+            }
+            continue;
+        }
+        if (flush == HUFF_FINISH && strm->avail_in == 0) {
+            if (!huff_stream_trailer(enc)) {
+                return HUFF_MEM_ERROR;
+            }
+            enc->finished = true;
+            continue;
+        }
+        // everything given has been taken in
+        return HUFF_OK;
+    }
+}
@@ -0,0 +1,294 @@
+#include "libhuff.h"
+
+#include "bitio_ext.h"
+#include "bitreader.h"
+#include "bitwriter.h"
+#include "canon.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// the format version of a table file: 'H' 'T', the version, the table's ID,
+// then its code lengths as a block stores them
+#define HUFF_TABLE_VERSION 1
+
+// the built-in tables, printed by hufftrain -c (see hufftrain.c for the samples)
+static const HuffTable huff_builtin_tables[] = {
+    // English text
+    { 1,
+        {
+            11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 6, 11, 11, 11, 11, 11,
+            11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11,
+            3, 11, 8, 11, 11, 11, 11, 11, 10, 9, 11, 11, 7, 10, 7, 11,
+            10, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11,
+            11, 9, 11, 9, 9, 9, 10, 9, 10, 8, 11, 11, 8, 10, 9, 9,
+            9, 11, 9, 8, 8, 9, 11, 10, 11, 9, 11, 11, 11, 11, 11, 11,
+            11, 4, 7, 5, 5, 4, 6, 7, 5, 4, 11, 8, 6, 6, 4, 4,
+            6, 10, 4, 5, 4, 6, 7, 7, 9, 6, 11, 11, 11, 11, 11, 11,
+            11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11,
+            11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11,
+            11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11,
+            11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11,
+            11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11,
+            11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11,
+            11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11,
+            11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11,
+        },
+        {
+            0x0167, 0x0567, 0x0367, 0x0767, 0x00e7, 0x04e7, 0x02e7, 0x06e7,
+            0x01e7, 0x05e7, 0x000d, 0x03e7, 0x07e7, 0x0017, 0x0417, 0x0217,
+            0x0617, 0x0117, 0x0517, 0x0317, 0x0717, 0x0097, 0x0497, 0x0297,
+            0x0697, 0x0197, 0x0597, 0x0397, 0x0797, 0x0057, 0x0457, 0x0257,
+            0x0000, 0x0657, 0x001b, 0x0157, 0x0557, 0x0357, 0x0757, 0x00d7,
+            0x0127, 0x007b, 0x04d7, 0x02d7, 0x0033, 0x0327, 0x0073, 0x06d7,
+            0x00a7, 0x01d7, 0x05d7, 0x03d7, 0x07d7, 0x0037, 0x0437, 0x0237,
+            0x0637, 0x0137, 0x0537, 0x0337, 0x0737, 0x00b7, 0x04b7, 0x02b7,
+            0x06b7, 0x017b, 0x01b7, 0x00fb, 0x01fb, 0x0007, 0x02a7, 0x0107,
+            0x01a7, 0x009b, 0x05b7, 0x03b7, 0x005b, 0x03a7, 0x0087, 0x0187,
+            0x0047, 0x07b7, 0x0147, 0x00db, 0x003b, 0x00c7, 0x0077, 0x0067,
+            0x0477, 0x01c7, 0x0277, 0x0677, 0x0177, 0x0577, 0x0377, 0x0777,
+            0x00f7, 0x0004, 0x000b, 0x0009, 0x0019, 0x000c, 0x002d, 0x004b,
+            0x0005, 0x0002, 0x04f7, 0x00bb, 0x001d, 0x003d, 0x000a, 0x0006,
+            0x0003, 0x0267, 0x000e, 0x0015, 0x0001, 0x0023, 0x002b, 0x006b,
+            0x0027, 0x0013, 0x02f7, 0x06f7, 0x01f7, 0x05f7, 0x03f7, 0x07f7,
+            0x000f, 0x040f, 0x020f, 0x060f, 0x010f, 0x050f, 0x030f, 0x070f,
+            0x008f, 0x048f, 0x028f, 0x068f, 0x018f, 0x058f, 0x038f, 0x078f,
+            0x004f, 0x044f, 0x024f, 0x064f, 0x014f, 0x054f, 0x034f, 0x074f,
+            0x00cf, 0x04cf, 0x02cf, 0x06cf, 0x01cf, 0x05cf, 0x03cf, 0x07cf,
+            0x002f, 0x042f, 0x022f, 0x062f, 0x012f, 0x052f, 0x032f, 0x072f,
+            0x00af, 0x04af, 0x02af, 0x06af, 0x01af, 0x05af, 0x03af, 0x07af,
+            0x006f, 0x046f, 0x026f, 0x066f, 0x016f, 0x056f, 0x036f, 0x076f,
+            0x00ef, 0x04ef, 0x02ef, 0x06ef, 0x01ef, 0x05ef, 0x03ef, 0x07ef,
+            0x001f, 0x041f, 0x021f, 0x061f, 0x011f, 0x051f, 0x031f, 0x071f,
+            0x009f, 0x049f, 0x029f, 0x069f, 0x019f, 0x059f, 0x039f, 0x079f,
+            0x005f, 0x045f, 0x025f, 0x065f, 0x015f, 0x055f, 0x035f, 0x075f,
+            0x00df, 0x04df, 0x02df, 0x06df, 0x01df, 0x05df, 0x03df, 0x07df,
+            0x003f, 0x043f, 0x023f, 0x063f, 0x013f, 0x053f, 0x033f, 0x073f,
+            0x00bf, 0x04bf, 0x02bf, 0x06bf, 0x01bf, 0x05bf, 0x03bf, 0x07bf,
+            0x007f, 0x047f, 0x027f, 0x067f, 0x017f, 0x057f, 0x037f, 0x077f,
+            0x00ff, 0x04ff, 0x02ff, 0x06ff, 0x01ff, 0x05ff, 0x03ff, 0x07ff,
+        } },
+    // JSON
+    { 2,
+        {
+            11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11,
+            11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11,
+            7, 11, 2, 11, 11, 11, 11, 11, 11, 11, 11, 11, 4, 8, 11, 11,
+            9, 10, 9, 7, 11, 11, 11, 11, 11, 11, 4, 11, 11, 11, 11, 11,
+            11, 9, 9, 9, 9, 9, 10, 9, 10, 7, 11, 9, 7, 8, 9, 10,
+            9, 11, 9, 8, 9, 10, 10, 10, 11, 11, 10, 11, 11, 11, 11, 7,
+            11, 4, 8, 6, 7, 4, 9, 8, 6, 6, 10, 8, 6, 6, 5, 5,
+            5, 11, 6, 6, 5, 7, 8, 9, 10, 6, 10, 6, 11, 6, 11, 11,
+            11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11,
+            11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11,
+            11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11,
+            11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11,
+            11, 11, 11, 10, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11,
+            11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11,
+            11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11,
+            11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11,
+        },
+        {
+            0x01e7, 0x05e7, 0x03e7, 0x07e7, 0x0017, 0x0417, 0x0217, 0x0617,
+            0x0117, 0x0517, 0x0317, 0x0717, 0x0097, 0x0497, 0x0297, 0x0697,
+            0x0197, 0x0597, 0x0397, 0x0797, 0x0057, 0x0457, 0x0257, 0x0657,
+            0x0157, 0x0557, 0x0357, 0x0757, 0x00d7, 0x04d7, 0x02d7, 0x06d7,
+            0x0013, 0x01d7, 0x0000, 0x05d7, 0x03d7, 0x07d7, 0x0037, 0x0437,
+            0x0237, 0x0637, 0x0137, 0x0537, 0x0002, 0x006b, 0x0337, 0x0737,
+            0x00bb, 0x0127, 0x01bb, 0x0053, 0x00b7, 0x04b7, 0x02b7, 0x06b7,
+            0x01b7, 0x05b7, 0x000a, 0x03b7, 0x07b7, 0x0077, 0x0477, 0x0277,
+            0x0677, 0x007b, 0x017b, 0x00fb, 0x01fb, 0x0007, 0x0327, 0x0107,
+            0x00a7, 0x0033, 0x0177, 0x0087, 0x0073, 0x00eb, 0x0187, 0x02a7,
+            0x0047, 0x0577, 0x0147, 0x001b, 0x00c7, 0x01a7, 0x03a7, 0x0067,
+            0x0377, 0x0777, 0x0267, 0x00f7, 0x04f7, 0x02f7, 0x06f7, 0x000b,
+            0x01f7, 0x0006, 0x009b, 0x0005, 0x004b, 0x000e, 0x01c7, 0x005b,
+            0x0025, 0x0015, 0x0167, 0x00db, 0x0035, 0x000d, 0x0001, 0x0011,
+            0x0009, 0x05f7, 0x002d, 0x001d, 0x0019, 0x002b, 0x003b, 0x0027,
+            0x0367, 0x003d, 0x00e7, 0x0003, 0x03f7, 0x0023, 0x07f7, 0x000f,
+            0x040f, 0x020f, 0x060f, 0x010f, 0x050f, 0x030f, 0x070f, 0x008f,
+            0x048f, 0x028f, 0x068f, 0x018f, 0x058f, 0x038f, 0x078f, 0x004f,
+            0x044f, 0x024f, 0x064f, 0x014f, 0x054f, 0x034f, 0x074f, 0x00cf,
+            0x04cf, 0x02cf, 0x06cf, 0x01cf, 0x05cf, 0x03cf, 0x07cf, 0x002f,
+            0x042f, 0x022f, 0x062f, 0x012f, 0x052f, 0x032f, 0x072f, 0x00af,
+            0x04af, 0x02af, 0x06af, 0x01af, 0x05af, 0x03af, 0x07af, 0x006f,
+            0x046f, 0x026f, 0x066f, 0x016f, 0x056f, 0x036f, 0x076f, 0x00ef,
+            0x04ef, 0x02ef, 0x06ef, 0x01ef, 0x05ef, 0x03ef, 0x07ef, 0x001f,
+            0x041f, 0x021f, 0x061f, 0x02e7, 0x011f, 0x051f, 0x031f, 0x071f,
+            0x009f, 0x049f, 0x029f, 0x069f, 0x019f, 0x059f, 0x039f, 0x079f,
+            0x005f, 0x045f, 0x025f, 0x065f, 0x015f, 0x055f, 0x035f, 0x075f,
+            0x00df, 0x04df, 0x02df, 0x06df, 0x01df, 0x05df, 0x03df, 0x07df,
+            0x003f, 0x043f, 0x023f, 0x063f, 0x013f, 0x053f, 0x033f, 0x073f,
+            0x00bf, 0x04bf, 0x02bf, 0x06bf, 0x01bf, 0x05bf, 0x03bf, 0x07bf,
+            0x007f, 0x047f, 0x027f, 0x067f, 0x017f, 0x057f, 0x037f, 0x077f,
+            0x00ff, 0x04ff, 0x02ff, 0x06ff, 0x01ff, 0x05ff, 0x03ff, 0x07ff,
+        } },
+    // C source code
+    { 3,
+        {
+            11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 5, 11, 11, 11, 11, 11,
+            11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11,
+            2, 10, 8, 10, 11, 11, 9, 9, 7, 7, 7, 9, 7, 7, 9, 7,
+            8, 8, 9, 10, 9, 10, 9, 11, 8, 11, 10, 6, 9, 7, 8, 11,
+            11, 9, 9, 10, 10, 8, 9, 11, 9, 9, 11, 11, 8, 10, 8, 10,
+            10, 11, 9, 9, 9, 9, 11, 11, 11, 11, 11, 9, 10, 9, 11, 6,
+            11, 5, 7, 6, 6, 4, 6, 7, 6, 5, 11, 8, 6, 7, 5, 5,
+            7, 10, 5, 5, 4, 6, 9, 8, 8, 8, 9, 8, 11, 8, 11, 11,
+            11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11,
+            11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11,
+            11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11,
+            11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11,
+            11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11,
+            11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11,
+            11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11,
+            11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11, 11,
+        },
+        {
+            0x0197, 0x0597, 0x0397, 0x0797, 0x0057, 0x0457, 0x0257, 0x0657,
+            0x0157, 0x0557, 0x0006, 0x0357, 0x0757, 0x00d7, 0x04d7, 0x02d7,
+            0x06d7, 0x01d7, 0x05d7, 0x03d7, 0x07d7, 0x0037, 0x0437, 0x0237,
+            0x0637, 0x0137, 0x0537, 0x0337, 0x0737, 0x00b7, 0x04b7, 0x02b7,
+            0x0000, 0x0167, 0x0073, 0x0367, 0x06b7, 0x01b7, 0x003b, 0x013b,
+            0x001d, 0x005d, 0x003d, 0x00bb, 0x007d, 0x0003, 0x01bb, 0x0043,
+            0x00f3, 0x000b, 0x007b, 0x00e7, 0x017b, 0x02e7, 0x00fb, 0x05b7,
+            0x008b, 0x03b7, 0x01e7, 0x0019, 0x01fb, 0x0023, 0x004b, 0x07b7,
+            0x0077, 0x0007, 0x0107, 0x03e7, 0x0017, 0x00cb, 0x0087, 0x0477,
+            0x0187, 0x0047, 0x0277, 0x0677, 0x002b, 0x0217, 0x00ab, 0x0117,
+            0x0317, 0x0177, 0x0147, 0x00c7, 0x01c7, 0x0027, 0x0577, 0x0377,
+            0x0777, 0x00f7, 0x04f7, 0x0127, 0x0097, 0x00a7, 0x02f7, 0x0039,
+            0x06f7, 0x0016, 0x0063, 0x0005, 0x0025, 0x0002, 0x0015, 0x0013,
+            0x0035, 0x000e, 0x01f7, 0x006b, 0x000d, 0x0053, 0x001e, 0x0001,
+            0x0033, 0x0297, 0x0011, 0x0009, 0x000a, 0x002d, 0x01a7, 0x00eb,
+            0x001b, 0x009b, 0x0067, 0x005b, 0x05f7, 0x00db, 0x03f7, 0x07f7,
+            0x000f, 0x040f, 0x020f, 0x060f, 0x010f, 0x050f, 0x030f, 0x070f,
+            0x008f, 0x048f, 0x028f, 0x068f, 0x018f, 0x058f, 0x038f, 0x078f,
+            0x004f, 0x044f, 0x024f, 0x064f, 0x014f, 0x054f, 0x034f, 0x074f,
+            0x00cf, 0x04cf, 0x02cf, 0x06cf, 0x01cf, 0x05cf, 0x03cf, 0x07cf,
+            0x002f, 0x042f, 0x022f, 0x062f, 0x012f, 0x052f, 0x032f, 0x072f,
+            0x00af, 0x04af, 0x02af, 0x06af, 0x01af, 0x05af, 0x03af, 0x07af,
+            0x006f, 0x046f, 0x026f, 0x066f, 0x016f, 0x056f, 0x036f, 0x076f,
+            0x00ef, 0x04ef, 0x02ef, 0x06ef, 0x01ef, 0x05ef, 0x03ef, 0x07ef,
+            0x001f, 0x041f, 0x021f, 0x061f, 0x011f, 0x051f, 0x031f, 0x071f,
+            0x009f, 0x049f, 0x029f, 0x069f, 0x019f, 0x059f, 0x039f, 0x079f,
+            0x005f, 0x045f, 0x025f, 0x065f, 0x015f, 0x055f, 0x035f, 0x075f,
+            0x00df, 0x04df, 0x02df, 0x06df, 0x01df, 0x05df, 0x03df, 0x07df,
+            0x003f, 0x043f, 0x023f, 0x063f, 0x013f, 0x053f, 0x033f, 0x073f,
+            0x00bf, 0x04bf, 0x02bf, 0x06bf, 0x01bf, 0x05bf, 0x03bf, 0x07bf,
+            0x007f, 0x047f, 0x027f, 0x067f, 0x017f, 0x057f, 0x037f, 0x077f,
+            0x00ff, 0x04ff, 0x02ff, 0x06ff, 0x01ff, 0x05ff, 0x03ff, 0x07ff,
+        } },
+};
+
+static const char *const huff_builtin_names[] = { "text", "json", "source" };
+
+#define HUFF_NUM_BUILTIN (sizeof(huff_builtin_tables) / sizeof(huff_builtin_tables[0]))
+
+// function that returns the built-in table with that ID, or NULL when there is none
+const HuffTable *huff_table_builtin(uint8_t id) {
+    return id >= 1 && id <= HUFF_NUM_BUILTIN ? &huff_builtin_tables[id - 1] : NULL;
+}
+
+// function that returns the built-in table with that name, or NULL when there is none
+const HuffTable *huff_table_by_name(const char *name) {
+    for (size_t i = 0; i < HUFF_NUM_BUILTIN; ++i) {
+        if (strcmp(name, huff_builtin_names[i]) == 0) {
+            return &huff_builtin_tables[i];
+        }
+    }
+    return NULL;
+}
+
+// function that makes a table from the code lengths and returns NULL unless
+// every byte value has a code
+static HuffTable *huff_table_from_lengths(const uint8_t *code_lengths, uint8_t id) {
+    for (int i = 0; i < 256; ++i) {
+        if (code_lengths[i] == 0) {
+            return NULL;
+        }
+    }
+    HuffTable *table = (HuffTable *) calloc(1, sizeof(HuffTable));
+    if (table == NULL) {
+        return NULL;
+    }
+    table->id = id;
+    memcpy(table->code_lengths, code_lengths, 256);
+    canon_assign(table->code_lengths, table->codes);
+    return table;
+}
+
+// function that makes the table with that ID (not 0) that codes bytes counted
+// in histogram best with codes of at most max_length bits; every byte value
+// gets a code, so bytes the sample lacks can still be coded
+HuffTable *huff_table_create(const uint64_t *histogram, uint8_t id, uint8_t max_length) {
+    if (id == 0 || max_length < 8 || max_length > CANON_MAX_LENGTH) {
+        return NULL;
+    }
+    // the counts are scaled down to 32 bits, one more for every byte value
+    uint64_t most = 0;
+    for (int i = 0; i < 256; ++i) {
+        most = histogram[i] > most ? histogram[i] : most;
+    }
+    int shift = 0;
+    while ((most >> shift) >= UINT32_MAX) {
+        ++shift;
+    }
+    uint32_t weights[256];
+    for (int i = 0; i < 256; ++i) {
+        weights[i] = (uint32_t) (histogram[i] >> shift) + 1;
+    }
+    uint8_t code_lengths[256];
+    if (!canon_limit_lengths(weights, max_length, code_lengths)) {
+        return NULL;
+    }
+    return huff_table_from_lengths(code_lengths, id);
+}
+
+// function that reads a table written by huff_table_save(), or returns NULL
+// when the file is missing or is not a table; the file is small, so it is
+// read whole and bit_read_open() (which reports a missing file) is not used
+HuffTable *huff_table_load(const char *path) {
+    // the header and code lengths of 4 bits each for every byte value
+    uint8_t data[4 + 128];
+    FILE *f = fopen(path, "r");
+    if (f == NULL) {
+        return NULL;
+    }
+    size_t n = fread(data, 1, sizeof(data), f);
+    fclose(f);
+    BitReader *inbuf = bit_read_open_memory(data, n);
+    if (inbuf == NULL) {
+        return NULL;
+    }
+    uint8_t type1 = bit_read_uint8(inbuf);
+    uint8_t type2 = bit_read_uint8(inbuf);
+    uint8_t version = bit_read_uint8(inbuf);
+    uint8_t id = bit_read_uint8(inbuf);
+    uint8_t code_lengths[256];
+    bool ok = type1 == 'H' && type2 == 'T' && version == HUFF_TABLE_VERSION && id != 0
+              && canon_read_lengths(inbuf, code_lengths);
+    bit_read_close(&inbuf);
+    return ok ? huff_table_from_lengths(code_lengths, id) : NULL;
+}
+
+// function that writes the table to a file and returns false when it cannot
+bool huff_table_save(const HuffTable *table, const char *path) {
+    BitWriter *outbuf = bit_write_open(path);
+    if (outbuf == NULL) {
+        return false;
+    }
+    bit_write_uint8(outbuf, 'H');
+    bit_write_uint8(outbuf, 'T');
+    bit_write_uint8(outbuf, HUFF_TABLE_VERSION);
+    bit_write_uint8(outbuf, table->id);
+    canon_write_lengths(outbuf, table->code_lengths);
+    bit_write_close(&outbuf);
+    return true;
+}
+
+// function that frees a table made by huff_table_create() or huff_table_load()
+void huff_table_free(HuffTable **table) {
+    if (*table != NULL) {
+        free(*table);
+        *table = NULL;
+    }
+}
@@ -0,0 +1,156 @@
+#include "canon.h"
+#include "histogram.h"
+#include "libhuff.h"
+
+#include <getopt.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// the size of the pieces a sample is read in
+#define TRAIN_BUFFER_SIZE (64 * 1024)
+
+// the longest code a trained table has unless -L says otherwise, so every
+// code is decoded with one lookup in the primary decode table
+#define TRAIN_DEFAULT_LENGTH 11
+
+/*
+* The built-in tables in hufftable.c were printed with -c from these samples
+* of a Debian system, with the default maxbits:
+*   text    -n 1: /usr/share/common-licenses/{Apache-2.0,GFDL-1.3,GPL-3,LGPL-3}
+*   json    -n 2: /usr/share/iso-codes/json/iso_{639-2,639-3,3166-1,3166-2,4217}.json,
+*                 compacted first (python3 -m json.tool --compact --no-ensure-ascii),
+*                 since JSON on the wire has no indentation to spend short codes on
+*   source  -n 3: the .c and .h files of this program
+*/
+
+// function that prints the usage message
+void print_help(void) {
+    fprintf(stdout, "Usage: hufftrain -i sample [-i sample ...] -o table\n"
+                    "       hufftrain -n id -i sample -o table\n"
+                    "       hufftrain -L maxbits -i sample -o table\n"
+                    "       hufftrain -c -n id -i sample -o file\n"
+                    "       hufftrain -h\n"
+                    "A table has an id from %d to 255 (%d without -n); give it to huff and\n"
+                    "dehuff with -t.  -c prints the table as C source for a built-in table.\n",
+        HUFF_TABLE_FIRST_TRAINED, HUFF_TABLE_FIRST_TRAINED);
+}
+
+// function that adds the bytes of a file to the histogram
+bool count_file(const char *finame, uint64_t *histogram) {
+    FILE *fin = strcmp(finame, "-") == 0 ? stdin : fopen(finame, "r");
+    if (fin == NULL) {
+        return false;
+    }
+    static uint8_t buffer[TRAIN_BUFFER_SIZE];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), fin)) > 0) {
+        histogram_count(buffer, n, histogram);
+    }
+    bool ok = !ferror(fin);
+    if (fin != stdin) {
+        fclose(fin);
+    }
+    return ok;
+}
+
+// function that prints the table as an initializer of a HuffTable
+bool print_table(const HuffTable *table, const char *foname) {
+    FILE *fout = fopen(foname, "w");
+    if (fout == NULL) {
+        return false;
+    }
+    fprintf(fout, "    { %u,\n        {", table->id);
+    for (int i = 0; i < 256; ++i) {
+        fprintf(fout, "%s%u,", i % 16 == 0 ? "\n            " : " ", table->code_lengths[i]);
+    }
+    fprintf(fout, "\n        },\n        {");
+    for (int i = 0; i < 256; ++i) {
+        fprintf(fout, "%s0x%04" PRIx64 ",", i % 8 == 0 ? "\n            " : " ", table->codes[i]);
+    }
+    fprintf(fout, "\n        } },\n");
+    return fclose(fout) == 0;
+}
+
+// the main function
+int main(int argc, char **argv) {
+    // defining option to use in getopt()
+    int option;
+    // the name of the table file
+    const char *foname = NULL;
+    // the table's id
+    unsigned long id = HUFF_TABLE_FIRST_TRAINED;
+    // the longest code length in the table
+    unsigned long max_length = TRAIN_DEFAULT_LENGTH;
+    // whether to print C source instead of a table file
+    bool c_source = false;
+    // the byte counts of every sample
+    uint64_t histogram[256] = { 0 };
+    // the number of samples
+    int samples = 0;
+    // the end of a number given on the command line
+    char *end;
+    // while the user provides an option
+    while ((option = getopt(argc, argv, "hi:o:n:L:c")) != -1) {
+        // checking the options that were provided (using switch)
+        switch (option) {
+        // if the option was 'h' print the help message
+        case 'h': print_help(); return 0;
+        // if the option was 'i' count the bytes of a sample
+        case 'i':
+            if (!count_file(optarg, histogram)) {
+                fprintf(stderr, "Error reading sample %s\n", optarg);
+                return 1;
+            }
+            ++samples;
+            break;
+        // if the option was 'o' write the table to this file
+        case 'o': foname = optarg; break;
+        // if the option was 'n' give the table that id
+        case 'n':
+            id = strtoul(optarg, &end, 10);
+            if (*end != '\0' || id < 1 || id > 255) {
+                fprintf(stderr, "id must be between 1 and 255\n");
+                print_help();
+                return 1;
+            }
+            break;
+        // if the option was 'L' limit the code lengths
+        case 'L':
+            max_length = strtoul(optarg, &end, 10);
+            if (*end != '\0' || max_length < 8 || max_length > CANON_MAX_LENGTH) {
+                fprintf(stderr, "maxbits must be between 8 and %d\n", CANON_MAX_LENGTH);
+                print_help();
+                return 1;
+            }
+            break;
+        // if the option was 'c' print C source
+        case 'c': c_source = true; break;
+            // the default case it to break
+        default: return 1; break;
+        } // end of switch
+    } // end of while loop
+
+    if (samples == 0 || foname == NULL) {
+        fprintf(stderr, "a sample and a table file are required\n");
+        print_help();
+        return 1;
+    }
+    // the ids below the first trained one belong to the built-in tables
+    if (!c_source && id < HUFF_TABLE_FIRST_TRAINED) {
+        fprintf(stderr, "id must be between %d and 255\n", HUFF_TABLE_FIRST_TRAINED);
+        return 1;
+    }
+    HuffTable *table = huff_table_create(histogram, (uint8_t) id, (uint8_t) max_length);
+    if (table == NULL) {
+        fprintf(stderr, "Error: out of memory\n");
+        return 1;
+    }
+    bool ok = c_source ? print_table(table, foname) : huff_table_save(table, foname);
+    if (!ok) {
+        fprintf(stderr, "Error writing %s\n", foname);
+    }
+    huff_table_free(&table);
+    return ok ? 0 : 1;
+} // end of main
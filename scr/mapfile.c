@@ -0,0 +1,81 @@
+#include "mapfile.h"
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+struct MappedFile {
+    uint8_t *data;
+    uint64_t size;
+};
+
+// function that maps size bytes of fd and returns NULL when that is not possible
+static MappedFile *map_create(int fd, uint64_t size, int prot) {
+    if (size == 0 || size > SIZE_MAX) {
+        return NULL;
+    }
+    MappedFile *map = (MappedFile *) calloc(1, sizeof(MappedFile));
+    if (map == NULL) {
+        return NULL;
+    }
+    void *data = mmap(NULL, (size_t) size, prot, MAP_SHARED, fd, 0);
+    if (data == MAP_FAILED) {
+        free(map);
+        return NULL;
+    }
+    map->data = (uint8_t *) data;
+    map->size = size;
+    return map;
+}
+
+// function that maps a regular file for reading, front to back
+MappedFile *map_open_read(const char *filename) {
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        return NULL;
+    }
+    struct stat st;
+    MappedFile *map = NULL;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode)) {
+        map = map_create(fd, (uint64_t) st.st_size, PROT_READ);
+    }
+    // the mapping stays valid without the descriptor
+    close(fd);
+    if (map != NULL) {
+        // the pages are read in order, so the kernel can read ahead aggressively
+        madvise(map->data, (size_t) map->size, MADV_SEQUENTIAL);
+    }
+    return map;
+}
+
+// function that sets the regular file fd to size bytes and maps it for writing
+MappedFile *map_open_write(int fd, uint64_t size) {
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || size == 0 || size > INT64_MAX
+        || ftruncate(fd, (off_t) size) != 0) {
+        return NULL;
+    }
+    return map_create(fd, size, PROT_READ | PROT_WRITE);
+}
+
+// function that unmaps the file; written pages go back to the file through the page cache
+void map_close(MappedFile **map) {
+    if (*map != NULL) {
+        munmap((*map)->data, (size_t) (*map)->size);
+        free(*map);
+        *map = NULL;
+    }
+}
+
+// function that returns the first byte of the mapped file
+uint8_t *map_data(MappedFile *map) {
+    return map->data;
+}
+
+// function that returns the number of mapped bytes
+uint64_t map_size(MappedFile *map) {
+    return map->size;
+}
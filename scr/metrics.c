@@ -0,0 +1,174 @@
+#include "metrics.h"
+
+#include "arena.h"
+#include "node.h"
+#include "nodearena.h"
+#include "pq.h"
+#include "timer.h"
+
+#include <linux/perf_event.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// one hardware counter and its name in the record
+typedef struct MetricsCounter {
+    const char *name;
+    uint32_t type;
+    uint64_t config;
+} MetricsCounter;
+
+static const MetricsCounter metrics_counters[] = {
+    { "cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+    { "instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+    { "branches", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_INSTRUCTIONS },
+    { "branch_misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+    { "l1d_misses", PERF_TYPE_HW_CACHE,
+        PERF_COUNT_HW_CACHE_L1D | PERF_COUNT_HW_CACHE_OP_READ << 8
+            | PERF_COUNT_HW_CACHE_RESULT_MISS << 16 },
+    { "llc_misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+};
+
+#define METRICS_NUM_COUNTERS (sizeof(metrics_counters) / sizeof(metrics_counters[0]))
+
+struct Metrics {
+    // the counters' file descriptors, -1 for those the kernel refused
+    int fds[METRICS_NUM_COUNTERS];
+    uint64_t counts[METRICS_NUM_COUNTERS];
+    // the clocks and allocation counters at the start, then what was used
+    uint64_t wall_ns;
+    uint64_t cpu_ns;
+    uint64_t node_allocations;
+    uint64_t pq_allocations;
+    uint64_t arena_chunks;
+};
+
+// function that opens a disabled counter of the calling thread and the
+// threads it starts, in user space only; it returns -1 when it is refused
+static int metrics_open_counter(const MetricsCounter *counter) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = counter->type;
+    attr.config = counter->config;
+    attr.disabled = 1;
+    attr.inherit = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    // the times tell how long the counter ran when the hardware is shared
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return (int) syscall(SYS_perf_event_open, &attr, 0, -1, -1, PERF_FLAG_FD_CLOEXEC);
+}
+
+// function that starts measuring a run
+Metrics *metrics_start(void) {
+    Metrics *metrics = (Metrics *) calloc(1, sizeof(Metrics));
+    if (metrics == NULL) {
+        return NULL;
+    }
+    for (size_t i = 0; i < METRICS_NUM_COUNTERS; ++i) {
+        metrics->fds[i] = metrics_open_counter(&metrics_counters[i]);
+    }
+    metrics->node_allocations = node_heap_allocations();
+    metrics->pq_allocations = pq_heap_allocations();
+    metrics->arena_chunks = arena_heap_allocations();
+    metrics->cpu_ns = timer_process_cpu_ns();
+    metrics->wall_ns = timer_now_ns();
+    for (size_t i = 0; i < METRICS_NUM_COUNTERS; ++i) {
+        if (metrics->fds[i] >= 0) {
+            ioctl(metrics->fds[i], PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+    return metrics;
+}
+
+// function that stops measuring the run and reads the counters; a counter
+// that only ran part of the time is scaled up to the whole time
+void metrics_stop(Metrics *metrics) {
+    for (size_t i = 0; i < METRICS_NUM_COUNTERS; ++i) {
+        if (metrics->fds[i] >= 0) {
+            ioctl(metrics->fds[i], PERF_EVENT_IOC_DISABLE, 0);
+        }
+    }
+    metrics->wall_ns = timer_now_ns() - metrics->wall_ns;
+    metrics->cpu_ns = timer_process_cpu_ns() - metrics->cpu_ns;
+    metrics->node_allocations = node_heap_allocations() - metrics->node_allocations;
+    metrics->pq_allocations = pq_heap_allocations() - metrics->pq_allocations;
+    metrics->arena_chunks = arena_heap_allocations() - metrics->arena_chunks;
+    for (size_t i = 0; i < METRICS_NUM_COUNTERS; ++i) {
+        // the count, the time enabled and the time running
+        uint64_t values[3];
+        if (metrics->fds[i] < 0) {
+            continue;
+        }
+        if (read(metrics->fds[i], values, sizeof(values)) != (ssize_t) sizeof(values)
+            || values[2] == 0) {
+            // a counter that never ran has nothing to report
+            close(metrics->fds[i]);
+            metrics->fds[i] = -1;
+            continue;
+        }
+        metrics->counts[i] = values[2] < values[1]
+                                 ? (uint64_t) ((double) values[0] * (double) values[1]
+                                               / (double) values[2])
+                                 : values[0];
+    }
+}
+
+// function that writes the run's record to path as one line of JSON
+bool metrics_write(const Metrics *metrics, const char *path, const char *tool,
+    const HuffStats *stats) {
+    FILE *f = fopen(path, "w");
+    if (f == NULL) {
+        return false;
+    }
+    // the peak resident set of the process, which Linux gives in kilobytes
+    struct rusage usage;
+    uint64_t peak_rss = getrusage(RUSAGE_SELF, &usage) == 0 ? (uint64_t) usage.ru_maxrss * 1024 : 0;
+    fprintf(f,
+        "{\"tool\":\"%s\",\"input_bytes\":%" PRIu64 ",\"output_bytes\":%" PRIu64
+        ",\"blocks\":%" PRIu64 ",\"wall_ns\":%" PRIu64 ",\"cpu_ns\":%" PRIu64,
+        tool, stats->input_bytes, stats->output_bytes, stats->blocks, metrics->wall_ns,
+        metrics->cpu_ns);
+    fprintf(f, ",\"stage_ns\":{");
+    for (int s = 0; s < HUFF_NUM_STAGES; ++s) {
+        fprintf(f, "%s\"%s\":%" PRIu64, s ? "," : "", huff_stage_name((HuffStage) s),
+            stats->wall_ns[s]);
+    }
+    fprintf(f, "},\"stage_cpu_ns\":{");
+    for (int s = 0; s < HUFF_NUM_STAGES; ++s) {
+        fprintf(f, "%s\"%s\":%" PRIu64, s ? "," : "", huff_stage_name((HuffStage) s),
+            stats->cpu_ns[s]);
+    }
+    fprintf(f,
+        "},\"peak_rss_bytes\":%" PRIu64 ",\"heap_allocations\":{\"node_create\":%" PRIu64
+        ",\"enqueue\":%" PRIu64 ",\"arena_chunks\":%" PRIu64 "},\"counters\":{",
+        peak_rss, metrics->node_allocations, metrics->pq_allocations, metrics->arena_chunks);
+    bool first = true;
+    for (size_t i = 0; i < METRICS_NUM_COUNTERS; ++i) {
+        if (metrics->fds[i] >= 0) {
+            fprintf(f, "%s\"%s\":%" PRIu64, first ? "" : ",", metrics_counters[i].name,
+                metrics->counts[i]);
+            first = false;
+        }
+    }
+    fprintf(f, "}}\n");
+    return fclose(f) == 0;
+}
+
+// function that closes the counters and frees the metrics
+void metrics_free(Metrics **metrics) {
+    if (*metrics != NULL) {
+        for (size_t i = 0; i < METRICS_NUM_COUNTERS; ++i) {
+            if ((*metrics)->fds[i] >= 0) {
+                close((*metrics)->fds[i]);
+            }
+        }
+        free(*metrics);
+        *metrics = NULL;
+    }
+}
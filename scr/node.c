@@ -1,16 +1,17 @@
 #include "node.h"
 
+#include "nodearena.h"
+
+#include <stdatomic.h>
 #include <stdio.h>
 #include <stdlib.h>
 
+// the number of nodes node_create() has taken from the heap
+static atomic_uint_fast64_t node_allocations;
+
 // all the functions in this file are written based on the sudo code given in asgn8.pdf
-// function that creates the node
-Node *node_create(uint8_t symbol, uint32_t weight) {
-    // allocate memory for the new node
-    Node *new_node = (Node *) calloc(1, sizeof(Node));
-    if (new_node == NULL) {
-        return NULL;
-    }
+// function that sets up the fields of a new node
+static Node *node_init(Node *new_node, uint8_t symbol, uint32_t weight) {
     // assign the given symbol to the new node
     new_node->symbol = symbol;
     // assign the given weight to the new node
@@ -27,19 +28,55 @@ Node *node_create(uint8_t symbol, uint32_t weight) {
     return new_node;
 }
 
-// function that frees all the memory used to allocate the node
+// function that creates the node
+Node *node_create(uint8_t symbol, uint32_t weight) {
+    // allocate memory for the new node
+    Node *new_node = (Node *) calloc(1, sizeof(Node));
+    if (new_node == NULL) {
+        return NULL;
+    }
+    atomic_fetch_add_explicit(&node_allocations, 1, memory_order_relaxed);
+    return node_init(new_node, symbol, weight);
+}
+
+// function that returns how many nodes node_create() has taken from the heap
+uint64_t node_heap_allocations(void) {
+    return atomic_load(&node_allocations);
+}
+
+// function that creates the node in an arena; it is released with the arena,
+// never with node_free()
+Node *node_create_arena(Arena *arena, uint8_t symbol, uint32_t weight) {
+    Node *new_node = (Node *) arena_alloc(arena, sizeof(Node));
+    if (new_node == NULL) {
+        return NULL;
+    }
+    return node_init(new_node, symbol, weight);
+}
+
+// function that frees the node and its children, and sets the pointer to NULL
 void node_free(Node **node) {
-    // check if node is not NULL
-    if (*node != NULL) {
-        // using recursion
-        // free left node
-        node_free(&(*node)->left);
-        // free right node
-        node_free(&(*node)->right);
-        free(*node);
-        // set the pointer to NULL
-        *node = NULL;
+    // the tree is walked without recursion, so deep trees are safe too
+    node_free_tree(node);
+}
+
+// function that frees a whole tree made with node_create(), without recursion
+void node_free_tree(Node **tree) {
+    Node *node = *tree;
+    while (node != NULL) {
+        if (node->left != NULL) {
+            // rotate the left child up, so the tree becomes a list along the right
+            Node *left = node->left;
+            node->left = left->right;
+            left->right = node;
+            node = left;
+        } else {
+            Node *right = node->right;
+            free(node);
+            node = right;
+        }
     }
+    *tree = NULL;
 }
 
 // fucntion that prints the node
@@ -0,0 +1,127 @@
+#include "pool.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+struct Pool {
+    pthread_mutex_t lock;
+    // signalled when a job is queued or the pool shuts down
+    pthread_cond_t work;
+    // signalled when a job finishes
+    pthread_cond_t finished;
+    // jobs waiting for a worker, oldest first
+    PoolJob *head;
+    PoolJob *tail;
+    bool stopping;
+    unsigned num_threads;
+    pthread_t threads[POOL_MAX_THREADS];
+};
+
+// function that every worker thread runs: take the oldest job and run it
+static void *pool_worker(void *arg) {
+    Pool *pool = (Pool *) arg;
+    pthread_mutex_lock(&pool->lock);
+    while (true) {
+        while (pool->head == NULL && !pool->stopping) {
+            pthread_cond_wait(&pool->work, &pool->lock);
+        }
+        if (pool->head == NULL) {
+            // stopping and nothing left to do
+            break;
+        }
+        PoolJob *job = pool->head;
+        pool->head = job->next;
+        if (pool->head == NULL) {
+            pool->tail = NULL;
+        }
+        // run the job without holding the lock
+        pthread_mutex_unlock(&pool->lock);
+        job->run(job->arg);
+        pthread_mutex_lock(&pool->lock);
+        job->done = true;
+        pthread_cond_broadcast(&pool->finished);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+// function that starts a pool with the given number of worker threads
+Pool *pool_create(unsigned threads) {
+    if (threads < 1 || threads > POOL_MAX_THREADS) {
+        return NULL;
+    }
+    Pool *pool = (Pool *) calloc(1, sizeof(Pool));
+    if (pool == NULL) {
+        return NULL;
+    }
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->work, NULL);
+    pthread_cond_init(&pool->finished, NULL);
+    for (unsigned i = 0; i < threads; ++i) {
+        // a pool that could not start every thread runs with the ones it has
+        if (pthread_create(&pool->threads[i], NULL, pool_worker, pool) != 0) {
+            break;
+        }
+        pool->num_threads++;
+    }
+    if (pool->num_threads == 0) {
+        pool_free(&pool);
+        return NULL;
+    }
+    return pool;
+}
+
+// function that finishes the queued jobs, stops the workers and frees the pool
+void pool_free(Pool **pool) {
+    if (*pool == NULL) {
+        return;
+    }
+    pthread_mutex_lock(&(*pool)->lock);
+    (*pool)->stopping = true;
+    pthread_cond_broadcast(&(*pool)->work);
+    pthread_mutex_unlock(&(*pool)->lock);
+    for (unsigned i = 0; i < (*pool)->num_threads; ++i) {
+        pthread_join((*pool)->threads[i], NULL);
+    }
+    pthread_cond_destroy(&(*pool)->finished);
+    pthread_cond_destroy(&(*pool)->work);
+    pthread_mutex_destroy(&(*pool)->lock);
+    free(*pool);
+    *pool = NULL;
+}
+
+// function that queues job to call run(arg) on a worker thread
+void pool_submit(Pool *pool, PoolJob *job, void (*run)(void *arg), void *arg) {
+    job->run = run;
+    job->arg = arg;
+    job->done = false;
+    job->next = NULL;
+    pthread_mutex_lock(&pool->lock);
+    if (pool->tail == NULL) {
+        pool->head = job;
+    } else {
+        pool->tail->next = job;
+    }
+    pool->tail = job;
+    pthread_cond_signal(&pool->work);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+// function that blocks until job has finished
+void pool_wait_job(Pool *pool, PoolJob *job) {
+    pthread_mutex_lock(&pool->lock);
+    while (!job->done) {
+        pthread_cond_wait(&pool->finished, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+}
+
+// function that returns the number of online cores, 1 to POOL_MAX_THREADS
+unsigned pool_online_cores(void) {
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cores < 1) {
+        return 1;
+    }
+    return cores > POOL_MAX_THREADS ? POOL_MAX_THREADS : (unsigned) cores;
+}
@@ -1,8 +1,14 @@
 #include "pq.h"
 
 #include "node.h"
+#include "nodearena.h"
 
+#include <stdatomic.h>
 #include <stdio.h>
+
+// the number of list elements enqueue() has taken from the heap
+static atomic_uint_fast64_t pq_allocations;
+
 typedef struct ListElement ListElement;
 struct ListElement {
     Node *tree;
@@ -11,6 +17,8 @@ struct ListElement {
 
 struct PriorityQueue {
     ListElement *list;
+    // where the list elements come from, NULL for the heap
+    Arena *arena;
 };
 
 // function that creates priority queue object and returns a pointer
@@ -27,6 +35,17 @@ PriorityQueue *pq_create(void) {
     return pq;
 }
 
+// function that creates a priority queue whose list elements come from the
+// arena; its trees should be made with node_create_arena() and are released
+// with the arena, not by pq_free()
+PriorityQueue *pq_create_arena(Arena *arena) {
+    PriorityQueue *pq = pq_create();
+    if (pq != NULL) {
+        pq->arena = arena;
+    }
+    return pq;
+}
+
 // function that free the priority queue
 void pq_free(PriorityQueue **q) {
     // if the priority queue is NULL
@@ -34,12 +53,14 @@ void pq_free(PriorityQueue **q) {
         // function returns
         return;
     }
-    // iterate over the priority queue and free each node
+    // iterate over the priority queue and free each tree and element
     ListElement *e = (*q)->list;
-    while (e != NULL) {
-        // freeing the nodes
-        node_free(&(e->tree));
-        e = e->next;
+    while (e != NULL && (*q)->arena == NULL) {
+        ListElement *next = e->next;
+        // freeing the trees
+        node_free_tree(&(e->tree));
+        free(e);
+        e = next;
     }
     // freeing the priority queue
     free(*q);
@@ -89,11 +110,17 @@ bool pq_less_than(ListElement *e1, ListElement *e2) {
 // fucntion that enqueue
 void enqueue(PriorityQueue *q, Node *tree) {
     // allocate a new ListElement
-    ListElement *new_element = (ListElement *) calloc(1, sizeof(ListElement));
+    ListElement *new_element = q->arena != NULL
+                                   ? (ListElement *) arena_alloc(q->arena, sizeof(ListElement))
+                                   : (ListElement *) calloc(1, sizeof(ListElement));
     if (new_element == NULL) {
         // if allocation fails return
         return;
     }
+    if (q->arena == NULL) {
+        atomic_fetch_add_explicit(&pq_allocations, 1, memory_order_relaxed);
+    }
+    new_element->next = NULL;
     // set the tree field to the value of the tree function parameter
     new_element->tree = tree;
     // if the queue is empty
@@ -130,8 +157,10 @@ Node *dequeue(PriorityQueue *q) {
     Node *dequeued_tree = front->tree;
     // update the queue to remove the front element
     q->list = front->next;
-    // free the ListElement (but not the tree itself)
-    free(front);
+    // free the ListElement (but not the tree itself); arena elements stay put
+    if (q->arena == NULL) {
+        free(front);
+    }
     // return the dequeued tree
     return dequeued_tree;
 }
@@ -161,3 +190,8 @@ void pq_print(PriorityQueue *q) {
     // print a final separator at the end
     printf("=============================================\n");
 }
+
+// function that returns how many list elements enqueue() has taken from the heap
+uint64_t pq_heap_allocations(void) {
+    return atomic_load(&pq_allocations);
+}
@@ -0,0 +1,40 @@
+#include "timer.h"
+
+#include <time.h>
+
+// function that reads one clock in nanoseconds
+static uint64_t timer_read(clockid_t clock) {
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000u + (uint64_t) ts.tv_nsec;
+}
+
+// function that returns a monotonic time in nanoseconds, for measuring intervals
+uint64_t timer_now_ns(void) {
+    return timer_read(CLOCK_MONOTONIC);
+}
+
+// function that returns the CPU time the calling thread has used
+uint64_t timer_thread_cpu_ns(void) {
+    return timer_read(CLOCK_THREAD_CPUTIME_ID);
+}
+
+// function that returns the CPU time all threads of the process have used
+uint64_t timer_process_cpu_ns(void) {
+    return timer_read(CLOCK_PROCESS_CPUTIME_ID);
+}
+
+// function that returns both clocks now
+TimerMark timer_mark(void) {
+    TimerMark mark = { timer_now_ns(), timer_thread_cpu_ns() };
+    return mark;
+}
+
+// function that adds the time since mark to *wall_ns and *cpu_ns and moves
+// the mark to now
+void timer_lap(TimerMark *mark, uint64_t *wall_ns, uint64_t *cpu_ns) {
+    TimerMark now = timer_mark();
+    *wall_ns += now.wall_ns - mark->wall_ns;
+    *cpu_ns += now.cpu_ns - mark->cpu_ns;
+    *mark = now;
+}
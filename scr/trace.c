@@ -0,0 +1,151 @@
+#include "trace.h"
+
+#include "timer.h"
+
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// the events a thread's buffer has room for at first
+#define TRACE_INITIAL_EVENTS 1024
+
+// one stage of one block; name is a string that outlives the trace
+typedef struct TraceEvent {
+    const char *name;
+    uint64_t block;
+    uint64_t start_ns;
+    uint64_t end_ns;
+} TraceEvent;
+
+typedef struct TraceBuffer TraceBuffer;
+
+// the spans one thread recorded, only ever touched by that thread until the
+// trace is written
+struct TraceBuffer {
+    TraceBuffer *next;
+    unsigned thread;
+    size_t count;
+    size_t capacity;
+    TraceEvent *events;
+};
+
+// whether a trace is being recorded
+static atomic_bool trace_on;
+// the buffers of every thread that recorded a span, newest first
+static _Atomic(TraceBuffer *) trace_buffers;
+// the number of threads that recorded a span, which numbers the next one
+static atomic_uint trace_threads;
+// counts traces, so a thread can tell its buffer belongs to an earlier one
+static atomic_uint trace_generation;
+// the time the trace started, every span is relative to it
+static uint64_t trace_origin;
+
+static _Thread_local TraceBuffer *trace_local;
+static _Thread_local unsigned trace_local_generation;
+
+// function that starts recording a trace
+void trace_start(void) {
+    atomic_fetch_add(&trace_generation, 1);
+    trace_origin = timer_now_ns();
+    atomic_store(&trace_on, true);
+}
+
+// function that returns the calling thread's buffer, making it on the
+// thread's first span of the trace; it returns NULL when out of memory
+static TraceBuffer *trace_buffer(void) {
+    unsigned generation = atomic_load_explicit(&trace_generation, memory_order_relaxed);
+    if (trace_local != NULL && trace_local_generation == generation) {
+        return trace_local;
+    }
+    TraceBuffer *buffer = (TraceBuffer *) calloc(1, sizeof(TraceBuffer));
+    if (buffer == NULL) {
+        return NULL;
+    }
+    buffer->thread = atomic_fetch_add(&trace_threads, 1);
+    // pushing the buffer on the list without a lock
+    buffer->next = atomic_load(&trace_buffers);
+    while (!atomic_compare_exchange_weak(&trace_buffers, &buffer->next, buffer)) {
+    }
+    trace_local = buffer;
+    trace_local_generation = generation;
+    return buffer;
+}
+
+// function that records that the stage name of block ran from start_ns to end_ns
+void trace_span(const char *name, uint64_t block, uint64_t start_ns, uint64_t end_ns) {
+    if (!atomic_load_explicit(&trace_on, memory_order_relaxed)) {
+        return;
+    }
+    TraceBuffer *buffer = trace_buffer();
+    if (buffer == NULL) {
+        return;
+    }
+    if (buffer->count == buffer->capacity) {
+        size_t capacity = buffer->capacity ? 2 * buffer->capacity : TRACE_INITIAL_EVENTS;
+        TraceEvent *events
+            = (TraceEvent *) realloc(buffer->events, capacity * sizeof(TraceEvent));
+        if (events == NULL) {
+            // the span is lost, the run goes on
+            return;
+        }
+        buffer->events = events;
+        buffer->capacity = capacity;
+    }
+    TraceEvent *event = &buffer->events[buffer->count++];
+    event->name = name;
+    event->block = block;
+    event->start_ns = start_ns;
+    event->end_ns = end_ns;
+}
+
+// function that prints a time relative to the trace's start in microseconds,
+// the unit of the format
+static void trace_print_us(FILE *f, uint64_t ns) {
+    fprintf(f, "%" PRIu64 ".%03u", ns / 1000, (unsigned) (ns % 1000));
+}
+
+// function that stops recording and writes every thread's spans to path as
+// complete events ("ph":"X"), with a name for every thread; the buffers
+// are freed either way
+bool trace_write(const char *path) {
+    atomic_store(&trace_on, false);
+    TraceBuffer *buffer = atomic_exchange(&trace_buffers, NULL);
+    atomic_store(&trace_threads, 0);
+    FILE *f = fopen(path, "w");
+    if (f != NULL) {
+        fprintf(f, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+    }
+    bool first = true;
+    while (buffer != NULL) {
+        TraceBuffer *next = buffer->next;
+        if (f != NULL) {
+            fprintf(f,
+                "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,"
+                "\"args\":{\"name\":\"thread %u\"}}",
+                first ? "" : ",", buffer->thread, buffer->thread);
+            first = false;
+        }
+        for (size_t i = 0; f != NULL && i < buffer->count; ++i) {
+            const TraceEvent *event = &buffer->events[i];
+            // a span that began before the trace is cut at its start
+            uint64_t start = event->start_ns > trace_origin ? event->start_ns : trace_origin;
+            fprintf(f, ",\n{\"name\":\"%s\",\"cat\":\"huff\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":",
+                event->name, buffer->thread);
+            trace_print_us(f, start - trace_origin);
+            fprintf(f, ",\"dur\":");
+            trace_print_us(f, event->end_ns > start ? event->end_ns - start : 0);
+            if (event->block != TRACE_NO_BLOCK) {
+                fprintf(f, ",\"args\":{\"block\":%" PRIu64 "}", event->block);
+            }
+            fprintf(f, "}");
+        }
+        free(buffer->events);
+        free(buffer);
+        buffer = next;
+    }
+    if (f == NULL) {
+        return false;
+    }
+    fprintf(f, "\n]}\n");
+    return fclose(f) == 0;
+}
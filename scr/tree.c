@@ -0,0 +1,268 @@
+#include "tree.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// the child index of a leaf while a flat tree is being built
+#define TREE_NONE 0xffff
+
+// function that checks if the first tree is less than the second tree,
+// the same order as pq_less_than()
+bool tree_less_than(const Node *n1, const Node *n2) {
+    if (n1->weight != n2->weight) {
+        return n1->weight < n2->weight;
+    }
+    return n1->symbol < n2->symbol;
+}
+
+// function that sorts leaves for qsort()
+static int tree_compare(const void *p1, const void *p2) {
+    const Node *n1 = *(const Node *const *) p1;
+    const Node *n2 = *(const Node *const *) p2;
+    return tree_less_than(n1, n2) ? -1 : tree_less_than(n2, n1) ? 1 : 0;
+}
+
+// function that sets up a node in place
+static Node *tree_node(Node *node, uint8_t symbol, uint32_t weight, Node *left, Node *right) {
+    node->symbol = symbol;
+    node->weight = weight;
+    node->code = 0;
+    node->code_length = 0;
+    node->left = left;
+    node->right = right;
+    return node;
+}
+
+// function that puts the symbols of the non-zero counts of histogram into
+// weights and symbols, sorted by tree_less_than(), and returns how many there are
+static uint16_t tree_sort_leaves(const uint32_t *histogram, uint32_t *weights, uint8_t *symbols) {
+    Node keys[256];
+    Node *leaves[256];
+    uint16_t n = 0;
+    for (int i = 0; i < 256; ++i) {
+        if (histogram[i] > 0) {
+            keys[n].symbol = (uint8_t) i;
+            keys[n].weight = histogram[i];
+            leaves[n] = &keys[n];
+            ++n;
+        }
+    }
+    qsort(leaves, n, sizeof(Node *), tree_compare);
+    for (uint16_t i = 0; i < n; ++i) {
+        weights[i] = leaves[i]->weight;
+        symbols[i] = leaves[i]->symbol;
+    }
+    return n;
+}
+
+// function that merges the n sorted leaves 0 .. n - 1 into the nodes n,
+// n + 1, ... and returns the root, taking nodes in the order the
+// PriorityQueue dequeues them.  Only merged nodes (symbol 0) and the leaf of
+// symbol 0 can tie fully.  enqueue() puts a new node in front of the nodes it
+// ties with, or second when they are at the front of the queue; the merged
+// nodes still come in order of weight, so only the ones of the newest weight
+// are moved.
+static uint16_t tree_merge(
+    uint16_t n, uint32_t *weights, uint8_t *symbols, uint16_t *left, uint16_t *right) {
+    for (uint16_t i = 0; i < n; ++i) {
+        left[i] = TREE_NONE;
+    }
+    // the second queue: the merged nodes that are not taken yet, in queue order
+    uint16_t queue[255];
+    uint16_t queue_front = 0;
+    uint16_t queue_back = 0;
+    uint16_t leaf_front = 0;
+    // the leaf of symbol 0, if there is one, and how many merged nodes of its
+    // weight come before it in the queue
+    uint16_t zero = TREE_NONE;
+    for (uint16_t i = 0; i < n; ++i) {
+        zero = symbols[i] == 0 ? i : zero;
+    }
+    uint16_t zero_rank = 0;
+    uint16_t next = n;
+    for (uint16_t m = 1; m < n; ++m) {
+        uint16_t pair[2];
+        for (int k = 0; k < 2; ++k) {
+            bool take_leaf = queue_front == queue_back;
+            if (!take_leaf && leaf_front < n) {
+                uint32_t leaf_weight = weights[leaf_front];
+                uint32_t merged_weight = weights[queue[queue_front]];
+                take_leaf = leaf_weight < merged_weight
+                            || (leaf_weight == merged_weight && leaf_front == zero
+                                && zero_rank == 0);
+            }
+            if (take_leaf) {
+                pair[k] = leaf_front++;
+            } else {
+                pair[k] = queue[queue_front++];
+                // a merged node that came before the leaf of symbol 0
+                if (zero_rank > 0 && weights[pair[k]] == weights[zero]) {
+                    --zero_rank;
+                }
+            }
+        }
+        uint32_t weight = weights[pair[0]] + weights[pair[1]];
+        weights[next] = weight;
+        symbols[next] = 0;
+        left[next] = pair[0];
+        right[next] = pair[1];
+        // the merged nodes of this weight are at the back of the queue
+        uint16_t group = queue_back;
+        while (group > queue_front && weights[queue[group - 1]] == weight) {
+            --group;
+        }
+        bool zero_ties = zero != TREE_NONE && leaf_front <= zero && weights[zero] == weight;
+        bool lighter = (leaf_front < n && weights[leaf_front] < weight)
+                       || (queue_front < queue_back && weights[queue[queue_front]] < weight);
+        uint16_t pos = group;
+        if (lighter) {
+            // in front of the nodes it ties with
+            zero_rank = (uint16_t) (zero_rank + zero_ties);
+        } else if (!(zero_ties && zero_rank == 0) && group < queue_back) {
+            // the ties are at the front and a merged node leads them: second
+            ++pos;
+            zero_rank = (uint16_t) (zero_rank + zero_ties);
+        }
+        // (when the leaf of symbol 0 leads the ties, second is right after it)
+        memmove(&queue[pos + 1], &queue[pos], (size_t) (queue_back - pos) * sizeof(uint16_t));
+        queue[pos] = next++;
+        ++queue_back;
+    }
+    return (uint16_t) (next - 1);
+}
+
+// function that builds the Huffman tree for the non-zero counts of histogram
+// in nodes (TREE_MAX_NODES of them) and returns its root, or NULL when every
+// count is zero; num_leaves is set to the number of symbols
+Node *tree_build(const uint32_t *histogram, Node *nodes, uint16_t *num_leaves) {
+    uint32_t weights[TREE_MAX_NODES];
+    uint8_t symbols[TREE_MAX_NODES];
+    uint16_t left[TREE_MAX_NODES];
+    uint16_t right[TREE_MAX_NODES];
+    uint16_t n = tree_sort_leaves(histogram, weights, symbols);
+    *num_leaves = n;
+    if (n == 0) {
+        return NULL;
+    }
+    uint16_t root = tree_merge(n, weights, symbols, left, right);
+    // children come before their parents, so one pass links the nodes
+    for (uint16_t i = 0; i <= root; ++i) {
+        bool leaf = left[i] == TREE_NONE;
+        tree_node(&nodes[i], symbols[i], weights[i], leaf ? NULL : &nodes[left[i]],
+            leaf ? NULL : &nodes[right[i]]);
+    }
+    return &nodes[root];
+}
+
+// function that lays out the tree below root breadth-first in tree; the
+// nodes are given in any order, a leaf has left[i] == TREE_NONE
+static void tree_layout(FlatTree *tree, uint16_t root, const uint16_t *left,
+    const uint16_t *right, const uint8_t *symbols) {
+    // order[p] is the node that goes to index p, children are appended in pairs
+    uint16_t order[TREE_MAX_NODES];
+    uint16_t count = 1;
+    order[0] = root;
+    for (uint16_t p = 0; p < count; ++p) {
+        uint16_t i = order[p];
+        if (left[i] == TREE_NONE) {
+            tree->nodes[p] = (uint16_t) (TREE_LEAF | symbols[i]);
+        } else {
+            tree->nodes[p] = count;
+            order[count++] = left[i];
+            order[count++] = right[i];
+        }
+    }
+    tree->num_nodes = count;
+}
+
+// function that builds the same Huffman tree as tree_build() as a FlatTree
+// and returns the number of symbols, or 0 (and no tree) when every count is zero
+uint16_t tree_build_flat(const uint32_t *histogram, FlatTree *tree) {
+    uint32_t weights[TREE_MAX_NODES];
+    uint8_t symbols[TREE_MAX_NODES];
+    uint16_t left[TREE_MAX_NODES];
+    uint16_t right[TREE_MAX_NODES];
+    uint16_t n = tree_sort_leaves(histogram, weights, symbols);
+    if (n == 0) {
+        tree->num_nodes = 0;
+        return 0;
+    }
+    uint16_t root = tree_merge(n, weights, symbols, left, right);
+    tree_layout(tree, root, left, right, symbols);
+    return n;
+}
+
+// function that reads a tree of num_leaves leaves written in post-order (a 1
+// bit and the symbol for a leaf, a 0 bit for an internal node) into tree and
+// returns false if the bits do not describe such a tree
+bool tree_read_flat(BitReader *inbuf, uint16_t num_leaves, FlatTree *tree) {
+    if (num_leaves == 0 || num_leaves > 256) {
+        return false;
+    }
+    uint8_t symbols[TREE_MAX_NODES];
+    uint16_t left[TREE_MAX_NODES];
+    uint16_t right[TREE_MAX_NODES];
+    // the nodes that still wait for a parent
+    uint16_t stack[TREE_MAX_NODES];
+    uint16_t top = 0;
+    uint16_t num_nodes = (uint16_t) (2 * num_leaves - 1);
+    for (uint16_t i = 0; i < num_nodes; ++i) {
+        if (bit_read_bit(inbuf) == 1) {
+            symbols[i] = bit_read_uint8(inbuf);
+            left[i] = TREE_NONE;
+        } else {
+            // an internal node needs two children waiting
+            if (top < 2) {
+                return false;
+            }
+            symbols[i] = 0;
+            right[i] = stack[--top];
+            left[i] = stack[--top];
+        }
+        stack[top++] = i;
+    }
+    // every node but the root must have a parent
+    if (top != 1) {
+        return false;
+    }
+    tree_layout(tree, stack[0], left, right, symbols);
+    return true;
+}
+
+// function that fills the code and code length of every symbol of the tree
+// (0 for symbols that are not in it); left appends a 0 and right a 1, and
+// the first bit is the least significant
+void tree_flat_codes(const FlatTree *tree, uint64_t *codes, uint8_t *code_lengths) {
+    for (int s = 0; s < 256; ++s) {
+        codes[s] = 0;
+        code_lengths[s] = 0;
+    }
+    // parents come before their children, so one pass in index order does it
+    uint64_t code[TREE_MAX_NODES];
+    uint8_t depth[TREE_MAX_NODES];
+    if (tree->num_nodes > 0) {
+        code[0] = 0;
+        depth[0] = 0;
+    }
+    for (uint16_t p = 0; p < tree->num_nodes; ++p) {
+        uint16_t node = tree->nodes[p];
+        if (node & TREE_LEAF) {
+            codes[node & 0xff] = code[p];
+            code_lengths[node & 0xff] = depth[p];
+        } else {
+            code[node] = code[p];
+            // a code deeper than 64 bits (only in a corrupt file) keeps its first 64 bits
+            code[node + 1] = depth[p] < 64 ? code[p] | (uint64_t) 1 << depth[p] : code[p];
+            depth[node] = depth[node + 1] = (uint8_t) (depth[p] + 1);
+        }
+    }
+}
+
+// function that decodes one symbol by walking the tree bit by bit
+uint8_t tree_flat_decode(const FlatTree *tree, BitReader *inbuf) {
+    uint16_t node = tree->nodes[0];
+    while (!(node & TREE_LEAF)) {
+        node = tree->nodes[node + bit_read_bit(inbuf)];
+    }
+    return (uint8_t) node;
+}
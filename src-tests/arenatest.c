@@ -0,0 +1,190 @@
+/*
+* File:     arenatest.c
+* Purpose:  Test arena.c and the objects that can be allocated in an arena
+*/
+
+#include "arena.h"
+#include "bitio_ext.h"
+#include "bitreader.h"
+#include "bitwriter.h"
+#include "canon.h"
+#include "dectable.h"
+#include "node.h"
+#include "nodearena.h"
+#include "pq.h"
+
+#include <assert.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NUM_CODES   3
+#define MESSAGE     5000
+#define NUM_PASSES  100
+
+// function that fills one of NUM_CODES complete sets of code lengths
+static void make_lengths(int which, uint8_t *code_lengths) {
+    memset(code_lengths, 0, 256);
+    if (which == 0) {
+        // every byte, 8 bits each
+        memset(code_lengths, 8, 256);
+    } else if (which == 1) {
+        // 16 symbols of 4 bits, short enough for the multi-symbol table
+        memset(code_lengths + 'a', 4, 16);
+    } else {
+        // lengths 1 to 14 and then two codes of 15 bits, which need sub-tables
+        for (int i = 0; i < 14; ++i) {
+            code_lengths[i * 3] = (uint8_t) (i + 1);
+        }
+        code_lengths[200] = 15;
+        code_lengths[201] = 15;
+    }
+}
+
+// function that encodes a message with the code and decodes it again, with
+// the writer, the reader and the decode table all in the arena
+static void round_trip(Arena *arena, int which, uint8_t *packed, size_t capacity) {
+    uint8_t code_lengths[256];
+    uint64_t codes[256];
+    make_lengths(which, code_lengths);
+    canon_assign(code_lengths, codes);
+    uint8_t symbols[256];
+    int num_symbols = 0;
+    for (int s = 0; s < 256; ++s) {
+        if (code_lengths[s] != 0) {
+            symbols[num_symbols++] = (uint8_t) s;
+        }
+    }
+    uint8_t *message = (uint8_t *) arena_alloc(arena, MESSAGE);
+    uint8_t *decoded = (uint8_t *) arena_alloc(arena, MESSAGE);
+    assert(message && decoded);
+    for (int i = 0; i < MESSAGE; ++i) {
+        message[i] = symbols[(i * 7 + i / 13) % num_symbols];
+    }
+
+    BitWriter *writer = bit_write_open_arena(arena, packed, capacity);
+    assert(writer);
+    for (int i = 0; i < MESSAGE; ++i) {
+        bit_write_bits(writer, codes[message[i]], code_lengths[message[i]]);
+    }
+    bit_write_close(&writer);
+    assert(writer == NULL);
+
+    DecodeTable *table = dt_create_from_codes_arena(arena, codes, code_lengths);
+    BitReader *reader = bit_read_open_arena(arena, packed, capacity);
+    assert(table && reader);
+    dt_decode(table, reader, decoded, MESSAGE);
+    assert(memcmp(message, decoded, MESSAGE) == 0);
+    // dropping the multi-symbol table does not free arena memory
+    dt_multi_enable(table, false);
+    dt_free(&table);
+    bit_read_close(&reader);
+    assert(table == NULL && reader == NULL);
+}
+
+int main(int argc, char **argv) {
+    /*
+    * Poor man's argument checking: is "-v" the first command-line argument?
+    * Ignore all other arguments.
+    */
+    bool verbose = argc > 1 && strcmp(argv[1], "-v") == 0;
+
+    if (!verbose)
+        printf("Use \"arenatest -v\" to print trace information.\n");
+
+    /*
+    * Allocations are aligned, and a reset hands out the same memory again.
+    */
+    Arena *arena = arena_create(1024);
+    assert(arena);
+    uint64_t before = arena_heap_allocations();
+    void *first[50];
+    for (int i = 0; i < 50; ++i) {
+        first[i] = arena_alloc(arena, (size_t) (i * 37 % 200 + 1));
+        assert(first[i]);
+        assert((uintptr_t) first[i] % sizeof(void *) == 0);
+        memset(first[i], i, (size_t) (i * 37 % 200 + 1));
+    }
+    uint64_t chunks = arena_heap_allocations() - before;
+    if (verbose)
+        printf("50 allocations took %" PRIu64 " chunks\n", chunks);
+    assert(chunks > 1);
+    for (int pass = 0; pass < 10; ++pass) {
+        arena_reset(arena);
+        for (int i = 0; i < 50; ++i) {
+            assert(arena_alloc(arena, (size_t) (i * 37 % 200 + 1)) == first[i]);
+        }
+    }
+    assert(arena_heap_allocations() - before == chunks);
+    // an allocation larger than a chunk gets a chunk of its own
+    assert(arena_alloc(arena, 5000));
+    arena_free(&arena);
+    assert(arena == NULL);
+
+    /*
+    * Trees and a priority queue in an arena are released all at once.
+    */
+    arena = arena_create(0);
+    assert(arena);
+    PriorityQueue *pq = pq_create_arena(arena);
+    assert(pq);
+    for (uint32_t w = 1; w <= 10; ++w) {
+        Node *leaf = node_create_arena(arena, (uint8_t) ('a' + w), w);
+        assert(leaf && leaf->left == NULL && leaf->right == NULL && leaf->weight == w);
+        enqueue(pq, leaf);
+    }
+    while (!pq_size_is_1(pq)) {
+        Node *left = dequeue(pq);
+        Node *right = dequeue(pq);
+        Node *parent = node_create_arena(arena, 0, left->weight + right->weight);
+        parent->left = left;
+        parent->right = right;
+        enqueue(pq, parent);
+    }
+    assert(dequeue(pq)->weight == 55);
+    pq_free(&pq);
+    arena_free(&arena);
+
+    /*
+    * A heap tree is freed without recursion, even when it is very deep.
+    */
+    Node *chain = node_create('x', 1);
+    for (int i = 0; i < 100000; ++i) {
+        Node *parent = node_create(0, 0);
+        parent->left = chain;
+        parent->right = node_create('y', 1);
+        chain = parent;
+    }
+    node_free_tree(&chain);
+    assert(chain == NULL);
+
+    /*
+    * Once the arena has grown, coding block after block does not touch the heap.
+    */
+    size_t capacity = MESSAGE * 2;
+    uint8_t *packed = (uint8_t *) malloc(capacity);
+    assert(packed);
+    arena = arena_create(0);
+    assert(arena);
+    for (int which = 0; which < NUM_CODES; ++which) {
+        arena_reset(arena);
+        round_trip(arena, which, packed, capacity);
+    }
+    before = arena_heap_allocations();
+    for (int pass = 0; pass < NUM_PASSES; ++pass) {
+        arena_reset(arena);
+        round_trip(arena, pass % NUM_CODES, packed, capacity);
+    }
+    if (verbose)
+        printf("%d passes took %" PRIu64 " chunks after the warm-up\n", NUM_PASSES,
+            arena_heap_allocations() - before);
+    assert(arena_heap_allocations() == before);
+    arena_free(&arena);
+    free(packed);
+
+    printf("arenatest, as it is, reports no errors\n");
+    return 0;
+}
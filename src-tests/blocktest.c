@@ -0,0 +1,119 @@
+/*
+* File:     blocktest.c
+* Purpose:  Test block.c
+*/
+
+#include "bitio_ext.h"
+#include "bitwriter.h"
+#include "block.h"
+
+#include <assert.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+int main(int argc, char **argv) {
+    /*
+    * Poor man's argument checking: is "-v" the first command-line argument?
+    * Ignore all other arguments.
+    */
+    bool verbose = argc > 1 && strcmp(argv[1], "-v") == 0;
+
+    if (!verbose)
+        printf("Use \"blocktest -v\" to print trace information.\n");
+
+    /*
+    * Write a container with three blocks of made-up compressed bytes.
+    */
+    uint32_t lengths[3] = { 1000, 4000000000u, 7 };
+    uint32_t compressed[3] = { 600, 5, 3 };
+
+    BitWriter *bw = bit_write_open("blocktest.out");
+    assert(bw);
+    BlockIndex *index = block_index_create();
+    assert(index);
+    assert(block_index_count(index) == 0);
+
+    block_write_file_header(bw, BLOCK_DEFAULT_SIZE);
+    uint64_t offset = BLOCK_FILE_HEADER_SIZE;
+    for (int i = 0; i < 3; ++i) {
+        assert(block_index_append(index, offset, lengths[i]));
+        block_write_header(bw, lengths[i], compressed[i]);
+        for (uint32_t j = 0; j < compressed[i]; ++j) {
+            bit_write_uint8(bw, (uint8_t) j);
+        }
+        offset += BLOCK_HEADER_SIZE + compressed[i];
+    }
+    block_write_end(bw);
+    block_index_write(bw, index);
+    bit_write_close(&bw);
+    block_index_free(&index);
+    assert(index == NULL);
+
+    /*
+    * Read the index back from the end of the file.  The total is larger
+    * than 32 bits can hold.
+    */
+    FILE *f = fopen("blocktest.out", "r");
+    assert(f);
+    index = block_index_read(f);
+    assert(index);
+    assert(block_index_count(index) == 3);
+    assert(block_index_total(index) == 1000 + 4000000000ull + 7);
+    offset = BLOCK_FILE_HEADER_SIZE;
+    for (uint64_t i = 0; i < 3; ++i) {
+        if (verbose)
+            printf("block %" PRIu64 " at offset %" PRIu64 "\n", i, block_index_offset(index, i));
+        assert(block_index_offset(index, i) == offset);
+        offset += BLOCK_HEADER_SIZE + compressed[i];
+    }
+    block_index_free(&index);
+
+    /*
+    * The file ends with the end marker, the offsets and the trailer.
+    */
+    assert(fseek(f, 0, SEEK_END) == 0);
+    assert(ftell(f) == (long) (offset + 4 + 3 * 8 + BLOCK_TRAILER_SIZE));
+    fclose(f);
+
+    /*
+    * A file without a trailer has no index.
+    */
+    f = fopen("blocktest.out", "w");
+    assert(f);
+    fprintf(f, "not a container, just some text\n");
+    fclose(f);
+    f = fopen("blocktest.out", "r");
+    assert(f);
+    assert(block_index_read(f) == NULL);
+    fclose(f);
+
+    /*
+    * The markers of preset, stored and run blocks read back as such, and
+    * nothing else does.
+    */
+    uint8_t marked[16];
+    BitWriter *outbuf = bit_write_open_memory(marked, sizeof(marked));
+    assert(outbuf);
+    block_write_preset(outbuf, 200);
+    block_write_stored(outbuf, (const uint8_t *) "abcde", 5);
+    block_write_run(outbuf, 'x');
+    bit_write_close(&outbuf);
+    assert(block_read_kind(marked, BLOCK_PRESET_SIZE) == BLOCK_PRESET);
+    assert(block_read_preset(marked, BLOCK_PRESET_SIZE) == 200);
+    assert(block_read_kind(marked + 3, BLOCK_STORED_SIZE + 5) == BLOCK_STORED);
+    assert(memcmp(marked + 3 + BLOCK_STORED_SIZE, "abcde", 5) == 0);
+    assert(block_read_kind(marked + 10, BLOCK_RUN_SIZE) == BLOCK_RUN && marked[12] == 'x');
+    // cut short, or a real run of absent symbols
+    assert(block_read_kind(marked + 10, 2) == BLOCK_CODED);
+    assert(block_read_kind((const uint8_t *) "\xf0\x10\x11", 3) == BLOCK_CODED);
+    assert(block_read_kind((const uint8_t *) "\x21\x43", 2) == BLOCK_CODED);
+    // a coded block never needs more room than storing it
+    assert(block_bound(1000) == BLOCK_HEADER_SIZE + BLOCK_STORED_SIZE + 1000);
+    assert(block_read_bound(1000) > block_bound(1000));
+
+    printf("blocktest, as it is, reports no errors\n");
+    return 0;
+}
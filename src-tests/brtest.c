@@ -4,6 +4,7 @@
 * Author:   Kerry Veenstra
 */
 
+#include "bitio_ext.h"
 #include "bitreader.h"
 
 #include <assert.h>
@@ -153,6 +154,66 @@ int main(void) {
 
     bit_read_close(&buf);
 
+    /*
+    * Read the file again with bit_peek() and bit_consume().
+    *
+    * "ABCDEFGH" = 0x4847464544434241 (little-endian)
+    */
+    buf = bit_read_open("brtest.in");
+    if (!buf) {
+        fprintf(stderr, "error opening brtest.in\n");
+        exit(1);
+    }
+    assert(bit_peek(buf, 1) == 1);
+    assert(bit_peek(buf, 8) == 0x41);
+    assert(bit_peek(buf, BR_PEEK_MAX) == (0x4847464544434241 & (((uint64_t) 1 << BR_PEEK_MAX) - 1)));
+    bit_consume(buf, 3);
+    assert(bit_peek(buf, 13) == ((0x4847464544434241 >> 3) & 0x1fff));
+    bit_consume(buf, 13);
+    assert(bit_read_bits(buf, 48) == 0x484746454443);
+    assert(bit_read_bits(buf, 56) == 0xff4e4d4c4b4a49);
+    V8(0xAA);
+    V16(0x0a55);
+    V8(0x00);
+
+    /*
+    * Past the end of the file every bit reads as 0.
+    */
+    assert(bit_peek(buf, BR_PEEK_MAX) == 0);
+    V32(0);
+
+    bit_read_close(&buf);
+
+    /*
+    * Read bytes from memory; past the end every bit reads as 0 too.
+    */
+    const uint8_t memory[3] = { 0x41, 0x42, 0x43 };
+    buf = bit_read_open_memory(memory, 2);
+    if (!buf) {
+        fprintf(stderr, "error opening a memory reader\n");
+        exit(1);
+    }
+    V16(0x4241);
+    V8(0x00);
+    bit_read_close(&buf);
+
+    /*
+    * Whole bytes read as far as the input goes; a read past its end fails,
+    * even when the bit buffer was already topped up with zeros.
+    */
+    uint8_t bytes[4];
+    buf = bit_read_open_memory(memory, 3);
+    assert(buf);
+    V8(0x41);
+    assert(bit_read_bytes(buf, bytes, 2) && bytes[0] == 0x42 && bytes[1] == 0x43);
+    assert(!bit_read_bytes(buf, bytes, 1) && bytes[0] == 0x00);
+    bit_read_close(&buf);
+    buf = bit_read_open_memory(memory, 3);
+    assert(buf);
+    assert(!bit_read_bytes(buf, bytes, 4));
+    assert(memcmp(bytes, "ABC\0", 4) == 0);
+    bit_read_close(&buf);
+
     printf("brtest, as it is, reports no errors\n");
     return 0;
 }
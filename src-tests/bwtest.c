@@ -4,6 +4,7 @@
 * Author:   Kerry Veenstra
 */
 
+#include "bitio_ext.h"
 #include "bitwriter.h"
 
 #include <assert.h>
@@ -153,6 +154,81 @@ int main(void) {
             exit(1);
         }
     }
+    fclose(f);
+
+    /*
+    * Write the same text again with bit_write_bits(), using field widths
+    * that straddle byte boundaries and the 64-bit accumulator.
+    *
+    * "ABCDEFGH" = 0x4847464544434241 (little-endian)
+    * "IJKLMN\n" = 0x0a4e4d4c4b4a49
+    */
+    buf = bit_write_open("bwtest.out");
+    if (!buf) {
+        fprintf(stderr, "error opening bwtest.out\n");
+        exit(1);
+    }
+    bit_write_bits(buf, 0x4847464544434241 & 0x7, 3);
+    bit_write_bits(buf, 0x4847464544434241 >> 3, 61);
+    bit_write_bits(buf, 0x0a4e4d4c4b4a49, 13);
+    bit_write_bits(buf, 0x0a4e4d4c4b4a49 >> 13, 43);
+    bit_write_close(&buf);
+
+    f = fopen("bwtest.out", "r");
+    if (!f) {
+        fprintf(stderr, "error opening bwtest.out for verification\n");
+        exit(1);
+    }
+    for (char *p = expect_data; *p != '\0'; ++p) {
+        int ch = fgetc(f);
+        if (ch != *p) {
+            fprintf(stderr, "bwtest.out: bit_write_bits expected %02x but got %02x\n", *p, ch);
+            exit(1);
+        }
+    }
+    if (fgetc(f) != EOF) {
+        fprintf(stderr, "bwtest.out: bit_write_bits wrote extra bytes\n");
+        exit(1);
+    }
+    fclose(f);
+
+    /*
+    * Write the same text into a memory buffer that is exactly big enough;
+    * the writer must not touch the byte after it.
+    */
+    uint8_t memory[16];
+    memset(memory, 0xee, sizeof(memory));
+    buf = bit_write_open_memory(memory, 15);
+    if (!buf) {
+        fprintf(stderr, "error opening a memory writer\n");
+        exit(1);
+    }
+    bit_write_bits(buf, 0x4847464544434241, 64);
+    bit_write_bits(buf, 0x0a4e4d4c4b4a49, 56);
+    bit_write_close(&buf);
+    if (memcmp(memory, expect_data, 15) != 0 || memory[15] != 0xee) {
+        fprintf(stderr, "bit_write_open_memory: wrong bytes in memory\n");
+        exit(1);
+    }
+
+    /*
+    * Write far more than a small memory buffer holds: the bytes that fit
+    * are kept, the rest are dropped, and the byte after it is not touched.
+    */
+    memset(memory, 0xee, sizeof(memory));
+    buf = bit_write_open_memory(memory, 4);
+    if (!buf) {
+        fprintf(stderr, "error opening a memory writer\n");
+        exit(1);
+    }
+    for (int i = 0; i < 100; ++i) {
+        bit_write_bits(buf, 0x4847464544434241, 56);
+    }
+    bit_write_close(&buf);
+    if (memcmp(memory, expect_data, 4) != 0 || memory[4] != 0xee) {
+        fprintf(stderr, "bit_write_open_memory: a full buffer is overrun\n");
+        exit(1);
+    }
 
     printf("bwtest, as it is, reports no errors\n");
     return 0;
@@ -0,0 +1,160 @@
+/*
+* File:     canontest.c
+* Purpose:  Test canon.c
+*/
+
+#include "arena.h"
+#include "bitreader.h"
+#include "bitwriter.h"
+#include "canon.h"
+
+#include <assert.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+int main(int argc, char **argv) {
+    /*
+    * Poor man's argument checking: is "-v" the first command-line argument?
+    * Ignore all other arguments.
+    */
+    bool verbose = argc > 1 && strcmp(argv[1], "-v") == 0;
+
+    if (!verbose)
+        printf("Use \"canontest -v\" to print trace information.\n");
+
+    /*
+    * The example from RFC 1951, section 3.2.2:
+    *
+    *   symbol  length  code    first bit lowest
+    *     A       3     010     010 = 2
+    *     B       3     011     110 = 6
+    *     C       3     100     001 = 1
+    *     D       3     101     101 = 5
+    *     E       3     110     011 = 3
+    *     F       2     00      00  = 0
+    *     G       4     1110    0111 = 7
+    *     H       4     1111    1111 = 15
+    */
+    uint8_t code_lengths[256] = { 0 };
+    code_lengths['A'] = 3;
+    code_lengths['B'] = 3;
+    code_lengths['C'] = 3;
+    code_lengths['D'] = 3;
+    code_lengths['E'] = 3;
+    code_lengths['F'] = 2;
+    code_lengths['G'] = 4;
+    code_lengths['H'] = 4;
+
+    uint64_t codes[256];
+    canon_assign(code_lengths, codes);
+    if (verbose) {
+        for (int s = 'A'; s <= 'H'; ++s) {
+            printf("%c length %u code %" PRIu64 "\n", s, code_lengths[s], codes[s]);
+        }
+    }
+    assert(codes['A'] == 2);
+    assert(codes['B'] == 6);
+    assert(codes['C'] == 1);
+    assert(codes['D'] == 5);
+    assert(codes['E'] == 3);
+    assert(codes['F'] == 0);
+    assert(codes['G'] == 7);
+    assert(codes['H'] == 15);
+    assert(codes['I'] == 0);
+
+    /*
+    * Write the lengths to a file and read them back.  Make room in the code
+    * for symbols at both ends, so the runs of absent symbols start and stop
+    * at the edges.
+    */
+    code_lengths['G'] = 5;
+    code_lengths['H'] = 5;
+    code_lengths[0x00] = 15;
+    code_lengths[0xff] = 15;
+    BitWriter *bw = bit_write_open("canontest.out");
+    assert(bw);
+    canon_write_lengths(bw, code_lengths);
+    bit_write_close(&bw);
+
+    uint8_t read_lengths[256];
+    BitReader *br = bit_read_open("canontest.out");
+    assert(br);
+    assert(canon_read_lengths(br, read_lengths));
+    bit_read_close(&br);
+    assert(memcmp(code_lengths, read_lengths, sizeof(code_lengths)) == 0);
+
+    /*
+    * Three codes of length 1 cannot be a prefix code.
+    */
+    memset(code_lengths, 0, sizeof(code_lengths));
+    code_lengths['x'] = 1;
+    code_lengths['y'] = 1;
+    code_lengths['z'] = 1;
+    bw = bit_write_open("canontest.out");
+    assert(bw);
+    canon_write_lengths(bw, code_lengths);
+    bit_write_close(&bw);
+
+    br = bit_read_open("canontest.out");
+    assert(br);
+    assert(!canon_read_lengths(br, read_lengths));
+    bit_read_close(&br);
+
+    /*
+    * Fibonacci weights make the deepest possible tree: symbol k would get a
+    * code of length k + 1.  Limit the lengths and check that they still form
+    * a complete prefix code, with the rarest symbols getting the longest codes.
+    */
+    uint32_t histogram[256] = { 0 };
+    histogram[0] = 1;
+    histogram[1] = 1;
+    for (int k = 2; k < 30; ++k) {
+        histogram[k] = histogram[k - 1] + histogram[k - 2];
+    }
+    for (uint8_t max_length = 5; max_length <= CANON_MAX_LENGTH; ++max_length) {
+        assert(canon_limit_lengths(histogram, max_length, code_lengths));
+        uint32_t kraft = 0;
+        for (int k = 0; k < 256; ++k) {
+            assert(code_lengths[k] <= max_length);
+            assert((code_lengths[k] == 0) == (histogram[k] == 0));
+            if (k > 0 && histogram[k] > 0) {
+                assert(code_lengths[k] <= code_lengths[k - 1]);
+            }
+            if (code_lengths[k] > 0) {
+                kraft += (uint32_t) 1 << (CANON_MAX_LENGTH - code_lengths[k]);
+            }
+        }
+        assert(kraft == (uint32_t) 1 << CANON_MAX_LENGTH);
+        if (verbose)
+            printf("max_length %u: longest code %u\n", max_length, code_lengths[0]);
+    }
+
+    /*
+    * 30 symbols do not fit in 4-bit codes.
+    */
+    assert(!canon_limit_lengths(histogram, 4, code_lengths));
+
+    /*
+    * The arena version gives the same lengths, and once its arena has grown
+    * it limits lengths again and again without taking memory from the heap.
+    */
+    Arena *arena = arena_create(1024);
+    assert(arena);
+    uint8_t arena_lengths[256];
+    assert(canon_limit_lengths(histogram, 9, code_lengths));
+    assert(canon_limit_lengths_arena(arena, histogram, 9, arena_lengths));
+    assert(memcmp(code_lengths, arena_lengths, sizeof(arena_lengths)) == 0);
+    uint64_t chunks = arena_heap_allocations();
+    for (uint8_t max_length = 5; max_length <= 9; ++max_length) {
+        arena_reset(arena);
+        assert(canon_limit_lengths_arena(arena, histogram, max_length, arena_lengths));
+    }
+    assert(arena_heap_allocations() == chunks);
+    arena_free(&arena);
+
+    printf("canontest, as it is, reports no errors\n");
+    return 0;
+}
@@ -0,0 +1,213 @@
+/*
+* File:     dttest.c
+* Purpose:  Test dectable.c
+*/
+
+#include "bitio_ext.h"
+#include "bitreader.h"
+#include "bitwriter.h"
+#include "dectable.h"
+#include "node.h"
+#include "nodearena.h"
+
+#include <assert.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+* Number of leaves in the test tree.  The deepest codes are longer than
+* DT_PRIMARY_BITS + 8, so they need more than one level of sub-tables.
+*/
+#define LEAVES 25
+
+/*
+* Number of symbols that are encoded and decoded.
+*/
+#define MESSAGE 1000
+
+int main(int argc, char **argv) {
+    /*
+    * Poor man's argument checking: is "-v" the first command-line argument?
+    * Ignore all other arguments.
+    */
+    bool verbose = argc > 1 && strcmp(argv[1], "-v") == 0;
+
+    if (!verbose)
+        printf("Use \"dttest -v\" to print trace information.\n");
+
+    /*
+    * Make a tree where leaf k hangs off the k-th internal node.
+    *
+    *      *
+    *     / \
+    *    0   *
+    *       / \
+    *      1   ...
+    *            \
+    *             *
+    *            / \
+    *          23   24
+    *
+    * Symbol k < 24 has the code 1...10 (k ones, then a zero), which is
+    * ((1 << k) - 1) with the first bit in the least significant bit.
+    * Symbol 24 has the code of 24 ones.
+    */
+    Node *tree = node_create(LEAVES - 1, 0);
+    for (int k = LEAVES - 2; k >= 0; --k) {
+        Node *parent = node_create(0, 0);
+        parent->left = node_create((uint8_t) k, 0);
+        parent->right = tree;
+        tree = parent;
+    }
+    if (verbose)
+        node_print_tree(tree);
+
+    uint64_t codes[LEAVES];
+    uint8_t code_lengths[LEAVES];
+    for (int k = 0; k < LEAVES; ++k) {
+        codes[k] = ((uint64_t) 1 << k) - 1;
+        code_lengths[k] = (uint8_t) (k < LEAVES - 1 ? k + 1 : k);
+    }
+    codes[LEAVES - 1] = ((uint64_t) 1 << (LEAVES - 1)) - 1;
+
+    /*
+    * Write a message that uses every symbol.
+    */
+    uint8_t message[MESSAGE];
+    BitWriter *bw = bit_write_open("dttest.out");
+    assert(bw);
+    for (int i = 0; i < MESSAGE; ++i) {
+        message[i] = (uint8_t) ((i * 7) % LEAVES);
+        bit_write_bits(bw, codes[message[i]], code_lengths[message[i]]);
+    }
+    bit_write_close(&bw);
+
+    /*
+    * Decode it with a table built from the tree.
+    */
+    DecodeTable *dt = dt_create(tree);
+    assert(dt);
+    BitReader *br = bit_read_open("dttest.out");
+    assert(br);
+    uint8_t decoded[MESSAGE];
+    dt_decode(dt, br, decoded, MESSAGE);
+    assert(memcmp(message, decoded, MESSAGE) == 0);
+    bit_read_close(&br);
+
+    /*
+    * The codes are short on average, so the multi-symbol table was chosen.
+    * Decode again with it and without it.
+    */
+    for (int multi = 0; multi <= 1; ++multi) {
+        assert(dt_multi_enable(dt, multi) == multi);
+        br = bit_read_open("dttest.out");
+        assert(br);
+        memset(decoded, 0, MESSAGE);
+        dt_decode(dt, br, decoded, MESSAGE);
+        assert(memcmp(message, decoded, MESSAGE) == 0);
+        bit_read_close(&br);
+    }
+    dt_free(&dt);
+    assert(dt == NULL);
+    node_free_tree(&tree);
+
+    /*
+    * A tree that is a single leaf decodes without reading any bits.
+    */
+    Node *leaf = node_create('x', 1);
+    dt = dt_create(leaf);
+    assert(dt);
+    br = bit_read_open("dttest.out");
+    assert(br);
+    dt_decode(dt, br, decoded, 3);
+    assert(decoded[0] == 'x' && decoded[1] == 'x' && decoded[2] == 'x');
+    assert(bit_read_bit(br) == (codes[message[0]] & 1));
+    bit_read_close(&br);
+    dt_free(&dt);
+    node_free(&leaf);
+
+    /*
+    * Decode four sub-streams side by side.  The codes must be at most 15
+    * bits, so use the first 15 symbols of the same shape: symbol 14 now
+    * has the code of 14 ones.  The slices have very different lengths.
+    */
+    codes[14] = ((uint64_t) 1 << 14) - 1;
+    code_lengths[14] = 14;
+    uint8_t lengths15[256] = { 0 };
+    uint64_t codes15[256] = { 0 };
+    for (int k = 0; k < 15; ++k) {
+        lengths15[k] = code_lengths[k];
+        codes15[k] = codes[k];
+    }
+    dt = dt_create_from_codes(codes15, lengths15);
+    assert(dt);
+    const size_t slices[DT_MAX_STREAMS] = { 300, 1, 0, MESSAGE - 301 };
+    uint8_t streams[DT_MAX_STREAMS][MESSAGE * 2];
+    const uint8_t *src[DT_MAX_STREAMS];
+    size_t src_lengths[DT_MAX_STREAMS];
+    uint8_t *dst[DT_MAX_STREAMS];
+    size_t start = 0;
+    for (int s = 0; s < DT_MAX_STREAMS; ++s) {
+        uint64_t bits = 0;
+        bw = bit_write_open_memory(streams[s], sizeof(streams[s]));
+        assert(bw);
+        for (size_t i = start; i < start + slices[s]; ++i) {
+            message[i] = (uint8_t) ((i * 7) % 15);
+            bit_write_bits(bw, codes15[message[i]], lengths15[message[i]]);
+            bits += lengths15[message[i]];
+        }
+        bit_write_close(&bw);
+        src[s] = streams[s];
+        src_lengths[s] = (size_t) ((bits + 7) / 8);
+        dst[s] = decoded + start;
+        start += slices[s];
+    }
+    for (int multi = 0; multi <= 1; ++multi) {
+        dt_multi_enable(dt, multi);
+        memset(decoded, 0, MESSAGE);
+        dt_decode_streams(dt, DT_MAX_STREAMS, src, src_lengths, dst, slices);
+        assert(memcmp(message, decoded, MESSAGE) == 0);
+        // the same slices decode one stream at a time too
+        memset(decoded, 0, MESSAGE);
+        for (int s = 0; s < DT_MAX_STREAMS; ++s) {
+            dt_decode_streams(dt, 1, &src[s], &src_lengths[s], &dst[s], &slices[s]);
+        }
+        assert(memcmp(message, decoded, MESSAGE) == 0);
+    }
+    if (verbose)
+        printf("decoded %d symbols from %d sub-streams\n", MESSAGE, DT_MAX_STREAMS);
+    dt_free(&dt);
+
+    /*
+    * Lengths that leave part of the code space unused, or claim more of it
+    * than there is, give no table: an entry without a code would decode
+    * without consuming any bits.  A single symbol's 1-bit code is allowed
+    * and decodes from either bit.
+    */
+    lengths15[14] = 0;
+    assert(dt_create_from_codes(codes15, lengths15) == NULL);
+    lengths15[14] = 1;
+    assert(dt_create_from_codes(codes15, lengths15) == NULL);
+    uint8_t lengths1[256] = { 0 };
+    uint64_t codes1[256] = { 0 };
+    lengths1['q'] = 1;
+    dt = dt_create_from_codes(codes1, lengths1);
+    assert(dt);
+    const uint8_t one_stream[2] = { 0x5a, 0xff };
+    const uint8_t *one_src = one_stream;
+    size_t one_length = sizeof(one_stream);
+    uint8_t *one_dst = decoded;
+    size_t one_slice = 16;
+    memset(decoded, 0, MESSAGE);
+    dt_decode_streams(dt, 1, &one_src, &one_length, &one_dst, &one_slice);
+    for (size_t i = 0; i < one_slice; ++i) {
+        assert(decoded[i] == 'q');
+    }
+    dt_free(&dt);
+
+    printf("dttest, as it is, reports no errors\n");
+    return 0;
+}
@@ -0,0 +1,116 @@
+/*
+* File:     histtest.c
+* Purpose:  Test histogram.c, and with -v compare its speed with a simple loop
+*/
+
+#include "histogram.h"
+
+#include <assert.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/*
+* Size of the test data: large enough for the threaded variant to split it.
+*/
+#define DATA_SIZE (16 * 1024 * 1024 + 13)
+
+// function that counts the bytes one at a time into one table, like huff used to
+static void simple_count(const uint8_t *data, size_t n, uint64_t *histogram) {
+    for (size_t i = 0; i < n; ++i) {
+        ++histogram[data[i]];
+    }
+}
+
+// function that returns the time in seconds
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec + (double) ts.tv_nsec / 1e9;
+}
+
+// function that prints how fast count() goes over data
+static void bench(const char *name, const uint8_t *data, size_t n,
+    void (*count)(const uint8_t *, size_t, uint64_t *)) {
+    uint64_t histogram[256] = { 0 };
+    double start = now();
+    for (int r = 0; r < 10; ++r) {
+        count(data, n, histogram);
+    }
+    double seconds = now() - start;
+    printf("%-24s %8.0f MB/s\n", name, 10.0 * (double) n / seconds / 1e6);
+}
+
+// function that counts with four threads, for bench()
+static void threads_count(const uint8_t *data, size_t n, uint64_t *histogram) {
+    histogram_count_threads(data, n, histogram, 4);
+}
+
+int main(int argc, char **argv) {
+    /*
+    * Poor man's argument checking: is "-v" the first command-line argument?
+    * Ignore all other arguments.
+    */
+    bool verbose = argc > 1 && strcmp(argv[1], "-v") == 0;
+
+    if (!verbose)
+        printf("Use \"histtest -v\" to print trace information.\n");
+
+    uint8_t *data = (uint8_t *) malloc(DATA_SIZE);
+    uint8_t *zeros = (uint8_t *) calloc(DATA_SIZE, 1);
+    assert(data && zeros);
+    srand(1);
+    for (size_t i = 0; i < DATA_SIZE; ++i) {
+        data[i] = (uint8_t) (rand() % 7 == 0 ? rand() : 'a' + rand() % 5);
+    }
+
+    /*
+    * Every length up to 40 bytes exercises the tail of the 16-byte loop,
+    * and the counts add to what the histogram already holds.
+    */
+    for (size_t n = 0; n <= 40; ++n) {
+        uint64_t expect[256] = { 0 };
+        uint64_t got[256] = { 0 };
+        expect['x'] = got['x'] = 5;
+        simple_count(data + 3, n, expect);
+        histogram_count(data + 3, n, got);
+        assert(memcmp(expect, got, sizeof(got)) == 0);
+    }
+
+    /*
+    * The whole buffer, random and all zeros, plain and on threads.
+    */
+    const uint8_t *inputs[2] = { data, zeros };
+    for (int k = 0; k < 2; ++k) {
+        uint64_t expect[256] = { 0 };
+        uint64_t got[256] = { 0 };
+        uint64_t got_threads[256] = { 0 };
+        simple_count(inputs[k], DATA_SIZE, expect);
+        histogram_count(inputs[k], DATA_SIZE, got);
+        histogram_count_threads(inputs[k], DATA_SIZE, got_threads, 3);
+        assert(memcmp(expect, got, sizeof(got)) == 0);
+        assert(memcmp(expect, got_threads, sizeof(got)) == 0);
+    }
+
+    /*
+    * Compare the speed with the one-table loop.
+    */
+    if (verbose) {
+        printf("random text:\n");
+        bench("  one table", data, DATA_SIZE, simple_count);
+        bench("  histogram_count", data, DATA_SIZE, histogram_count);
+        bench("  4 threads", data, DATA_SIZE, threads_count);
+        printf("zeros:\n");
+        bench("  one table", zeros, DATA_SIZE, simple_count);
+        bench("  histogram_count", zeros, DATA_SIZE, histogram_count);
+        bench("  4 threads", zeros, DATA_SIZE, threads_count);
+    }
+
+    free(data);
+    free(zeros);
+    printf("histtest, as it is, reports no errors\n");
+    return 0;
+}
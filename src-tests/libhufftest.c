@@ -0,0 +1,367 @@
+/*
+* File:     libhufftest.c
+* Purpose:  Test the buffer interface of libhuff (huffenc.c and huffdec.c)
+*/
+
+#include "arena.h"
+#include "bitio_ext.h"
+#include "block.h"
+#include "libhuff.h"
+
+#include <assert.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_INPUT (300 * 1000)
+
+// function that fills data with n bytes of one of several kinds of input
+static void make_input(int kind, uint8_t *data, size_t n) {
+    uint32_t x = 12345;
+    for (size_t i = 0; i < n; ++i) {
+        x = x * 1103515245 + 12345;
+        switch (kind) {
+        // one byte value only
+        case 0: data[i] = 'a'; break;
+        // text-like skew
+        case 1: data[i] = (uint8_t) ("etaoin shrdlu"[(x >> 16) % 13]); break;
+        // every byte value
+        default: data[i] = (uint8_t) (x >> 16); break;
+        }
+    }
+}
+
+// function that writes x as n little-endian bytes at p
+static void put_le(uint8_t *p, uint64_t x, int n) {
+    for (int i = 0; i < n; ++i) {
+        p[i] = (uint8_t) (x >> (8 * i));
+    }
+}
+
+// function that writes n bytes to a file of that name
+static void write_file(const char *name, const uint8_t *data, size_t n) {
+    FILE *f = fopen(name, "w");
+    assert(f && fwrite(data, 1, n, f) == n);
+    fclose(f);
+}
+
+// function that returns the size of a file
+static long file_size(FILE *f) {
+    assert(fseek(f, 0, SEEK_END) == 0);
+    return ftell(f);
+}
+
+// function that compresses and decompresses n bytes with the contexts and
+// checks the result; it returns the compressed size
+static size_t round_trip(HuffCCtx *cctx, HuffDCtx *dctx, const uint8_t *data, size_t n,
+    uint8_t *packed, uint8_t *unpacked) {
+    size_t bound = huff_cctx_bound(cctx, n);
+    size_t size = huff_compress_ctx(cctx, data, n, packed, bound);
+    assert(size != HUFF_ERROR && size <= bound);
+    assert(huff_cctx_stats(cctx)->input_bytes == n);
+    assert(huff_cctx_stats(cctx)->output_bytes == size);
+    assert(huff_decompressed_size(packed, size) == n);
+    assert(huff_decompress_ctx(dctx, packed, size, unpacked, n) == n);
+    assert(memcmp(data, unpacked, n) == 0);
+    return size;
+}
+
+int main(int argc, char **argv) {
+    /*
+    * Poor man's argument checking: is "-v" the first command-line argument?
+    * Ignore all other arguments.
+    */
+    bool verbose = argc > 1 && strcmp(argv[1], "-v") == 0;
+
+    if (!verbose)
+        printf("Use \"libhufftest -v\" to print trace information.\n");
+
+    uint8_t *data = (uint8_t *) malloc(MAX_INPUT);
+    uint8_t *packed = (uint8_t *) malloc(2 * MAX_INPUT);
+    uint8_t *unpacked = (uint8_t *) malloc(MAX_INPUT);
+    assert(data && packed && unpacked);
+
+    /*
+    * The one-call functions, including an empty input.
+    */
+    size_t sizes[] = { 0, 1, 2, 100, 4096, MAX_INPUT };
+    for (int kind = 0; kind < 3; ++kind) {
+        for (size_t k = 0; k < sizeof(sizes) / sizeof(sizes[0]); ++k) {
+            size_t n = sizes[k];
+            make_input(kind, data, n);
+            size_t size = huff_compress_buffer(data, n, packed, huff_compress_bound(n));
+            assert(size != HUFF_ERROR && size <= huff_compress_bound(n));
+            if (verbose)
+                printf("kind %d: %zu bytes -> %zu bytes\n", kind, n, size);
+            assert(huff_decompress_buffer(packed, size, unpacked, n) == n);
+            assert(memcmp(data, unpacked, n) == 0);
+            // too little room fails on both sides
+            if (n > 0) {
+                assert(huff_compress_buffer(data, n, packed, size - 1) == HUFF_ERROR);
+                assert(huff_decompress_buffer(packed, size, unpacked, n - 1) == HUFF_ERROR);
+            }
+            // a cut-off input is not a complete file
+            assert(huff_decompressed_size(packed, size - 1) == HUFF_ERROR);
+        }
+    }
+    assert(huff_decompressed_size((const uint8_t *) "nothing", 7) == HUFF_ERROR);
+
+    /*
+    * The file decoder fails on a file cut anywhere, before the end of its
+    * blocks or in its index.
+    */
+    make_input(1, data, MAX_INPUT);
+    size_t whole = huff_compress_buffer(data, MAX_INPUT, packed, huff_compress_bound(MAX_INPUT));
+    assert(whole != HUFF_ERROR);
+    HuffDCtx *serial = huff_dctx_create(1);
+    FILE *sink = tmpfile();
+    assert(serial && sink);
+    size_t cuts[] = { 3, 7, 100, whole / 2, whole - 30, whole - 1, whole };
+    for (size_t k = 0; k < sizeof(cuts) / sizeof(cuts[0]); ++k) {
+        BitReader *inbuf = bit_read_open_memory(packed, cuts[k]);
+        assert(inbuf);
+        assert(huff_decompress_file(serial, sink, inbuf) == (cuts[k] == whole));
+        bit_read_close(&inbuf);
+    }
+    fclose(sink);
+
+    /*
+    * The indexed decoder tells a file it cannot use from one that fails
+    * once the output is started.
+    */
+    write_file("libhufftest.hf", packed, whole);
+    sink = tmpfile();
+    assert(sink);
+    assert(huff_decompress_indexed(serial, sink, "libhufftest.hf") == HUFF_INDEXED_DONE);
+    assert(huff_dctx_error(serial) == HUFF_OK);
+    assert(huff_decompress_indexed(serial, sink, "libhufftest.missing") == HUFF_INDEXED_UNUSABLE);
+    fclose(sink);
+    // an index offset that is not where its block starts
+    uint8_t *evil = (uint8_t *) malloc(whole);
+    assert(evil);
+    memcpy(evil, packed, whole);
+    put_le(evil + whole - BLOCK_TRAILER_SIZE - 8, BLOCK_FILE_HEADER_SIZE + 1, 8);
+    write_file("libhufftest.hf", evil, whole);
+    sink = tmpfile();
+    assert(sink);
+    assert(huff_decompress_indexed(serial, sink, "libhufftest.hf") == HUFF_INDEXED_FAILED);
+    assert(file_size(sink) == 0);
+    assert(huff_decompressed_size(evil, whole) == HUFF_ERROR);
+    fclose(sink);
+    // a block length past BLOCK_MAX_SIZE, with the index total to match,
+    // fails everywhere before any output is made
+    memcpy(evil, packed, whole);
+    put_le(evil + BLOCK_FILE_HEADER_SIZE, 0xf0000000, 4);
+    put_le(evil + whole - BLOCK_TRAILER_SIZE, 0xf0000000, 8);
+    write_file("libhufftest.hf", evil, whole);
+    sink = tmpfile();
+    assert(sink);
+    assert(huff_decompress_indexed(serial, sink, "libhufftest.hf") == HUFF_INDEXED_FAILED);
+    assert(huff_dctx_error(serial) == HUFF_DATA_ERROR);
+    assert(file_size(sink) == 0);
+    assert(huff_decompressed_size(evil, whole) == HUFF_ERROR);
+    assert(huff_decompress_buffer(evil, whole, unpacked, MAX_INPUT) == HUFF_ERROR);
+    BitReader *evilbuf = bit_read_open_memory(evil, whole);
+    assert(evilbuf);
+    assert(!huff_decompress_file(serial, sink, evilbuf));
+    assert(huff_dctx_error(serial) == HUFF_DATA_ERROR);
+    bit_read_close(&evilbuf);
+    // the decoder says why a file fails instead of printing it
+    evilbuf = bit_read_open_memory((const uint8_t *) "nothing", 7);
+    assert(evilbuf);
+    assert(!huff_decompress_file(serial, sink, evilbuf));
+    assert(huff_dctx_error(serial) == HUFF_FORMAT_ERROR);
+    assert(strcmp(huff_status_message(HUFF_FORMAT_ERROR), "input is not a Huffman-compressed file") == 0);
+    bit_read_close(&evilbuf);
+    fclose(sink);
+    free(evil);
+    // a block that claims to be stored but has the wrong length
+    packed[BLOCK_FILE_HEADER_SIZE + BLOCK_HEADER_SIZE] = 0xf0;
+    packed[BLOCK_FILE_HEADER_SIZE + BLOCK_HEADER_SIZE + 1] = 0xfe;
+    write_file("libhufftest.hf", packed, whole);
+    sink = tmpfile();
+    assert(sink);
+    assert(huff_decompress_indexed(serial, sink, "libhufftest.hf") == HUFF_INDEXED_FAILED);
+    fclose(sink);
+    remove("libhufftest.hf");
+    huff_dctx_free(&serial);
+    assert(huff_decompress_buffer((const uint8_t *) "HF", 2, unpacked, 10) == HUFF_ERROR);
+
+    /*
+    * Parameters out of range give no context.
+    */
+    HuffParams params;
+    huff_params_default(&params);
+    params.num_streams = 0;
+    assert(huff_cctx_create(&params) == NULL);
+    huff_params_default(&params);
+    params.max_length = 16;
+    assert(huff_cctx_create(&params) == NULL);
+
+    /*
+    * Small blocks on several threads give the same bytes as one thread, and
+    * once the contexts are warm, more calls take no new arena chunks.
+    */
+    huff_params_default(&params);
+    params.block_size = 10000;
+    params.max_length = 11;
+    params.num_streams = 3;
+    HuffCCtx *cctx = huff_cctx_create(&params);
+    params.threads = 3;
+    HuffCCtx *threaded = huff_cctx_create(&params);
+    HuffDCtx *dctx = huff_dctx_create(3);
+    assert(cctx && threaded && dctx);
+    make_input(1, data, MAX_INPUT);
+    size_t size = round_trip(cctx, dctx, data, MAX_INPUT, packed, unpacked);
+    uint8_t *packed_threaded = (uint8_t *) malloc(size);
+    assert(packed_threaded);
+    assert(huff_compress_ctx(threaded, data, MAX_INPUT, packed_threaded, size) == size);
+    assert(memcmp(packed, packed_threaded, size) == 0);
+    assert(huff_cctx_stats(cctx)->blocks == (MAX_INPUT + 9999) / 10000);
+    for (int kind = 0; kind < 3; ++kind) {
+        make_input(kind, data, MAX_INPUT);
+        round_trip(threaded, dctx, data, MAX_INPUT, packed, unpacked);
+    }
+    uint64_t before = arena_heap_allocations();
+    for (int pass = 0; pass < 20; ++pass) {
+        make_input(pass % 3, data, MAX_INPUT);
+        round_trip(threaded, dctx, data, MAX_INPUT - (size_t) pass * 1000, packed, unpacked);
+    }
+    if (verbose)
+        printf("20 calls took %" PRIu64 " new arena chunks\n", arena_heap_allocations() - before);
+    assert(arena_heap_allocations() == before);
+    /*
+    * A block of one byte value is a run and random bytes are stored, so
+    * neither grows past its block header; text is still coded.
+    */
+    make_input(0, data, MAX_INPUT);
+    size = round_trip(cctx, dctx, data, MAX_INPUT, packed, unpacked);
+    assert(huff_cctx_stats(cctx)->run_blocks == huff_cctx_stats(cctx)->blocks);
+    assert(size < 30 * huff_cctx_stats(cctx)->blocks + 100);
+    make_input(2, data, MAX_INPUT);
+    size = round_trip(threaded, dctx, data, MAX_INPUT, packed, unpacked);
+    assert(huff_cctx_stats(threaded)->stored_blocks == huff_cctx_stats(threaded)->blocks);
+    assert(size <= huff_cctx_bound(threaded, MAX_INPUT));
+    if (verbose)
+        printf("%d random bytes stored in %zu bytes\n", MAX_INPUT, size);
+    make_input(1, data, MAX_INPUT);
+    round_trip(cctx, dctx, data, MAX_INPUT, packed, unpacked);
+    assert(huff_cctx_stats(cctx)->stored_blocks == 0 && huff_cctx_stats(cctx)->run_blocks == 0);
+
+    free(packed_threaded);
+    huff_cctx_free(&cctx);
+    huff_cctx_free(&threaded);
+
+    /*
+    * With timing on, the statistics count every byte and time every stage
+    * the input goes through, on either side.
+    */
+    params.timing = true;
+    threaded = huff_cctx_create(&params);
+    assert(threaded);
+    huff_dctx_set_timing(dctx, true);
+    make_input(1, data, MAX_INPUT);
+    size = round_trip(threaded, dctx, data, MAX_INPUT, packed, unpacked);
+    const HuffStats *stats = huff_cctx_stats(threaded);
+    uint64_t counted = 0;
+    for (int i = 0; i < 256; ++i) {
+        counted += stats->histogram[i];
+    }
+    assert(counted == MAX_INPUT);
+    assert(stats->max_leaves >= 13 && stats->max_code_length <= 11);
+    assert(stats->wall_ns[HUFF_STAGE_HISTOGRAM] > 0 && stats->wall_ns[HUFF_STAGE_ENCODE] > 0);
+    if (verbose)
+        printf("encode took %" PRIu64 " ns of wall time\n", stats->wall_ns[HUFF_STAGE_ENCODE]);
+    stats = huff_dctx_stats(dctx);
+    assert(stats->input_bytes == size && stats->output_bytes == MAX_INPUT);
+    assert(stats->blocks == (MAX_INPUT + 9999) / 10000);
+    assert(stats->max_code_length <= 11 && stats->wall_ns[HUFF_STAGE_DECODE] > 0);
+    huff_cctx_free(&threaded);
+    huff_dctx_free(&dctx);
+    assert(cctx == NULL && threaded == NULL && dctx == NULL);
+
+    /*
+    * A built-in table codes a small input in fewer bytes than a code of its
+    * own, and auto takes it; a trained table must be given to the
+    * decompressor, and survives a file.
+    */
+    const char *text = "This program is free software: you can redistribute it and/or modify "
+                       "it under the terms of the license, either version 3 of the License, or "
+                       "(at your option) any later version.  It is distributed in the hope that "
+                       "it will be useful, but WITHOUT ANY WARRANTY; without even the implied "
+                       "warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.\n";
+    size_t n = strlen(text);
+    memcpy(data, text, n);
+    huff_params_default(&params);
+    cctx = huff_cctx_create(&params);
+    dctx = huff_dctx_create(1);
+    assert(cctx && dctx);
+    size_t own = round_trip(cctx, dctx, data, n, packed, unpacked);
+    huff_cctx_free(&cctx);
+    params.table = huff_table_builtin(HUFF_TABLE_TEXT);
+    assert(params.table && params.table == huff_table_by_name("text"));
+    cctx = huff_cctx_create(&params);
+    assert(cctx);
+    size_t preset = round_trip(cctx, dctx, data, n, packed, unpacked);
+    assert(huff_cctx_stats(cctx)->table_blocks == 1);
+    // one byte value is still a run, table or not
+    memset(data, 'a', 30000);
+    round_trip(cctx, dctx, data, 30000, packed, unpacked);
+    assert(huff_cctx_stats(cctx)->run_blocks == huff_cctx_stats(cctx)->blocks);
+    assert(huff_cctx_stats(cctx)->table_blocks == 0);
+    huff_cctx_free(&cctx);
+    params.table = NULL;
+    params.choose_table = true;
+    cctx = huff_cctx_create(&params);
+    assert(cctx);
+    size_t chosen = round_trip(cctx, dctx, data, n, packed, unpacked);
+    huff_cctx_free(&cctx);
+    if (verbose)
+        printf("%zu bytes of text: %zu bytes with their own code, %zu with the text table, "
+               "%zu with auto\n", n, own, preset, chosen);
+    assert(preset < own && chosen <= preset);
+
+    uint64_t histogram[256] = { 0 };
+    make_input(1, data, MAX_INPUT);
+    for (size_t i = 0; i < MAX_INPUT; ++i) {
+        ++histogram[data[i]];
+    }
+    HuffTable *trained = huff_table_create(histogram, 200, 11);
+    assert(trained && trained->id == 200);
+    for (int i = 0; i < 256; ++i) {
+        assert(trained->code_lengths[i] >= 1 && trained->code_lengths[i] <= 11);
+    }
+    params.choose_table = false;
+    params.table = trained;
+    cctx = huff_cctx_create(&params);
+    assert(cctx);
+    size = huff_compress_ctx(cctx, data, 4096, packed, huff_cctx_bound(cctx, 4096));
+    assert(size != HUFF_ERROR);
+    assert(huff_decompress_ctx(dctx, packed, size, unpacked, 4096) == HUFF_ERROR);
+    assert(!huff_dctx_add_table(dctx, huff_table_builtin(HUFF_TABLE_TEXT)));
+    assert(huff_dctx_add_table(dctx, trained));
+    assert(huff_decompress_ctx(dctx, packed, size, unpacked, 4096) == 4096);
+    assert(memcmp(data, unpacked, 4096) == 0);
+    huff_cctx_free(&cctx);
+
+    assert(huff_table_save(trained, "libhufftest.table"));
+    HuffTable *loaded = huff_table_load("libhufftest.table");
+    remove("libhufftest.table");
+    assert(loaded && loaded->id == trained->id);
+    assert(memcmp(loaded->code_lengths, trained->code_lengths, 256) == 0);
+    assert(memcmp(loaded->codes, trained->codes, sizeof(trained->codes)) == 0);
+    assert(huff_table_load("libhufftest.missing") == NULL);
+    huff_table_free(&loaded);
+    huff_dctx_free(&dctx);
+    huff_table_free(&trained);
+    assert(trained == NULL);
+
+    free(data);
+    free(packed);
+    free(unpacked);
+
+    printf("libhufftest, as it is, reports no errors\n");
+    return 0;
+}
@@ -0,0 +1,408 @@
+/*
+* File:     microbench.c
+* Purpose:  Microbenchmarks of the components the unit tests check: the bit
+*           writer and reader, the priority queue, nodes and decode tables
+*
+* Every benchmark runs its warm-up runs, then its timed runs, and reports the
+* median, 10th and 90th percentile time of one run and the rate at the
+* median.  Names given on the command line select the benchmarks whose names
+* start with them.
+*/
+
+#include "arena.h"
+#include "bitio_ext.h"
+#include "bitreader.h"
+#include "bitwriter.h"
+#include "canon.h"
+#include "dectable.h"
+#include "node.h"
+#include "nodearena.h"
+#include "pq.h"
+#include "timer.h"
+
+#include <assert.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// the most timed runs of one benchmark
+#define MAX_REPEATS 1000
+
+// the number of bits the bit writer and reader benchmarks move in one run
+#define NUM_BITS (8 * 1024 * 1024)
+
+// the number of nodes made and freed in one run
+#define NUM_NODES (1024 * 1024)
+
+// the number of codes each bit benchmark cycles through
+#define NUM_CODES 4096
+
+// the number of dequeue and enqueue pairs of one run of a queue benchmark
+#define NUM_QUEUE_OPS 1024
+
+static uint32_t seed = 12345;
+
+// function that returns a pseudo-random number
+static uint32_t next_random(void) {
+    seed = seed * 1103515245 + 12345;
+    return seed >> 8;
+}
+
+// one benchmark: setup() prepares a run without being timed, run() is timed
+typedef struct Bench {
+    const char *name;
+    // what one run processes, and its unit for the rate
+    double items;
+    const char *unit;
+    void (*setup)(void *arg);
+    void (*run)(void *arg);
+    void *arg;
+    // fewer runs for the slow ones
+    unsigned repeats;
+} Bench;
+
+// function that compares two times for qsort()
+static int compare_ns(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *) a;
+    uint64_t y = *(const uint64_t *) b;
+    return x < y ? -1 : x > y;
+}
+
+// function that runs a benchmark warmup + repeats times and reports the timed runs
+static void measure(const Bench *bench, unsigned warmup, unsigned repeats, bool verbose) {
+    static uint64_t times[MAX_REPEATS];
+    repeats = bench->repeats < repeats ? bench->repeats : repeats;
+    for (unsigned r = 0; r < warmup + repeats; ++r) {
+        if (bench->setup != NULL) {
+            bench->setup(bench->arg);
+        }
+        uint64_t start = timer_now_ns();
+        bench->run(bench->arg);
+        uint64_t elapsed = timer_now_ns() - start;
+        if (r >= warmup) {
+            times[r - warmup] = elapsed;
+            if (verbose)
+                printf("  %s run %u: %" PRIu64 " ns\n", bench->name, r - warmup, elapsed);
+        }
+    }
+    qsort(times, repeats, sizeof(times[0]), compare_ns);
+    double median = (double) times[repeats / 2];
+    printf("%-20s median %12.1f us   p10 %12.1f us   p90 %12.1f us   %12.4g %s/s\n",
+        bench->name, median / 1e3, (double) times[repeats / 10] / 1e3,
+        (double) times[repeats * 9 / 10] / 1e3, bench->items / median * 1e9, bench->unit);
+}
+
+/*
+* The bit writer and reader.
+*/
+
+typedef struct BitBench {
+    uint8_t *buffer;
+    size_t size;
+    // codes and their lengths, 1 to 24 bits, together NUM_BITS bits
+    uint32_t codes[NUM_CODES];
+    uint8_t lengths[NUM_CODES];
+    uint64_t sum;
+} BitBench;
+
+// function that writes NUM_BITS bits one bit_write_bit() at a time
+static void bench_write_bit(void *arg) {
+    BitBench *b = (BitBench *) arg;
+    BitWriter *writer = bit_write_open_memory(b->buffer, b->size);
+    for (uint32_t i = 0; i < NUM_BITS; ++i) {
+        bit_write_bit(writer, (uint8_t) (i >> 3 & 1));
+    }
+    bit_write_close(&writer);
+}
+
+// function that writes NUM_BITS bits as codes of 1 to 24 bits with bit_write_bits()
+static void bench_write_bits(void *arg) {
+    BitBench *b = (BitBench *) arg;
+    BitWriter *writer = bit_write_open_memory(b->buffer, b->size);
+    for (uint32_t written = 0, i = 0; written < NUM_BITS; i = (i + 1) % NUM_CODES) {
+        bit_write_bits(writer, b->codes[i], b->lengths[i]);
+        written += b->lengths[i];
+    }
+    bit_write_close(&writer);
+}
+
+// function that reads NUM_BITS bits one bit_read_bit() at a time
+static void bench_read_bit(void *arg) {
+    BitBench *b = (BitBench *) arg;
+    BitReader *reader = bit_read_open_memory(b->buffer, b->size);
+    uint64_t sum = 0;
+    for (uint32_t i = 0; i < NUM_BITS; ++i) {
+        sum += bit_read_bit(reader);
+    }
+    bit_read_close(&reader);
+    b->sum = sum;
+}
+
+// function that reads NUM_BITS bits like a decoder does: peek 11 bits and
+// consume the length of the code found there
+static void bench_read_peek(void *arg) {
+    BitBench *b = (BitBench *) arg;
+    BitReader *reader = bit_read_open_memory(b->buffer, b->size);
+    uint64_t sum = 0;
+    for (uint32_t read = 0, i = 0; read < NUM_BITS; i = (i + 1) % NUM_CODES) {
+        sum += bit_peek(reader, 11);
+        bit_consume(reader, b->lengths[i]);
+        read += b->lengths[i];
+    }
+    bit_read_close(&reader);
+    b->sum = sum;
+}
+
+// function that reads NUM_BITS bits as codes of 1 to 24 bits with bit_read_bits()
+static void bench_read_bits(void *arg) {
+    BitBench *b = (BitBench *) arg;
+    BitReader *reader = bit_read_open_memory(b->buffer, b->size);
+    uint64_t sum = 0;
+    for (uint32_t read = 0, i = 0; read < NUM_BITS; i = (i + 1) % NUM_CODES) {
+        sum += bit_read_bits(reader, b->lengths[i]);
+        read += b->lengths[i];
+    }
+    bit_read_close(&reader);
+    b->sum = sum;
+}
+
+/*
+* The priority queue and nodes.
+*/
+
+typedef struct QueueBench {
+    unsigned num_symbols;
+    // the leaves, all in pq when they are not being moved
+    Node **leaves;
+    uint32_t *weights;
+    PriorityQueue *pq;
+    // the tree of the last build
+    Node *tree;
+    Node **nodes;
+    Arena *arena;
+} QueueBench;
+
+// function that takes the lightest leaf out of the full queue and puts it
+// back with a new weight, NUM_QUEUE_OPS times, like the merges of a tree
+// build do; the queue keeps its size, so the rate is the rate at that size
+static void bench_queue(void *arg) {
+    QueueBench *q = (QueueBench *) arg;
+    for (unsigned i = 0; i < NUM_QUEUE_OPS; ++i) {
+        Node *leaf = dequeue(q->pq);
+        leaf->weight = q->weights[i % q->num_symbols] + leaf->weight;
+        enqueue(q->pq, leaf);
+    }
+}
+
+// function that frees the tree of the last run
+static void setup_tree(void *arg) {
+    QueueBench *q = (QueueBench *) arg;
+    node_free_tree(&q->tree);
+}
+
+// function that builds a Huffman tree of num_symbols leaves with the
+// queue, the way huff did before it built trees in an array
+static void bench_tree(void *arg) {
+    QueueBench *q = (QueueBench *) arg;
+    PriorityQueue *pq = pq_create();
+    for (unsigned i = 0; i < q->num_symbols; ++i) {
+        enqueue(pq, node_create((uint8_t) i, q->weights[i]));
+    }
+    while (!pq_size_is_1(pq)) {
+        Node *left = dequeue(pq);
+        Node *right = dequeue(pq);
+        Node *parent = node_create(0, left->weight + right->weight);
+        parent->left = left;
+        parent->right = right;
+        enqueue(pq, parent);
+    }
+    q->tree = dequeue(pq);
+    pq_free(&pq);
+}
+
+// function that makes NUM_NODES nodes on the heap and frees them
+static void bench_nodes(void *arg) {
+    QueueBench *q = (QueueBench *) arg;
+    for (unsigned i = 0; i < NUM_NODES; ++i) {
+        q->nodes[i] = node_create((uint8_t) i, i);
+    }
+    for (unsigned i = 0; i < NUM_NODES; ++i) {
+        node_free(&q->nodes[i]);
+    }
+}
+
+// function that makes NUM_NODES nodes in an arena and releases them at once
+static void bench_nodes_arena(void *arg) {
+    QueueBench *q = (QueueBench *) arg;
+    for (unsigned i = 0; i < NUM_NODES; ++i) {
+        q->nodes[i] = node_create_arena(q->arena, (uint8_t) i, i);
+    }
+    arena_reset(q->arena);
+}
+
+/*
+* Decode tables.
+*/
+
+typedef struct TableBench {
+    uint64_t codes[256];
+    uint8_t lengths[256];
+    Arena *arena;
+} TableBench;
+
+// function that builds a decode table on the heap and frees it
+static void bench_table(void *arg) {
+    TableBench *t = (TableBench *) arg;
+    DecodeTable *table = dt_create_from_codes(t->codes, t->lengths);
+    assert(table);
+    dt_free(&table);
+}
+
+// function that builds a decode table in an arena
+static void bench_table_arena(void *arg) {
+    TableBench *t = (TableBench *) arg;
+    arena_reset(t->arena);
+    DecodeTable *table = dt_create_from_codes_arena(t->arena, t->codes, t->lengths);
+    assert(table);
+    dt_free(&table);
+}
+
+// function that compares two leaves for qsort(), heaviest first
+static int compare_heavier(const void *a, const void *b) {
+    uint32_t x = (*(Node *const *) a)->weight;
+    uint32_t y = (*(Node *const *) b)->weight;
+    return x > y ? -1 : x < y;
+}
+
+// function that fills a queue benchmark with n leaves of random weights
+static void make_queue(QueueBench *q, unsigned n) {
+    q->num_symbols = n;
+    q->leaves = (Node **) malloc((n > 0 ? n : 1) * sizeof(Node *));
+    q->weights = (uint32_t *) malloc((n > 0 ? n : 1) * sizeof(uint32_t));
+    q->pq = pq_create();
+    q->tree = NULL;
+    q->nodes = NULL;
+    q->arena = NULL;
+    assert(q->leaves && q->weights && q->pq);
+    for (unsigned i = 0; i < n; ++i) {
+        q->weights[i] = 1 + next_random() % 100000;
+        q->leaves[i] = node_create((uint8_t) i, q->weights[i]);
+        assert(q->leaves[i]);
+    }
+    // the queue is a sorted list, so it fills in linear time heaviest first;
+    // it owns the leaves from here on
+    qsort(q->leaves, n, sizeof(Node *), compare_heavier);
+    for (unsigned i = 0; i < n; ++i) {
+        enqueue(q->pq, q->leaves[i]);
+    }
+}
+
+// function that frees a queue benchmark
+static void free_queue(QueueBench *q) {
+    node_free_tree(&q->tree);
+    pq_free(&q->pq);
+    free(q->leaves);
+    free(q->weights);
+    free(q->nodes);
+    arena_free(&q->arena);
+}
+
+int main(int argc, char **argv) {
+    int option;
+    unsigned warmup = 2;
+    unsigned repeats = 11;
+    bool verbose = false;
+    while ((option = getopt(argc, argv, "vw:r:")) != -1) {
+        switch (option) {
+        case 'v': verbose = true; break;
+        case 'w': warmup = (unsigned) strtoul(optarg, NULL, 10); break;
+        case 'r': repeats = (unsigned) strtoul(optarg, NULL, 10); break;
+        default:
+            fprintf(stderr, "Usage: microbench [-v] [-w warmup] [-r repeats] [name ...]\n");
+            return 1;
+        }
+    }
+    if (repeats < 1 || repeats > MAX_REPEATS) {
+        fprintf(stderr, "repeats must be between 1 and %d\n", MAX_REPEATS);
+        return 1;
+    }
+
+    BitBench *bits = (BitBench *) malloc(sizeof(BitBench));
+    assert(bits);
+    bits->size = NUM_BITS / 8 + 8;
+    bits->buffer = (uint8_t *) malloc(bits->size);
+    assert(bits->buffer);
+    for (int i = 0; i < NUM_CODES; ++i) {
+        bits->lengths[i] = (uint8_t) (1 + next_random() % 24);
+        bits->codes[i] = next_random() & ((1u << bits->lengths[i]) - 1);
+    }
+    // the readers read what the multi-bit writer wrote
+    bench_write_bits(bits);
+
+    QueueBench small;
+    QueueBench medium;
+    QueueBench large;
+    make_queue(&small, 256);
+    make_queue(&medium, 4096);
+    make_queue(&large, 65536);
+    QueueBench nodes;
+    make_queue(&nodes, 0);
+    nodes.nodes = (Node **) malloc(NUM_NODES * sizeof(Node *));
+    nodes.arena = arena_create(0);
+    assert(nodes.nodes && nodes.arena);
+
+    // a skewed code with lengths limited to 15 bits, like a block of text
+    TableBench *table = (TableBench *) malloc(sizeof(TableBench));
+    assert(table);
+    uint32_t histogram[256];
+    for (int s = 0; s < 256; ++s) {
+        histogram[s] = 1 + 1000000 / (uint32_t) (s + 1);
+    }
+    // the benchmarks are built with NDEBUG, so nothing with an effect goes in an assert
+    if (!canon_limit_lengths(histogram, 15, table->lengths)) {
+        fprintf(stderr, "microbench: cannot limit the code lengths\n");
+        return 1;
+    }
+    canon_assign(table->lengths, table->codes);
+    table->arena = arena_create(0);
+    assert(table->arena);
+
+    Bench benches[] = {
+        { "bw_bit", NUM_BITS, "bit", NULL, bench_write_bit, bits, MAX_REPEATS },
+        { "bw_bits", NUM_BITS, "bit", NULL, bench_write_bits, bits, MAX_REPEATS },
+        { "br_bit", NUM_BITS, "bit", NULL, bench_read_bit, bits, MAX_REPEATS },
+        { "br_peek_consume", NUM_BITS, "bit", NULL, bench_read_peek, bits, MAX_REPEATS },
+        { "br_bits", NUM_BITS, "bit", NULL, bench_read_bits, bits, MAX_REPEATS },
+        { "pq_256", 2 * NUM_QUEUE_OPS, "op", NULL, bench_queue, &small, MAX_REPEATS },
+        { "pq_65536", 2 * NUM_QUEUE_OPS, "op", NULL, bench_queue, &large, MAX_REPEATS },
+        { "pq_tree_256", 1, "tree", setup_tree, bench_tree, &small, MAX_REPEATS },
+        // a tree build through the list takes quadratic time, 65536 leaves take minutes
+        { "pq_tree_4096", 1, "tree", setup_tree, bench_tree, &medium, MAX_REPEATS },
+        { "node_heap", 2 * NUM_NODES, "op", NULL, bench_nodes, &nodes, MAX_REPEATS },
+        { "node_arena", NUM_NODES, "op", NULL, bench_nodes_arena, &nodes, MAX_REPEATS },
+        { "dt_build", 1, "table", NULL, bench_table, table, MAX_REPEATS },
+        { "dt_build_arena", 1, "table", NULL, bench_table_arena, table, MAX_REPEATS },
+    };
+    for (size_t b = 0; b < sizeof(benches) / sizeof(benches[0]); ++b) {
+        bool selected = optind == argc;
+        for (int i = optind; i < argc; ++i) {
+            selected |= strncmp(benches[b].name, argv[i], strlen(argv[i])) == 0;
+        }
+        if (selected) {
+            measure(&benches[b], warmup, repeats, verbose);
+        }
+    }
+
+    free(bits->buffer);
+    free(bits);
+    free_queue(&small);
+    free_queue(&medium);
+    free_queue(&large);
+    free_queue(&nodes);
+    arena_free(&table->arena);
+    free(table);
+    return 0;
+}
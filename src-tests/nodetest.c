@@ -5,6 +5,7 @@
 */
 
 #include "node.h"
+#include "nodearena.h"
 
 #include <assert.h>
 #include <inttypes.h>
@@ -36,8 +37,9 @@ int main(int argc, char **argv) {
         printf("Use \"nodetest -v\" to print trace information.\n");
 
     /*
-    * See if node_create() initializes its fields.
+    * See if node_create() initializes its fields and counts its allocations.
     */
+    uint64_t allocations = node_heap_allocations();
     Node *a = node_create(0x00, 3);
     assert(a);
     assert(a->symbol == 0x00);
@@ -47,6 +49,7 @@ int main(int argc, char **argv) {
     assert(b);
     assert(b->symbol == 0xff);
     assert(b->weight == 5);
+    assert(node_heap_allocations() == allocations + 2);
 
     node_free(&a);
     assert(!a);
@@ -78,23 +81,12 @@ int main(int argc, char **argv) {
         node_print_tree(n4);
 
     /*
-    * Free everything.
+    * Free everything: node_free() frees a node's children with it, so
+    * freeing the root frees the whole tree.
     */
-    node_free(&n1);
-    assert(n1 == NULL);
-
-    node_free(&n2);
-    assert(n2 == NULL);
-
-    node_free(&n3);
-    assert(n3 == NULL);
-
     node_free(&n4);
     assert(n4 == NULL);
 
-    node_free(&n5);
-    assert(n5 == NULL);
-
     printf("nodetest, as it is, reports no errors\n");
     return 0;
 }
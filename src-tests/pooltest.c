@@ -0,0 +1,78 @@
+/*
+* File:     pooltest.c
+* Purpose:  Test pool.c
+*/
+
+#include "pool.h"
+
+#include <assert.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NUM_JOBS 1000
+
+typedef struct Task {
+    uint64_t n;
+    uint64_t sum;
+} Task;
+
+// function that gives a worker something to do: the sum of 1..n
+static void sum_task(void *arg) {
+    Task *task = (Task *) arg;
+    task->sum = 0;
+    for (uint64_t i = 1; i <= task->n; ++i) {
+        task->sum += i;
+    }
+}
+
+int main(int argc, char **argv) {
+    /*
+    * Poor man's argument checking: is "-v" the first command-line argument?
+    * Ignore all other arguments.
+    */
+    bool verbose = argc > 1 && strcmp(argv[1], "-v") == 0;
+
+    if (!verbose)
+        printf("Use \"pooltest -v\" to print trace information.\n");
+
+    assert(pool_create(0) == NULL);
+    assert(pool_create(POOL_MAX_THREADS + 1) == NULL);
+
+    /*
+    * Run many small jobs on a few threads and collect them in order.
+    */
+    static Task tasks[NUM_JOBS];
+    static PoolJob jobs[NUM_JOBS];
+    Pool *pool = pool_create(4);
+    assert(pool);
+    for (uint64_t i = 0; i < NUM_JOBS; ++i) {
+        tasks[i].n = i * 100;
+        pool_submit(pool, &jobs[i], sum_task, &tasks[i]);
+    }
+    for (uint64_t i = 0; i < NUM_JOBS; ++i) {
+        pool_wait_job(pool, &jobs[i]);
+        if (verbose && i % 100 == 0)
+            printf("job %" PRIu64 ": %" PRIu64 "\n", i, tasks[i].sum);
+        assert(tasks[i].sum == tasks[i].n * (tasks[i].n + 1) / 2);
+    }
+
+    /*
+    * A job can be submitted again once it has finished, and freeing the
+    * pool finishes the jobs that are still queued.
+    */
+    for (uint64_t i = 0; i < NUM_JOBS; ++i) {
+        tasks[i].n = 7;
+        pool_submit(pool, &jobs[i], sum_task, &tasks[i]);
+    }
+    pool_free(&pool);
+    assert(pool == NULL);
+    for (uint64_t i = 0; i < NUM_JOBS; ++i) {
+        assert(tasks[i].sum == 28);
+    }
+
+    printf("pooltest, as it is, reports no errors\n");
+    return 0;
+}
@@ -4,6 +4,7 @@
 * Author:   Kerry Veenstra
 */
 
+#include "nodearena.h"
 #include "pq.h"
 
 #include <inttypes.h>
@@ -69,6 +70,7 @@ int main(int argc, char **argv) {
     */
     assert(!pq_size_is_1(q));
     assert(pq_is_empty(q));
+    uint64_t allocations = pq_heap_allocations();
 
     enqueue(q, n1);
     assert(pq_size_is_1(q));
@@ -84,6 +86,7 @@ int main(int argc, char **argv) {
     enqueue(q, n6);
     enqueue(q, n7);
     enqueue(q, n8);
+    assert(pq_heap_allocations() == allocations + 8);
 
     if (verbose)
         pq_print(q);
@@ -172,26 +175,11 @@ int main(int argc, char **argv) {
     assert(!pq_size_is_1(q));
 
     /*
-    * Free everything.
+    * Free everything: every node is in the tree under new_node, and
+    * node_free() frees a node's children with it.
     */
-    node_free(&n1);
-    node_free(&n2);
-    node_free(&n3);
-    node_free(&n4);
-    node_free(&n5);
-    node_free(&n6);
-    node_free(&n7);
-    node_free(&n8);
+    assert(n == new_node);
     node_free(&new_node);
-
-    assert(n1 == NULL);
-    assert(n2 == NULL);
-    assert(n3 == NULL);
-    assert(n4 == NULL);
-    assert(n5 == NULL);
-    assert(n6 == NULL);
-    assert(n7 == NULL);
-    assert(n8 == NULL);
     assert(new_node == NULL);
 
     pq_free(&q);
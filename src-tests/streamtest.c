@@ -0,0 +1,223 @@
+/*
+* File:     streamtest.c
+* Purpose:  Test the streaming interface of libhuff (huffenc.c and huffdec.c)
+*/
+
+#include "block.h"
+#include "libhuff.h"
+
+#include <assert.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define INPUT      (200 * 1000)
+#define BLOCK_SIZE 10000
+
+static uint32_t seed = 12345;
+
+// function that returns a pseudo-random number below n
+static size_t next_random(size_t n) {
+    seed = seed * 1103515245 + 12345;
+    return (seed >> 8) % n;
+}
+
+// function that returns a piece size: mostly tiny, sometimes a few blocks
+static size_t piece(void) {
+    return next_random(4) == 0 ? next_random(3 * BLOCK_SIZE) + 1 : next_random(20) + 1;
+}
+
+// function that compresses n bytes in random pieces of input and output,
+// with a HUFF_FLUSH at flush_at (n or more for none), and returns the size
+static size_t stream_compress(const HuffParams *params, const uint8_t *data, size_t n,
+    size_t flush_at, uint8_t *dst, size_t cap) {
+    HuffStream strm;
+    assert(huff_stream_compress_init(&strm, params));
+    size_t in = 0;
+    size_t out = 0;
+    HuffStatus status = HUFF_OK;
+    while (status != HUFF_STREAM_END) {
+        size_t in_piece = piece();
+        size_t out_piece = piece();
+        in_piece = in_piece < n - in ? in_piece : n - in;
+        out_piece = out_piece < cap - out ? out_piece : cap - out;
+        // the input given stops at the flush point, which is then flushed
+        if (in < flush_at && in + in_piece > flush_at) {
+            in_piece = flush_at - in;
+        }
+        strm.next_in = data + in;
+        strm.avail_in = in_piece;
+        strm.next_out = dst + out;
+        strm.avail_out = out_piece;
+        HuffFlush flush = in + in_piece == n ? HUFF_FINISH
+                          : in + in_piece == flush_at ? HUFF_FLUSH
+                                                      : HUFF_NO_FLUSH;
+        status = huff_stream_compress(&strm, flush);
+        assert(status == HUFF_OK || status == HUFF_STREAM_END);
+        in += in_piece - strm.avail_in;
+        out += out_piece - strm.avail_out;
+        assert(strm.total_in == in && strm.total_out == out);
+    }
+    assert(in == n);
+    huff_stream_compress_end(&strm);
+    assert(strm.encoder == NULL);
+    return out;
+}
+
+// function that decompresses the n bytes at src in random pieces and returns
+// the final status; *size is how much was decoded
+static HuffStatus stream_decompress(const uint8_t *src, size_t n, uint8_t *dst, size_t cap,
+    size_t *size) {
+    HuffStream strm;
+    assert(huff_stream_decompress_init(&strm));
+    size_t in = 0;
+    size_t out = 0;
+    HuffStatus status = HUFF_OK;
+    size_t stalls = 0;
+    while (status == HUFF_OK && stalls < 100) {
+        size_t in_piece = piece();
+        size_t out_piece = piece();
+        in_piece = in_piece < n - in ? in_piece : n - in;
+        out_piece = out_piece < cap - out ? out_piece : cap - out;
+        strm.next_in = src + in;
+        strm.avail_in = in_piece;
+        strm.next_out = dst + out;
+        strm.avail_out = out_piece;
+        status = huff_stream_decompress(&strm);
+        size_t progress = in_piece - strm.avail_in + out_piece - strm.avail_out;
+        in += in_piece - strm.avail_in;
+        out += out_piece - strm.avail_out;
+        assert(strm.total_in == in && strm.total_out == out);
+        // once the input or the output space is used up, calls stop making progress
+        stalls = progress == 0 ? stalls + 1 : 0;
+    }
+    huff_stream_decompress_end(&strm);
+    assert(strm.decoder == NULL);
+    *size = out;
+    return status;
+}
+
+int main(int argc, char **argv) {
+    /*
+    * Poor man's argument checking: is "-v" the first command-line argument?
+    * Ignore all other arguments.
+    */
+    bool verbose = argc > 1 && strcmp(argv[1], "-v") == 0;
+
+    if (!verbose)
+        printf("Use \"streamtest -v\" to print trace information.\n");
+
+    uint8_t *data = (uint8_t *) malloc(INPUT);
+    uint8_t *packed = (uint8_t *) malloc(2 * INPUT);
+    uint8_t *streamed = (uint8_t *) malloc(2 * INPUT);
+    uint8_t *unpacked = (uint8_t *) malloc(INPUT);
+    assert(data && packed && streamed && unpacked);
+    for (size_t i = 0; i < INPUT; ++i) {
+        data[i] = (uint8_t) ("etaoin shrdlu"[next_random(13)]);
+    }
+    HuffParams params;
+    huff_params_default(&params);
+    params.block_size = BLOCK_SIZE;
+    params.num_streams = 3;
+    HuffCCtx *cctx = huff_cctx_create(&params);
+    assert(cctx);
+
+    /*
+    * Without a flush, any split of the input and output gives the bytes of
+    * the one-call compressor, and any split of those decodes to the input.
+    */
+    size_t sizes[] = { 0, 1, BLOCK_SIZE - 1, BLOCK_SIZE, BLOCK_SIZE + 1, INPUT };
+    for (size_t k = 0; k < sizeof(sizes) / sizeof(sizes[0]); ++k) {
+        size_t n = sizes[k];
+        size_t size = huff_compress_ctx(cctx, data, n, packed, 2 * INPUT);
+        assert(size != HUFF_ERROR);
+        for (int pass = 0; pass < 3; ++pass) {
+            assert(stream_compress(&params, data, n, n, streamed, 2 * INPUT) == size);
+            assert(memcmp(packed, streamed, size) == 0);
+            size_t decoded;
+            assert(stream_decompress(packed, size, unpacked, n, &decoded) == HUFF_STREAM_END);
+            assert(decoded == n && memcmp(data, unpacked, n) == 0);
+        }
+        if (verbose)
+            printf("%zu bytes -> %zu bytes, streamed the same\n", n, size);
+    }
+
+    /*
+    * After a flush, all of the input so far can be decoded from the output so far.
+    */
+    size_t flush_at = 3 * BLOCK_SIZE + 1234;
+    size_t size = stream_compress(&params, data, INPUT, flush_at, streamed, 2 * INPUT);
+    size_t decoded;
+    assert(stream_decompress(streamed, size, unpacked, INPUT, &decoded) == HUFF_STREAM_END);
+    assert(decoded == INPUT && memcmp(data, unpacked, INPUT) == 0);
+    assert(huff_decompress_buffer(streamed, size, unpacked, INPUT) == INPUT);
+    HuffStream strm;
+    assert(huff_stream_compress_init(&strm, &params));
+    strm.next_in = data;
+    strm.avail_in = flush_at;
+    strm.next_out = streamed;
+    strm.avail_out = 2 * INPUT;
+    assert(huff_stream_compress(&strm, HUFF_FLUSH) == HUFF_OK);
+    assert(strm.avail_in == 0);
+    size_t flushed = strm.total_out;
+    huff_stream_compress_end(&strm);
+    assert(huff_stream_decompress_init(&strm));
+    strm.next_in = streamed;
+    strm.avail_in = flushed;
+    strm.next_out = unpacked;
+    strm.avail_out = INPUT;
+    assert(huff_stream_decompress(&strm) == HUFF_OK);
+    assert(strm.avail_in == 0 && strm.total_out == flush_at);
+    assert(memcmp(data, unpacked, flush_at) == 0);
+    huff_stream_decompress_end(&strm);
+    if (verbose)
+        printf("%zu bytes flushed into %zu bytes\n", flush_at, flushed);
+
+    /*
+    * Without a flush, output waits for a whole block.
+    */
+    assert(huff_stream_compress_init(&strm, &params));
+    strm.next_in = data;
+    strm.avail_in = BLOCK_SIZE - 1;
+    strm.next_out = streamed;
+    strm.avail_out = 2 * INPUT;
+    assert(huff_stream_compress(&strm, HUFF_NO_FLUSH) == HUFF_OK);
+    assert(strm.avail_in == 0 && strm.total_out == BLOCK_FILE_HEADER_SIZE);
+    huff_stream_compress_end(&strm);
+
+    /*
+    * Cut-off and damaged streams are errors, never overruns.
+    */
+    size = huff_compress_ctx(cctx, data, INPUT, packed, 2 * INPUT);
+    assert(stream_decompress(packed, size - 1, unpacked, INPUT, &decoded) == HUFF_OK);
+    assert(stream_decompress(packed, 3, unpacked, INPUT, &decoded) == HUFF_OK && decoded == 0);
+    for (int pass = 0; pass < 50; ++pass) {
+        memcpy(streamed, packed, size);
+        size_t at = next_random(size);
+        streamed[at] ^= (uint8_t) (1 + next_random(255));
+        HuffStatus status = stream_decompress(streamed, size, unpacked, INPUT, &decoded);
+        // damage to the codes themselves only changes the decoded bytes
+        assert(status == HUFF_DATA_ERROR || status == HUFF_STREAM_END);
+        assert(decoded <= INPUT);
+    }
+    memcpy(streamed, packed, size);
+    streamed[0] = 'X';
+    assert(stream_decompress(streamed, size, unpacked, INPUT, &decoded) == HUFF_DATA_ERROR);
+    memcpy(streamed, packed, size);
+    streamed[size - 1] = 'Y';
+    assert(stream_decompress(streamed, size, unpacked, INPUT, &decoded) == HUFF_DATA_ERROR);
+    // the legacy formats are not streamed
+    assert(stream_decompress((const uint8_t *) "HC\0\0\0\0\0\0", 8, unpacked, INPUT, &decoded)
+           == HUFF_DATA_ERROR);
+
+    huff_cctx_free(&cctx);
+    free(data);
+    free(packed);
+    free(streamed);
+    free(unpacked);
+
+    printf("streamtest, as it is, reports no errors\n");
+    return 0;
+}
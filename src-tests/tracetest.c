@@ -0,0 +1,100 @@
+/*
+* File:     tracetest.c
+* Purpose:  Test trace.c
+*/
+
+#include "pool.h"
+#include "trace.h"
+
+#include <assert.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NUM_JOBS 100
+#define TRACE_FILE "tracetest.json"
+
+// function that records one span named after its job, whichever thread runs it
+static void span_task(void *arg) {
+    uint64_t block = *(uint64_t *) arg;
+    trace_span("job", block, 1000 * block, 1000 * block + 500);
+}
+
+// function that reads the whole trace file into a string
+static char *read_trace(void) {
+    FILE *f = fopen(TRACE_FILE, "r");
+    assert(f);
+    static char text[1 << 16];
+    size_t n = fread(text, 1, sizeof(text) - 1, f);
+    fclose(f);
+    text[n] = '\0';
+    return text;
+}
+
+// function that counts the times needle appears in text
+static int count(const char *text, const char *needle) {
+    int n = 0;
+    for (const char *p = strstr(text, needle); p != NULL; p = strstr(p + 1, needle)) {
+        ++n;
+    }
+    return n;
+}
+
+int main(int argc, char **argv) {
+    /*
+    * Poor man's argument checking: is "-v" the first command-line argument?
+    * Ignore all other arguments.
+    */
+    bool verbose = argc > 1 && strcmp(argv[1], "-v") == 0;
+
+    if (!verbose)
+        printf("Use \"tracetest -v\" to print trace information.\n");
+
+    /*
+    * Nothing is recorded before a trace starts.
+    */
+    trace_span("before", 0, 0, 1);
+
+    /*
+    * Spans from several threads all reach the file, each thread named once.
+    */
+    static uint64_t blocks[NUM_JOBS];
+    static PoolJob jobs[NUM_JOBS];
+    Pool *pool = pool_create(4);
+    assert(pool);
+    trace_start();
+    trace_span("main", TRACE_NO_BLOCK, 0, 1);
+    for (uint64_t i = 0; i < NUM_JOBS; ++i) {
+        blocks[i] = i;
+        pool_submit(pool, &jobs[i], span_task, &blocks[i]);
+    }
+    pool_free(&pool);
+    assert(trace_write(TRACE_FILE));
+    char *text = read_trace();
+    if (verbose)
+        printf("%s", text);
+    assert(strncmp(text, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[", 39) == 0);
+    assert(count(text, "\"name\":\"job\"") == NUM_JOBS);
+    assert(count(text, "\"name\":\"main\"") == 1);
+    assert(count(text, "\"name\":\"before\"") == 0);
+    int threads = count(text, "\"thread_name\"");
+    assert(threads >= 2 && threads <= 5);
+    assert(strstr(text, "\"args\":{\"block\":99}") != NULL);
+
+    /*
+    * A second trace starts empty, and the threads get new buffers.
+    */
+    trace_start();
+    trace_span("again", 7, 0, 1);
+    assert(trace_write(TRACE_FILE));
+    text = read_trace();
+    assert(count(text, "\"name\":\"job\"") == 0);
+    assert(count(text, "\"name\":\"again\"") == 1);
+    assert(count(text, "\"thread_name\"") == 1);
+    remove(TRACE_FILE);
+
+    printf("tracetest, as it is, reports no errors\n");
+    return 0;
+}
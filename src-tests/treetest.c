@@ -0,0 +1,198 @@
+/*
+* File:     treetest.c
+* Purpose:  Test tree.c against a tree built with the PriorityQueue
+*/
+
+#include "bitio_ext.h"
+#include "bitreader.h"
+#include "bitwriter.h"
+#include "node.h"
+#include "nodearena.h"
+#include "pq.h"
+#include "tree.h"
+
+#include <assert.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// function that adds up weight * depth over the leaves, the size of the coded data
+static uint64_t tree_cost(const Node *node, uint64_t depth) {
+    if (node->left == NULL && node->right == NULL) {
+        return node->weight * depth;
+    }
+    return tree_cost(node->left, depth + 1) + tree_cost(node->right, depth + 1);
+}
+
+// function that collects the code of every leaf of a pointer tree
+static void node_codes(const Node *node, uint64_t code, uint8_t depth, uint64_t *codes,
+    uint8_t *code_lengths) {
+    if (node->left == NULL && node->right == NULL) {
+        codes[node->symbol] = code;
+        code_lengths[node->symbol] = depth;
+        return;
+    }
+    node_codes(node->left, code, (uint8_t) (depth + 1), codes, code_lengths);
+    node_codes(node->right, code | (uint64_t) 1 << depth, (uint8_t) (depth + 1), codes,
+        code_lengths);
+}
+
+// function that writes a pointer tree in post-order, the legacy file format
+static void node_write(BitWriter *outbuf, const Node *node) {
+    if (node->left == NULL && node->right == NULL) {
+        bit_write_bit(outbuf, 1);
+        bit_write_uint8(outbuf, node->symbol);
+        return;
+    }
+    node_write(outbuf, node->left);
+    node_write(outbuf, node->right);
+    bit_write_bit(outbuf, 0);
+}
+
+// function that builds a tree the way huff used to, with the linked-list queue
+static Node *pq_build(const uint32_t *histogram) {
+    PriorityQueue *pq = pq_create();
+    for (int i = 0; i < 256; ++i) {
+        if (histogram[i] > 0) {
+            enqueue(pq, node_create((uint8_t) i, histogram[i]));
+        }
+    }
+    while (!pq_size_is_1(pq)) {
+        Node *left = dequeue(pq);
+        Node *right = dequeue(pq);
+        Node *parent = node_create(0, left->weight + right->weight);
+        parent->left = left;
+        parent->right = right;
+        enqueue(pq, parent);
+    }
+    Node *root = dequeue(pq);
+    pq_free(&pq);
+    return root;
+}
+
+int main(int argc, char **argv) {
+    /*
+    * Poor man's argument checking: is "-v" the first command-line argument?
+    * Ignore all other arguments.
+    */
+    bool verbose = argc > 1 && strcmp(argv[1], "-v") == 0;
+
+    if (!verbose)
+        printf("Use \"treetest -v\" to print trace information.\n");
+
+    Node nodes[TREE_MAX_NODES];
+    uint16_t num_leaves;
+    uint32_t histogram[256];
+
+    /*
+    * The order of trees matches the priority queue: weight, then symbol.
+    */
+    Node a = { .symbol = 'a', .weight = 5 };
+    Node b = { .symbol = 'b', .weight = 5 };
+    Node c = { .symbol = 'a', .weight = 6 };
+    assert(tree_less_than(&a, &b) && !tree_less_than(&b, &a));
+    assert(tree_less_than(&b, &c));
+    assert(!tree_less_than(&a, &a));
+
+    /*
+    * No symbols give no tree; one symbol gives a single leaf.
+    */
+    memset(histogram, 0, sizeof(histogram));
+    assert(tree_build(histogram, nodes, &num_leaves) == NULL && num_leaves == 0);
+    histogram['x'] = 3;
+    Node *root = tree_build(histogram, nodes, &num_leaves);
+    assert(root && num_leaves == 1 && root->symbol == 'x' && root->left == NULL);
+    FlatTree flat;
+    assert(tree_build_flat(histogram, &flat) == 1);
+    assert(flat.num_nodes == 1 && flat.nodes[0] == (TREE_LEAF | 'x'));
+    assert(tree_flat_decode(&flat, NULL) == 'x');
+    histogram['x'] = 0;
+    assert(tree_build_flat(histogram, &flat) == 0 && flat.num_nodes == 0);
+
+    /*
+    * The flat tree is laid out breadth-first, children in adjacent pairs:
+    * ((a b) c) d, where (a b) comes before c because it counts as symbol 0.
+    */
+    histogram['a'] = 1;
+    histogram['b'] = 1;
+    histogram['c'] = 2;
+    histogram['d'] = 5;
+    assert(tree_build_flat(histogram, &flat) == 4 && flat.num_nodes == 7);
+    uint16_t expected[7] = { 1, 3, TREE_LEAF | 'd', 5, TREE_LEAF | 'c', TREE_LEAF | 'a',
+        TREE_LEAF | 'b' };
+    assert(memcmp(flat.nodes, expected, sizeof(expected)) == 0);
+
+    /*
+    * Random histograms, including many equal weights, few or all 256
+    * symbols, and symbol 0 tying with merged nodes: the tree must be the
+    * priority queue's tree, with the same code for every symbol.
+    */
+    srand(1);
+    for (int trial = 0; trial < 4000; ++trial) {
+        int used = 0;
+        for (int i = 0; i < 256; ++i) {
+            int r = rand();
+            switch (trial % 4) {
+            case 0: histogram[i] = (uint32_t) (r % 3 + 1); break;
+            case 1: histogram[i] = r % 8 < 3 ? 0 : (uint32_t) (1 << (r % 3)); break;
+            case 2: histogram[i] = i >= 1 + trial % 40 ? 0 : (uint32_t) (r % 4 + 1); break;
+            default: histogram[i] = r % 3 == 0 ? 0 : (uint32_t) (r % (trial % 100 + 2) + 1); break;
+            }
+            used += histogram[i] > 0;
+        }
+        if (used < 2) {
+            histogram[0] = histogram[1] = 1;
+        }
+        root = tree_build(histogram, nodes, &num_leaves);
+        Node *pq_root = pq_build(histogram);
+        assert(root->weight == pq_root->weight);
+        assert(tree_cost(root, 0) == tree_cost(pq_root, 0));
+        uint64_t codes[256] = { 0 };
+        uint8_t code_lengths[256] = { 0 };
+        uint64_t pq_codes[256] = { 0 };
+        uint8_t pq_lengths[256] = { 0 };
+        node_codes(root, 0, 0, codes, code_lengths);
+        node_codes(pq_root, 0, 0, pq_codes, pq_lengths);
+        assert(memcmp(code_lengths, pq_lengths, sizeof(code_lengths)) == 0);
+        assert(memcmp(codes, pq_codes, sizeof(codes)) == 0);
+        if (verbose && trial % 500 == 0)
+            printf("trial %d: %u leaves, cost %" PRIu64 "\n", trial, num_leaves,
+                tree_cost(root, 0));
+        node_free_tree(&pq_root);
+
+        // the flat tree has the same codes as the pointer tree
+        assert(tree_build_flat(histogram, &flat) == num_leaves);
+        assert(flat.num_nodes == 2 * num_leaves - 1);
+        uint64_t flat_codes[256];
+        uint8_t flat_lengths[256];
+        tree_flat_codes(&flat, flat_codes, flat_lengths);
+        assert(memcmp(codes, flat_codes, sizeof(codes)) == 0);
+        assert(memcmp(code_lengths, flat_lengths, sizeof(code_lengths)) == 0);
+
+        // reading the post-order tree back gives the same layout, and
+        // walking it decodes what the codes encode
+        static uint8_t packed[4096];
+        BitWriter *outbuf = bit_write_open_memory(packed, sizeof(packed));
+        node_write(outbuf, root);
+        for (int s = 0; s < 256; ++s) {
+            bit_write_bits(outbuf, codes[s], code_lengths[s]);
+        }
+        bit_write_close(&outbuf);
+        BitReader *inbuf = bit_read_open_memory(packed, sizeof(packed));
+        FlatTree read;
+        assert(tree_read_flat(inbuf, num_leaves, &read));
+        assert(read.num_nodes == flat.num_nodes);
+        assert(memcmp(read.nodes, flat.nodes, flat.num_nodes * sizeof(uint16_t)) == 0);
+        for (int s = 0; s < 256; ++s) {
+            if (code_lengths[s] > 0) {
+                assert(tree_flat_decode(&read, inbuf) == s);
+            }
+        }
+        bit_read_close(&inbuf);
+    }
+
+    printf("treetest, as it is, reports no errors\n");
+    return 0;
+}